@@ -0,0 +1,618 @@
+/*
+ * AIS Decoder Benchmark for Final Year Project
+ * Purpose: Measure the throughput of each decoder stage, for the refined and the original decoder
+ * Output: A table on the console and one CSV row per measurement (--results=FILE)
+ * Build: gcc -O2 ais_benchmark_C.c -o ais_benchmark_C -lm -lpthread (add -lws2_32 on Windows)
+ */
+
+// The decoding library and the refined decoder are compiled into this program as they are,
+// the decoder without its main()
+#define AIS_DECODER_NO_MAIN
+#include "ais_decoder_lib.c"
+#include "refined_ais_decoder_C.c"
+
+// The original decoder is compiled alongside it with its names prefixed plain_
+#define AISData PlainAISData
+#define convert_ais_char plain_convert_ais_char
+#define extract_bits plain_extract_bits
+#define extract_signed_bits plain_extract_signed_bits
+#define convert_payload_to_binary plain_convert_payload_to_binary
+#define get_payload_from_nmea plain_get_payload_from_nmea
+#define format_lat_lon plain_format_lat_lon
+#define init_ais_data plain_init_ais_data
+#define decode_ais plain_decode_ais
+#define make_csv_line plain_make_csv_line
+#define process_ais_file plain_process_ais_file
+#define debug_single_message plain_debug_single_message
+#define main plain_main
+#include "ais_decoder_C.c"
+#undef AISData
+#undef convert_ais_char
+#undef extract_bits
+#undef extract_signed_bits
+#undef convert_payload_to_binary
+#undef get_payload_from_nmea
+#undef format_lat_lon
+#undef init_ais_data
+#undef decode_ais
+#undef make_csv_line
+#undef process_ais_file
+#undef debug_single_message
+#undef main
+
+#define BENCH_DEFAULT_INPUT "../04_Sample_Data/nmea-sample_AIS_Messages"
+#define BENCH_DEFAULT_REPEAT 5            // Each stage runs this often; the fastest run is reported
+#define BENCH_DEFAULT_MESSAGES 200000     // Lines in a synthetic corpus
+#define BENCH_RESULTS_HEADER "decoder,corpus,stage,msg_type,messages,ns_per_message,messages_per_second"
+
+// Lines of one corpus; lines[i] is a NUL-terminated copy, raw the text as it would be read
+typedef struct {
+    const char *name;
+    char *raw;
+    size_t raw_size;
+    char *text;                // Backing store of lines
+    char **lines;
+    int count;
+} Corpus;
+
+// Per-message inputs prepared once, so every stage times only its own work
+typedef struct {
+    char (*payloads)[MAX_PAYLOAD_LENGTH];
+    int *single;               // Indexes of single-sentence lines that decode
+    int single_count;
+    int *by_type[28];          // The same, split by message type
+    int type_count[28];
+    AISData *records;          // Refined decode of each single-sentence line
+    PlainAISData *plain_records;
+    char *csv;                 // CSV text of records, one line after another
+    size_t csv_size;
+} BenchInputs;
+
+typedef struct {
+    FILE *results;             // CSV rows, or NULL
+    const char *corpus;
+    int repeat;
+} BenchRun;
+
+static volatile uint64_t bench_sink;  // Keeps the optimiser from dropping the measured work
+
+static uint64_t bench_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+// Which de-armouring kernel this CPU runs, for the report header
+static const char *dearmor_kernel_name(void) {
+    DearmorKernel kernel = select_dearmor_kernel();
+#ifdef AIS_HAVE_X86_SIMD
+    if (kernel == dearmor_avx2) {
+        return "AVX2";
+    }
+    if (kernel == dearmor_ssse3) {
+        return "SSSE3";
+    }
+#endif
+    return kernel == NULL ? "scalar" : "SIMD";
+}
+
+static void bench_report(const BenchRun *run, const char *decoder, const char *stage, int msg_type,
+                         uint64_t messages, uint64_t best_ns) {
+    if (messages == 0) {
+        return;
+    }
+    double ns_per_message = (double)best_ns / (double)messages;
+    double per_second = best_ns > 0 ? (double)messages * 1e9 / (double)best_ns : 0.0;
+    char type_text[8] = "";
+    if (msg_type > 0) {
+        snprintf(type_text, sizeof(type_text), "%d", msg_type);
+    }
+    printf("  %-8s %-12s %4s %10llu %12.1f %14.0f\n", decoder, stage, type_text,
+           (unsigned long long)messages, ns_per_message, per_second);
+    if (run->results != NULL) {
+        fprintf(run->results, "%s,%s,%s,%s,%llu,%.2f,%.0f\n", decoder, run->corpus, stage, type_text,
+                (unsigned long long)messages, ns_per_message, per_second);
+    }
+}
+
+// Time body `run->repeat` times over `messages` items and report the fastest pass
+#define BENCH_STAGE(run, decoder, stage, msg_type, messages, body) \
+    do { \
+        uint64_t best_ns_ = UINT64_MAX; \
+        for (int rep_ = 0; rep_ < (run)->repeat; rep_++) { \
+            uint64_t start_ns_ = bench_now_ns(); \
+            body; \
+            uint64_t elapsed_ns_ = bench_now_ns() - start_ns_; \
+            if (elapsed_ns_ < best_ns_) best_ns_ = elapsed_ns_; \
+        } \
+        bench_report((run), (decoder), (stage), (msg_type), (uint64_t)(messages), best_ns_); \
+    } while (0)
+
+// Take ownership of raw text and split it into NUL-terminated lines (empty lines skipped)
+static int corpus_from_text(Corpus *corpus, const char *name, char *raw, size_t size) {
+    memset(corpus, 0, sizeof(*corpus));
+    corpus->name = name;
+    corpus->raw = raw;
+    corpus->raw_size = size;
+    corpus->text = malloc(size + 1);
+    int cap = 1024;
+    corpus->lines = malloc((size_t)cap * sizeof(char *));
+    if (corpus->text == NULL || corpus->lines == NULL) {
+        return 0;
+    }
+    memcpy(corpus->text, raw, size);
+    corpus->text[size] = '\0';
+
+    char *p = corpus->text;
+    char *end = corpus->text + size;
+    while (p < end) {
+        char *line_end = memchr(p, '\n', (size_t)(end - p));
+        char *next = line_end ? line_end + 1 : end;
+        if (line_end == NULL) {
+            line_end = end;
+        }
+        if (line_end > p && line_end[-1] == '\r') {
+            line_end--;
+        }
+        *line_end = '\0';
+        if (line_end > p && line_end - p < MAX_LINE_LENGTH) {
+            if (corpus->count == cap) {
+                cap *= 2;
+                char **grown = realloc(corpus->lines, (size_t)cap * sizeof(char *));
+                if (grown == NULL) {
+                    return 0;
+                }
+                corpus->lines = grown;
+            }
+            corpus->lines[corpus->count++] = p;
+        }
+        p = next;
+    }
+    return 1;
+}
+
+static int corpus_load(Corpus *corpus, const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *raw = size > 0 ? malloc((size_t)size) : NULL;
+    if (raw == NULL || fread(raw, 1, (size_t)size, file) != (size_t)size) {
+        free(raw);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    return corpus_from_text(corpus, filename, raw, (size_t)size);
+}
+
+static void corpus_free(Corpus *corpus) {
+    free(corpus->raw);
+    free(corpus->text);
+    free(corpus->lines);
+}
+
+// Parse a type mix such as "1:60,5:20,21:20" into per-type weights; returns 0 if malformed
+static int parse_type_mix(const char *spec, int weights[28]) {
+    memset(weights, 0, 28 * sizeof(int));
+    const char *p = spec;
+    int total = 0;
+    while (*p) {
+        char *end;
+        long type = strtol(p, &end, 10);
+        if (end == p || *end != ':' || type < 1 || type > 27) {
+            return 0;
+        }
+        p = end + 1;
+        long weight = strtol(p, &end, 10);
+        if (end == p || weight < 0 || (*end != ',' && *end != '\0')) {
+            return 0;
+        }
+        weights[type] += (int)weight;
+        total += (int)weight;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return total > 0;
+}
+
+// Draw `messages` single-sentence lines of the source at random, in the proportions of the
+// type mix. Types the source has no examples of are reported and left out
+static int corpus_synthesize(Corpus *corpus, const Corpus *source, const int weights[28], int messages,
+                             const char *name) {
+    int *pool[28];
+    int pool_count[28];
+    memset(pool_count, 0, sizeof(pool_count));
+    for (int t = 0; t < 28; t++) {
+        pool[t] = malloc((size_t)source->count * sizeof(int));
+        if (pool[t] == NULL) {
+            return 0;
+        }
+    }
+    for (int i = 0; i < source->count; i++) {
+        NMEASentence s;
+        const char *line = source->lines[i];
+        if (parse_nmea_sentence(line, (int)strlen(line), &s) && s.fragment_count == 1 && s.payload_len > 0 &&
+            verify_nmea_checksum(line, (int)strlen(line)) == 1) {
+            int t = convert_ais_char(s.payload[0]);
+            if (t >= 1 && t <= 27) {
+                pool[t][pool_count[t]++] = i;
+            }
+        }
+    }
+
+    int total = 0;
+    for (int t = 1; t < 28; t++) {
+        if (weights[t] > 0 && pool_count[t] == 0) {
+            printf("Warning: %s has no single-sentence type %d messages, left out of the mix\n", source->name, t);
+        } else if (pool_count[t] > 0) {
+            total += weights[t];
+        }
+    }
+
+    size_t cap = (size_t)messages * 84 + 1;
+    char *raw = total > 0 ? malloc(cap) : NULL;
+    size_t len = 0;
+    uint64_t state = 0x2545F4914F6CDD1DULL;  // Fixed seed, so every run measures the same corpus
+    for (int n = 0; raw != NULL && n < messages; n++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        int pick = (int)(state % (uint64_t)total);
+        int t = 1;
+        while (pool_count[t] == 0 || pick >= weights[t]) {
+            if (pool_count[t] > 0) {
+                pick -= weights[t];
+            }
+            t++;
+        }
+        const char *line = source->lines[pool[t][(state >> 32) % (uint64_t)pool_count[t]]];
+        size_t line_len = strlen(line);
+        if (len + line_len + 1 > cap) {
+            break;
+        }
+        memcpy(raw + len, line, line_len);
+        len += line_len;
+        raw[len++] = '\n';
+    }
+    for (int t = 0; t < 28; t++) {
+        free(pool[t]);
+    }
+    if (raw == NULL) {
+        return 0;
+    }
+    return corpus_from_text(corpus, name, raw, len);
+}
+
+static void inputs_free(BenchInputs *in) {
+    free(in->payloads);
+    free(in->single);
+    for (int t = 0; t < 28; t++) {
+        free(in->by_type[t]);
+    }
+    free(in->records);
+    free(in->plain_records);
+    free(in->csv);
+}
+
+static int inputs_prepare(BenchInputs *in, const Corpus *corpus) {
+    memset(in, 0, sizeof(*in));
+    size_t n = corpus->count > 0 ? (size_t)corpus->count : 1;
+    in->payloads = calloc(n, MAX_PAYLOAD_LENGTH);
+    in->single = malloc(n * sizeof(int));
+    in->records = malloc(n * sizeof(AISData));
+    in->plain_records = malloc(n * sizeof(PlainAISData));
+    in->csv = malloc(n * MAX_LINE_LENGTH);
+    if (in->payloads == NULL || in->single == NULL || in->records == NULL || in->plain_records == NULL ||
+        in->csv == NULL) {
+        return 0;
+    }
+    for (int t = 0; t < 28; t++) {
+        in->by_type[t] = malloc(n * sizeof(int));
+        if (in->by_type[t] == NULL) {
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < corpus->count; i++) {
+        const char *line = corpus->lines[i];
+        NMEASentence s;
+        get_payload_from_nmea(line, in->payloads[i]);
+        if (!parse_nmea_sentence(line, (int)strlen(line), &s) || s.fragment_count != 1) {
+            continue;
+        }
+        AISData *record = &in->records[in->single_count];
+        if (!decode_ais(line, record)) {
+            continue;
+        }
+        plain_decode_ais(line, &in->plain_records[in->single_count]);
+        in->single[in->single_count++] = i;
+        in->by_type[record->msg_type][in->type_count[record->msg_type]++] = i;
+        int csv_len = make_csv_line(record, in->csv + in->csv_size);
+        in->csv[in->csv_size + csv_len] = '\n';
+        in->csv_size += (size_t)csv_len + 1;
+    }
+    return 1;
+}
+
+// Stages of the refined decoder
+static void bench_refined(const BenchRun *run, const Corpus *corpus, const BenchInputs *in) {
+    AISData data;
+    AISBitBuffer bits;
+    char payload[MAX_PAYLOAD_LENGTH];
+    char csv_line[MAX_LINE_LENGTH * 3];
+    uint64_t sink = 0;
+
+    BENCH_STAGE(run, "refined", "split", 0, corpus->count, {
+        const char *p = corpus->raw;
+        const char *end = corpus->raw + corpus->raw_size;
+        while (p < end) {
+            const char *newline = memchr(p, '\n', (size_t)(end - p));
+            sink += (uint64_t)(newline ? newline - p : end - p);
+            p = newline ? newline + 1 : end;
+        }
+    });
+    BENCH_STAGE(run, "refined", "get_payload", 0, corpus->count, {
+        for (int i = 0; i < corpus->count; i++) {
+            sink += (uint64_t)get_payload_from_nmea(corpus->lines[i], payload);
+        }
+    });
+    BENCH_STAGE(run, "refined", "dearmor", 0, corpus->count, {
+        for (int i = 0; i < corpus->count; i++) {
+            sink += (uint64_t)convert_payload_to_binary(in->payloads[i], &bits) + (uint64_t)bits.length;
+        }
+    });
+    BENCH_STAGE(run, "refined", "decode", 0, in->single_count, {
+        for (int i = 0; i < in->single_count; i++) {
+            sink += (uint64_t)decode_ais(corpus->lines[in->single[i]], &data) + data.mmsi;
+        }
+    });
+    for (int t = 1; t < 28; t++) {
+        BENCH_STAGE(run, "refined", "decode", t, in->type_count[t], {
+            for (int i = 0; i < in->type_count[t]; i++) {
+                sink += (uint64_t)decode_ais(corpus->lines[in->by_type[t][i]], &data) + data.mmsi;
+            }
+        });
+    }
+    // Checksum, reassembly and decode of every line through the batch API
+    AISDecoder *decoder = malloc(sizeof(AISDecoder));
+    AISData *batch = malloc((size_t)(corpus->count > 0 ? corpus->count : 1) * sizeof(AISData));
+    int *sources = malloc((size_t)(corpus->count > 0 ? corpus->count : 1) * sizeof(int));
+    if (decoder != NULL && batch != NULL && sources != NULL) {
+        int decoded = 0;
+        BENCH_STAGE(run, "refined", "batch", 0, corpus->count, {
+            ais_decoder_init(decoder, 1);
+            decoded = decode_ais_batch(decoder, (const char *const *)corpus->lines, NULL, corpus->count, batch,
+                                       sources, NULL);
+            sink += (uint64_t)decoded;
+        });
+
+        // Single-sentence records must match the line-at-a-time decode
+        int mismatches = 0;
+        char batch_line[MAX_LINE_LENGTH * 3];
+        for (int k = 0, i = 0; k < decoded; k++) {
+            while (i < in->single_count && in->single[i] < sources[k]) {
+                i++;
+            }
+            if (i < in->single_count && in->single[i] == sources[k]) {
+                make_csv_line(&batch[k], batch_line);
+                make_csv_line(&in->records[i], csv_line);
+                mismatches += strcmp(batch_line, csv_line) != 0;
+            }
+        }
+        if (mismatches > 0) {
+            printf("  Warning: %d batch records differ from decode_ais\n", mismatches);
+        }
+    }
+    free(decoder);
+    free(batch);
+    free(sources);
+
+    BENCH_STAGE(run, "refined", "csv", 0, in->single_count, {
+        for (int i = 0; i < in->single_count; i++) {
+            sink += (uint64_t)make_csv_line(&in->records[i], csv_line);
+        }
+    });
+
+    FILE *out = tmpfile();
+    if (out != NULL) {
+        BENCH_STAGE(run, "refined", "write", 0, in->single_count, {
+            fseek(out, 0, SEEK_SET);
+            fwrite(in->csv, 1, in->csv_size, out);
+            fflush(out);
+        });
+
+        // Everything process_ais_file does per line: checksum, reassembly, decode, CSV, write
+        DecoderOptions options;
+        FragmentTable *fragments = malloc(sizeof(FragmentTable));
+        init_decoder_options(&options);
+        if (fragments != NULL) {
+            BENCH_STAGE(run, "refined", "pipeline", 0, corpus->count, {
+                DecodeContext ctx;
+                memset(&ctx, 0, sizeof(ctx));
+                ctx.options = &options;
+                ctx.output_file = out;
+                ctx.fragments = fragments;
+                fragment_table_init(fragments, FRAGMENT_TIMEOUT_LINES);
+                fseek(out, 0, SEEK_SET);
+                process_nmea_buffer(&ctx, corpus->raw, corpus->raw_size);
+                fflush(out);
+                sink += ctx.stats.decoded_messages;
+            });
+        }
+        free(fragments);
+        fclose(out);
+    }
+    bench_sink += sink;
+}
+
+// The same stages for the original decoder (binary strings, sprintf formatting)
+static void bench_plain(const BenchRun *run, const Corpus *corpus, const BenchInputs *in) {
+    PlainAISData data;
+    char payload[MAX_PAYLOAD_LENGTH];
+    char binary[MAX_BINARY_LENGTH + 8];
+    char csv_line[MAX_LINE_LENGTH];
+    uint64_t sink = 0;
+
+    BENCH_STAGE(run, "plain", "get_payload", 0, corpus->count, {
+        for (int i = 0; i < corpus->count; i++) {
+            sink += (uint64_t)plain_get_payload_from_nmea(corpus->lines[i], payload);
+        }
+    });
+    BENCH_STAGE(run, "plain", "dearmor", 0, corpus->count, {
+        for (int i = 0; i < corpus->count; i++) {
+            plain_convert_payload_to_binary(in->payloads[i], binary);
+            sink += (uint64_t)binary[0];
+        }
+    });
+    BENCH_STAGE(run, "plain", "decode", 0, in->single_count, {
+        for (int i = 0; i < in->single_count; i++) {
+            sink += (uint64_t)plain_decode_ais(corpus->lines[in->single[i]], &data) + data.mmsi;
+        }
+    });
+    for (int t = 1; t < 28; t++) {
+        BENCH_STAGE(run, "plain", "decode", t, in->type_count[t], {
+            for (int i = 0; i < in->type_count[t]; i++) {
+                sink += (uint64_t)plain_decode_ais(corpus->lines[in->by_type[t][i]], &data) + data.mmsi;
+            }
+        });
+    }
+    BENCH_STAGE(run, "plain", "csv", 0, in->single_count, {
+        for (int i = 0; i < in->single_count; i++) {
+            plain_make_csv_line(&in->plain_records[i], csv_line);
+            sink += (uint64_t)csv_line[0];
+        }
+    });
+    bench_sink += sink;
+}
+
+static int bench_corpus(BenchRun *run, const Corpus *corpus) {
+    BenchInputs inputs;
+    if (!inputs_prepare(&inputs, corpus)) {
+        printf("Error: Could not allocate benchmark inputs for %s\n", corpus->name);
+        inputs_free(&inputs);
+        return 0;
+    }
+    run->corpus = corpus->name;
+    printf("\nCorpus: %s (%d lines, %d single-sentence messages)\n", corpus->name, corpus->count,
+           inputs.single_count);
+    printf("  %-8s %-12s %4s %10s %12s %14s\n", "decoder", "stage", "type", "messages", "ns/message",
+           "messages/s");
+    bench_refined(run, corpus, &inputs);
+    bench_plain(run, corpus, &inputs);
+    inputs_free(&inputs);
+    return 1;
+}
+
+static void print_benchmark_usage(const char *program) {
+    printf("Usage: %s [options]\n\n", program);
+    printf("Times each decoder stage (line split, payload extraction, de-armouring, decode per\n");
+    printf("message type, batch API, CSV formatting, file write, whole pipeline) for the refined\n");
+    printf("and the original decoder. Each stage runs several times and the fastest is reported.\n\n");
+    printf("Options:\n");
+    printf("  --input=FILE      NMEA corpus (default %s)\n", BENCH_DEFAULT_INPUT);
+    printf("  --mix=T:W,...     Also time a synthetic corpus drawn from the input with this type\n");
+    printf("                    mix, e.g. 1:70,5:10,21:20 (repeatable)\n");
+    printf("  --messages=N      Lines per synthetic corpus (default %d)\n", BENCH_DEFAULT_MESSAGES);
+    printf("  --repeat=N        Runs per stage (default %d)\n", BENCH_DEFAULT_REPEAT);
+    printf("  --results=FILE    Write every measurement as a CSV row:\n");
+    printf("                    %s\n", BENCH_RESULTS_HEADER);
+}
+
+int main(int argc, char *argv[]) {
+    const char *input = BENCH_DEFAULT_INPUT;
+    const char *results_filename = NULL;
+    const char *mixes[16];
+    int num_mixes = 0;
+    int messages = BENCH_DEFAULT_MESSAGES;
+    BenchRun run;
+
+    memset(&run, 0, sizeof(run));
+    run.repeat = BENCH_DEFAULT_REPEAT;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--input=", 8) == 0) {
+            input = arg + 8;
+        } else if (strncmp(arg, "--mix=", 6) == 0 && num_mixes < 16) {
+            mixes[num_mixes++] = arg + 6;
+        } else if (strncmp(arg, "--messages=", 11) == 0) {
+            messages = atoi(arg + 11);
+        } else if (strncmp(arg, "--repeat=", 9) == 0) {
+            run.repeat = atoi(arg + 9);
+        } else if (strncmp(arg, "--results=", 10) == 0) {
+            results_filename = arg + 10;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_benchmark_usage(argv[0]);
+            return 0;
+        } else {
+            printf("Unknown argument: %s\n\n", arg);
+            print_benchmark_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (run.repeat < 1 || messages < 1) {
+        print_benchmark_usage(argv[0]);
+        return 1;
+    }
+
+    Corpus source;
+    if (!corpus_load(&source, input)) {
+        printf("Error: Could not read %s\n", input);
+        return 1;
+    }
+    if (results_filename != NULL) {
+        run.results = fopen(results_filename, "w");
+        if (run.results == NULL) {
+            printf("Error: Could not open %s\n", results_filename);
+            corpus_free(&source);
+            return 1;
+        }
+        fprintf(run.results, "%s\n", BENCH_RESULTS_HEADER);
+    }
+
+    printf("Dearmor kernel: %s, %d runs per stage\n", dearmor_kernel_name(), run.repeat);
+    int ok = bench_corpus(&run, &source);
+
+    for (int m = 0; m < num_mixes && ok; m++) {
+        int weights[28];
+        Corpus synthetic;
+        char name[128];
+        if (!parse_type_mix(mixes[m], weights)) {
+            printf("Invalid type mix: %s\n", mixes[m]);
+            ok = 0;
+            break;
+        }
+        // Corpus names go into CSV rows, so the mix is written with '+' between types
+        snprintf(name, sizeof(name), "mix:%s", mixes[m]);
+        for (char *c = name; *c; c++) {
+            if (*c == ',') {
+                *c = '+';
+            }
+        }
+        if (!corpus_synthesize(&synthetic, &source, weights, messages, name)) {
+            printf("Error: Could not build the synthetic corpus %s\n", mixes[m]);
+            ok = 0;
+            break;
+        }
+        ok = bench_corpus(&run, &synthetic);
+        corpus_free(&synthetic);
+    }
+
+    if (run.results != NULL) {
+        fclose(run.results);
+        printf("\nResults saved to: %s\n", results_filename);
+    }
+    corpus_free(&source);
+    return ok ? 0 : 1;
+}
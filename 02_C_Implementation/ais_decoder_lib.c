@@ -0,0 +1,1816 @@
+/*
+ * AIS Decoding Library for Final Year Project
+ * Purpose: NMEA parsing, multi-sentence reassembly, decoding, encoding and CSV formatting of
+ *          AIS messages, shared by the decoder CLI and any program that links it
+ * Build: compile with the program, e.g. gcc -O2 app.c ais_decoder_lib.c -lm -lpthread
+ * Reference: https://gpsd.gitlab.io/gpsd/AIVDM.html#_json_ais_encoding
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AIS_HAVE_X86_SIMD 1
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ais_decoder_lib.h"
+
+// 6-bit value of each armoured character, -1 outside the AIS alphabet ('0'-'W', '`'-'w')
+static const int8_t AIS_SIXBIT_TABLE[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+    16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+    32, 33, 34, 35, 36, 37, 38, 39, -1, -1, -1, -1, -1, -1, -1, -1,
+    40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55,
+    56, 57, 58, 59, 60, 61, 62, 63, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+// Convert AIS character to 6-bit value (-1 if not a valid armoured character)
+int convert_ais_char(char c) {
+    return AIS_SIXBIT_TABLE[(unsigned char)c];
+}
+
+
+// Extract bits from bit buffer
+int64_t extract_bits(const AISBitBuffer *bits, int start_pos, int bit_length) {
+    if (bit_length <= 0 || bit_length > 63 || start_pos + bit_length > bits->length) {
+        return -1;
+    }
+    return (int64_t)bitbuf_read(bits, start_pos, bit_length);
+}
+
+// Extract signed bits (for negative values)
+int64_t extract_signed_bits(const AISBitBuffer *bits, int start_pos, int bit_length) {
+    if (bit_length <= 0 || bit_length > 63 || start_pos + bit_length > bits->length) {
+        return -1;
+    }
+
+    // Shift the field to the top of the word and let the arithmetic shift sign-extend it
+    uint64_t raw = bitbuf_read(bits, start_pos, bit_length);
+    return (int64_t)(raw << (64 - bit_length)) >> (64 - bit_length);
+}
+
+// De-armour groups of 4 characters into 3 bytes; returns -1 on an invalid character
+static int dearmor_scalar(const unsigned char *payload, int num_chars, uint8_t *packed) {
+    int i = 0;
+    for (; i + 4 <= num_chars; i += 4) {
+        int a = AIS_SIXBIT_TABLE[payload[i]];
+        int b = AIS_SIXBIT_TABLE[payload[i + 1]];
+        int c = AIS_SIXBIT_TABLE[payload[i + 2]];
+        int d = AIS_SIXBIT_TABLE[payload[i + 3]];
+        if ((a | b | c | d) < 0) {
+            return -1;
+        }
+        uint32_t group = ((uint32_t)a << 18) | ((uint32_t)b << 12) | ((uint32_t)c << 6) | (uint32_t)d;
+        packed[(i / 4) * 3] = (uint8_t)(group >> 16);
+        packed[(i / 4) * 3 + 1] = (uint8_t)(group >> 8);
+        packed[(i / 4) * 3 + 2] = (uint8_t)group;
+    }
+
+    // Last 1-3 characters, zero padded
+    if (i < num_chars) {
+        uint32_t group = 0;
+        for (int j = 0; j < 4; j++) {
+            int val = 0;
+            if (i + j < num_chars) {
+                val = AIS_SIXBIT_TABLE[payload[i + j]];
+                if (val < 0) {
+                    return -1;
+                }
+            }
+            group = (group << 6) | (uint32_t)val;
+        }
+        packed[(i / 4) * 3] = (uint8_t)(group >> 16);
+        packed[(i / 4) * 3 + 1] = (uint8_t)(group >> 8);
+        packed[(i / 4) * 3 + 2] = (uint8_t)group;
+    }
+    return num_chars;
+}
+
+#ifdef AIS_HAVE_X86_SIMD
+// SSSE3: validate and map 16 armoured characters, then pack them into 12 big-endian bytes
+__attribute__((target("ssse3")))
+static int dearmor_ssse3(const unsigned char *payload, int num_chars, uint8_t *packed) {
+    const __m128i lo_min = _mm_set1_epi8(47);  // '0' - 1
+    const __m128i lo_max = _mm_set1_epi8(88);  // 'W' + 1
+    const __m128i hi_min = _mm_set1_epi8(95);  // '`' - 1
+    const __m128i hi_max = _mm_set1_epi8(120); // 'w' + 1
+    const __m128i merge_pairs = _mm_set1_epi32(0x01400140);
+    const __m128i merge_quads = _mm_set1_epi32(0x00011000);
+    const __m128i to_big_endian = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int i = 0;
+
+    for (; i + 16 <= num_chars; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(payload + i));
+
+        // Bytes >= 0x80 compare as negative, so they fall outside both ranges
+        __m128i in_lo = _mm_and_si128(_mm_cmpgt_epi8(c, lo_min), _mm_cmplt_epi8(c, lo_max));
+        __m128i in_hi = _mm_and_si128(_mm_cmpgt_epi8(c, hi_min), _mm_cmplt_epi8(c, hi_max));
+        if (_mm_movemask_epi8(_mm_or_si128(in_lo, in_hi)) != 0xFFFF) {
+            return -1;
+        }
+
+        // c - 48, minus another 8 for the upper range
+        __m128i v = _mm_sub_epi8(c, _mm_set1_epi8(48));
+        v = _mm_sub_epi8(v, _mm_and_si128(in_hi, _mm_set1_epi8(8)));
+
+        // 6+6 -> 12 bits per 16-bit lane, 12+12 -> 24 bits per 32-bit lane
+        v = _mm_maddubs_epi16(v, merge_pairs);
+        v = _mm_madd_epi16(v, merge_quads);
+        v = _mm_shuffle_epi8(v, to_big_endian);
+        _mm_storeu_si128((__m128i *)(packed + (i / 4) * 3), v);
+    }
+    return i;
+}
+
+// AVX2: same as the SSSE3 kernel on 32 characters per iteration
+__attribute__((target("avx2")))
+static int dearmor_avx2(const unsigned char *payload, int num_chars, uint8_t *packed) {
+    const __m256i lo_min = _mm256_set1_epi8(47);
+    const __m256i lo_max = _mm256_set1_epi8(88);
+    const __m256i hi_min = _mm256_set1_epi8(95);
+    const __m256i hi_max = _mm256_set1_epi8(120);
+    const __m256i merge_pairs = _mm256_set1_epi32(0x01400140);
+    const __m256i merge_quads = _mm256_set1_epi32(0x00011000);
+    const __m256i to_big_endian = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                   2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int i = 0;
+
+    for (; i + 32 <= num_chars; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(payload + i));
+
+        __m256i in_lo = _mm256_and_si256(_mm256_cmpgt_epi8(c, lo_min), _mm256_cmpgt_epi8(lo_max, c));
+        __m256i in_hi = _mm256_and_si256(_mm256_cmpgt_epi8(c, hi_min), _mm256_cmpgt_epi8(hi_max, c));
+        if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(in_lo, in_hi)) != 0xFFFFFFFFu) {
+            return -1;
+        }
+
+        __m256i v = _mm256_sub_epi8(c, _mm256_set1_epi8(48));
+        v = _mm256_sub_epi8(v, _mm256_and_si256(in_hi, _mm256_set1_epi8(8)));
+        v = _mm256_maddubs_epi16(v, merge_pairs);
+        v = _mm256_madd_epi16(v, merge_quads);
+        v = _mm256_shuffle_epi8(v, to_big_endian);
+
+        // Each 128-bit lane holds 12 packed bytes; the second store overwrites the first lane's padding
+        uint8_t *out = packed + (i / 4) * 3;
+        _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *)(out + 12), _mm256_extracti128_si256(v, 1));
+    }
+    return i;
+}
+#endif
+
+// Pick the widest kernel the CPU supports (0 if only the scalar table is available)
+static DearmorKernel select_dearmor_kernel(void) {
+#ifdef AIS_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return dearmor_avx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return dearmor_ssse3;
+    }
+#endif
+    return NULL;
+}
+
+// De-armour num_chars characters into packed bits with the given kernel (NULL = scalar only);
+// returns 0 on an invalid character
+static int dearmor_with_kernel(DearmorKernel kernel, const char *payload, int num_chars, AISBitBuffer *bits) {
+    // Packed bytes plus slack for the 16-byte SIMD stores and word padding
+    uint8_t packed[MAX_BINARY_LENGTH / 8 + 32];
+    const unsigned char *chars = (const unsigned char *)payload;
+
+    if (num_chars > MAX_BINARY_LENGTH / 6) {
+        num_chars = MAX_BINARY_LENGTH / 6;
+    }
+
+    int done = 0;
+    if (kernel != NULL) {
+        done = kernel(chars, num_chars, packed);
+        if (done < 0) {
+            bits->length = 0;
+            return 0;
+        }
+    }
+    if (dearmor_scalar(chars + done, num_chars - done, packed + (done / 4) * 3) < 0) {
+        bits->length = 0;
+        return 0;
+    }
+
+    // Zero the tail of the last word, then load bytes into MSB-first words
+    int num_bytes = (num_chars * 6 + 7) / 8;
+    int num_words = (num_bytes + 7) / 8;
+    memset(packed + num_bytes, 0, (size_t)(num_words * 8 - num_bytes));
+    for (int w = 0; w < num_words; w++) {
+        uint64_t word = 0;
+        for (int b = 0; b < 8; b++) {
+            word = (word << 8) | packed[w * 8 + b];
+        }
+        bits->words[w] = word;
+    }
+    bits->words[num_words] = 0;
+    bits->length = num_chars * 6;
+    return 1;
+}
+
+// The kernel for this CPU, chosen once however many threads get here first
+static pthread_once_t dearmor_kernel_once = PTHREAD_ONCE_INIT;
+static DearmorKernel dearmor_kernel;
+
+static void init_dearmor_kernel(void) {
+    dearmor_kernel = select_dearmor_kernel();
+}
+
+// De-armour num_chars characters into packed bits; returns 0 on an invalid character
+int dearmor_payload(const char *payload, int num_chars, AISBitBuffer *bits) {
+    pthread_once(&dearmor_kernel_once, init_dearmor_kernel);
+    return dearmor_with_kernel(dearmor_kernel, payload, num_chars, bits);
+}
+
+// Convert payload to packed bits; returns 0 if the payload holds invalid characters
+int convert_payload_to_binary(const char *payload, AISBitBuffer *bits) {
+    return dearmor_payload(payload, (int)strlen(payload), bits);
+}
+
+// Parse NMEA sentence to get payload
+int get_payload_from_nmea(const char *sentence, char *payload) {
+    if (sentence[0] == '\\') {
+        // Skip a tag block
+        const char *close = strchr(sentence + 1, '\\');
+        if (close == NULL) {
+            return 0;
+        }
+        sentence = close + 1;
+    }
+    if (strncmp(sentence, "!AIVDM", 6) != 0 && strncmp(sentence, "!AIVDO", 6) != 0) {
+        return 0;
+    }
+
+    const char *p = sentence;
+    int comma_count = 0;
+
+    while (*p) {
+        if (*p == ',') {
+            comma_count++;
+        } else if (comma_count == 5) {
+            // start of payload
+            const char *start = p;
+            while (*p && *p != ',') p++;
+            int len = p - start;
+            strncpy(payload, start, len);
+            payload[len] = '\0';
+            return 1;
+        }
+        p++;
+    }
+    return 0;
+}
+
+// Split an AIVDM/AIVDO sentence of len bytes into its fields without copying the payload
+// (the sentence does not need to be NUL-terminated)
+int parse_nmea_sentence(const char *sentence, int len, NMEASentence *out) {
+    const char *end = sentence + len;
+
+    // "!AIVDM," plus the two single-digit fragment fields
+    if (len < 11 || (memcmp(sentence, "!AIVDM,", 7) != 0 && memcmp(sentence, "!AIVDO,", 7) != 0)) {
+        return 0;
+    }
+
+    const char *p = sentence + 7;
+    if (*p < '1' || *p > '9' || p[1] != ',') {
+        return 0;
+    }
+    out->fragment_count = *p - '0';
+    p += 2;
+
+    if (*p < '1' || *p > '9' || p[1] != ',') {
+        return 0;
+    }
+    out->fragment_num = *p - '0';
+    p += 2;
+    if (out->fragment_num > out->fragment_count) {
+        return 0;
+    }
+
+    out->seq_id = -1;
+    if (p < end && *p >= '0' && *p <= '9') {
+        out->seq_id = *p++ - '0';
+    }
+    if (p >= end || *p++ != ',') {
+        return 0;
+    }
+
+    out->channel = '\0';
+    if (p < end && *p != ',') {
+        out->channel = *p++;
+    }
+    if (p >= end || *p++ != ',') {
+        return 0;
+    }
+
+    out->payload = p;
+    while (p < end && *p != ',') p++;
+    out->payload_len = (int)(p - out->payload);
+    if (p >= end) {
+        return 0;
+    }
+    p++;
+
+    out->fill_bits = (p < end && *p >= '0' && *p <= '5') ? *p - '0' : 0;
+    return 1;
+}
+
+// XOR of all bytes in body (the NMEA checksum), 16 bytes per step with SSE2
+static uint8_t nmea_xor(const char *body, int len) {
+    int i = 0;
+    uint64_t acc64 = 0;
+
+#ifdef __SSE2__
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        acc = _mm_xor_si128(acc, _mm_loadu_si128((const __m128i *)(body + i)));
+    }
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+    acc64 = (uint64_t)_mm_cvtsi128_si64(acc);
+#endif
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t chunk;
+        memcpy(&chunk, body + i, 8);
+        acc64 ^= chunk;
+    }
+    acc64 ^= acc64 >> 32;
+    acc64 ^= acc64 >> 16;
+    acc64 ^= acc64 >> 8;
+
+    uint8_t sum = (uint8_t)acc64;
+    for (; i < len; i++) {
+        sum ^= (uint8_t)body[i];
+    }
+    return sum;
+}
+
+static int hex_digit_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Check the trailing *hh checksum (one or two hex digits)
+// Returns 1 if it matches, 0 on mismatch, -1 if the sentence has no checksum
+int verify_nmea_checksum(const char *sentence, int len) {
+    int star;
+    if (len >= 4 && sentence[len - 3] == '*') {
+        star = len - 3;
+    } else if (len >= 3 && sentence[len - 2] == '*') {
+        star = len - 2;
+    } else {
+        return -1;
+    }
+
+    int expected = 0;
+    for (int i = star + 1; i < len; i++) {
+        int digit = hex_digit_value(sentence[i]);
+        if (digit < 0) {
+            return -1;
+        }
+        expected = (expected << 4) | digit;
+    }
+
+    // Checksum covers everything between the leading '!' or '$' and the '*'
+    return nmea_xor(sentence + 1, star - 1) == expected;
+}
+
+// Decimal digits of [p, end) as a number; returns 0 if there are none or anything else
+static int parse_tag_number(const char *p, const char *end, uint64_t *value) {
+    uint64_t v = 0;
+    if (p >= end || end - p > 19) {
+        return 0;
+    }
+    for (; p < end; p++) {
+        if (*p < '0' || *p > '9') {
+            return 0;
+        }
+        v = v * 10 + (uint64_t)(*p - '0');
+    }
+    *value = v;
+    return 1;
+}
+
+// Read the NMEA 4.0 tag block at the start of line, if any, into tags. Only the receive time
+// (c:), source (s:) and group (g:) fields are kept. Returns the block's length including both
+// backslashes, so the sentence starts that far into line (0 without a tag block), or -1 if the
+// block is not closed
+int parse_nmea_tag_block(const char *line, int len, NMEATagBlock *tags) {
+    tags->time_ms = 0;
+    tags->group_id = -1;
+    tags->checksum = -1;
+    tags->source[0] = '\0';
+    if (len < 2 || line[0] != '\\') {
+        return 0;
+    }
+
+    const char *body = line + 1;
+    const char *close = memchr(body, '\\', (size_t)(len - 1));
+    if (close == NULL) {
+        return -1;
+    }
+    const char *fields_end = close;
+    const char *star = memchr(body, '*', (size_t)(close - body));
+    if (star != NULL) {
+        int digits = (int)(close - star - 1);
+        int expected = 0;
+        for (int i = 1; i <= digits && expected >= 0; i++) {
+            int digit = hex_digit_value(star[i]);
+            expected = digit < 0 ? -1 : (expected << 4) | digit;
+        }
+        if (digits >= 1 && digits <= 2 && expected >= 0) {
+            tags->checksum = nmea_xor(body, (int)(star - body)) == expected;
+        }
+        fields_end = star;
+    }
+
+    for (const char *p = body; p < fields_end;) {
+        const char *comma = memchr(p, ',', (size_t)(fields_end - p));
+        const char *field_end = comma != NULL ? comma : fields_end;
+        const char *value = p + 2;
+        uint64_t number;
+
+        if (field_end - p >= 2 && p[1] == ':') {
+            switch (p[0]) {
+            case 'c':
+                // Unix seconds per the standard; some receivers send milliseconds (13 digits)
+                if (parse_tag_number(value, field_end, &number)) {
+                    tags->time_ms = number >= 100000000000ull ? number : number * 1000;
+                }
+                break;
+            case 's': {
+                int n = (int)(field_end - value);
+                if (n > AIS_SOURCE_CHARS) {
+                    n = AIS_SOURCE_CHARS;
+                }
+                memcpy(tags->source, value, (size_t)n);
+                tags->source[n] = '\0';
+                break;
+            }
+            case 'g': {
+                // Sentence number-total-group ID; only the ID matters, the sentence has the rest
+                const char *id = field_end;
+                while (id > value && id[-1] != '-') {
+                    id--;
+                }
+                if (id > value && parse_tag_number(id, field_end, &number) && number <= 0x3FFFFFFF) {
+                    tags->group_id = (int)number;
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        p = field_end + 1;
+    }
+    return (int)(close - line) + 1;
+}
+
+void fragment_table_init(FragmentTable *table, uint64_t timeout) {
+    memset(table, 0, sizeof(*table));
+    table->timeout = timeout;
+}
+
+// Tag block groups get keys of their own, above every sequence ID and channel key
+static int fragment_key(const NMEASentence *s, const NMEATagBlock *tags) {
+    if (tags != NULL && tags->group_id >= 0) {
+        return (int)(0x40000000u | (uint32_t)tags->group_id);
+    }
+    return ((s->seq_id + 1) << 8) | (unsigned char)s->channel;
+}
+
+static int fragment_home_slot(int key) {
+    return (int)(((uint32_t)key * 2654435761u) >> 26) & (FRAGMENT_TABLE_SIZE - 1);
+}
+
+// Remove a slot, shifting later entries of the probe chain back so lookups stay correct
+static void fragment_table_remove(FragmentTable *table, int index) {
+    int hole = index;
+    int next = (index + 1) & (FRAGMENT_TABLE_SIZE - 1);
+
+    while (table->slots[next].in_use) {
+        int home = fragment_home_slot(table->slots[next].key);
+        // Move the entry if its home slot is not between the hole and its current position
+        if (((next - home) & (FRAGMENT_TABLE_SIZE - 1)) >= ((next - hole) & (FRAGMENT_TABLE_SIZE - 1))) {
+            table->slots[hole] = table->slots[next];
+            hole = next;
+        }
+        next = (next + 1) & (FRAGMENT_TABLE_SIZE - 1);
+    }
+    table->slots[hole].in_use = 0;
+    table->count--;
+}
+
+// Drop a partial message, counting its fragments as orphaned
+static void fragment_table_drop(FragmentTable *table, int index, uint64_t *reason) {
+    table->stats.orphaned_fragments += (uint64_t)table->slots[index].received;
+    (*reason)++;
+    fragment_table_remove(table, index);
+}
+
+// Drop every partial message older than the timeout
+void fragment_table_expire(FragmentTable *table, uint64_t now) {
+    int i = 0;
+    while (i < FRAGMENT_TABLE_SIZE) {
+        FragmentSlot *slot = &table->slots[i];
+        if (slot->in_use && now - slot->first_seen > table->timeout) {
+            // Removal may shift another entry into slot i, so check it again
+            fragment_table_drop(table, i, &table->stats.timed_out);
+        } else {
+            i++;
+        }
+    }
+    table->next_sweep = now + table->timeout / 4 + 1;
+}
+
+static int fragment_table_find(const FragmentTable *table, int key) {
+    int i = fragment_home_slot(key);
+    while (table->slots[i].in_use) {
+        if (table->slots[i].key == key) {
+            return i;
+        }
+        i = (i + 1) & (FRAGMENT_TABLE_SIZE - 1);
+    }
+    return -1;
+}
+
+// Claim a slot for a new partial message, evicting the oldest one if the table is full
+static int fragment_table_insert(FragmentTable *table, int key, uint64_t now) {
+    if (table->count >= FRAGMENT_TABLE_MAX_LOAD) {
+        fragment_table_expire(table, now);
+    }
+    if (table->count >= FRAGMENT_TABLE_MAX_LOAD) {
+        int oldest = -1;
+        for (int j = 0; j < FRAGMENT_TABLE_SIZE; j++) {
+            if (table->slots[j].in_use &&
+                (oldest < 0 || table->slots[j].first_seen < table->slots[oldest].first_seen)) {
+                oldest = j;
+            }
+        }
+        fragment_table_drop(table, oldest, &table->stats.evicted);
+    }
+
+    int i = fragment_home_slot(key);
+    while (table->slots[i].in_use) {
+        i = (i + 1) & (FRAGMENT_TABLE_SIZE - 1);
+    }
+    table->slots[i].in_use = 1;
+    table->slots[i].key = key;
+    table->slots[i].received_mask = 0;
+    table->slots[i].received = 0;
+    table->slots[i].first_seen = now;
+    table->count++;
+    return i;
+}
+
+// Add one fragment with its tag block (NULL if none); returns the assembled payload length once
+// all fragments arrived, else 0. tags then holds the message's receive time and source, which
+// receivers usually put in the first fragment's tag block only
+int fragment_table_add(FragmentTable *table, const NMEASentence *s, NMEATagBlock *tags, uint64_t now,
+                       char *payload_out, int *fill_bits_out) {
+    table->stats.fragments_received++;
+
+    if (table->count > 0 && now >= table->next_sweep) {
+        fragment_table_expire(table, now);
+    }
+
+    if (s->payload_len > MAX_FRAGMENT_LENGTH) {
+        table->stats.orphaned_fragments++;
+        return 0;
+    }
+
+    int key = fragment_key(s, tags);
+    int index = fragment_table_find(table, key);
+
+    // Expire on lookup too, so reassembly never depends on when the last sweep ran
+    if (index >= 0 && now - table->slots[index].first_seen > table->timeout) {
+        fragment_table_drop(table, index, &table->stats.timed_out);
+        index = -1;
+    }
+
+    if (s->fragment_num == 1) {
+        // A new first fragment replaces any unfinished message with the same key
+        if (index >= 0) {
+            fragment_table_drop(table, index, &table->stats.superseded);
+        }
+        index = fragment_table_insert(table, key, now);
+        table->slots[index].fragment_count = s->fragment_count;
+        table->slots[index].tags.time_ms = 0;
+        table->slots[index].tags.source[0] = '\0';
+    } else if (index < 0 ||
+               table->slots[index].fragment_count != s->fragment_count ||
+               (table->slots[index].received_mask & (1 << s->fragment_num))) {
+        // Continuation without a matching start
+        table->stats.orphaned_fragments++;
+        return 0;
+    }
+
+    FragmentSlot *slot = &table->slots[index];
+    memcpy(slot->fragments[s->fragment_num - 1], s->payload, (size_t)s->payload_len);
+    slot->lengths[s->fragment_num - 1] = (unsigned char)s->payload_len;
+    slot->received_mask |= 1 << s->fragment_num;
+    slot->received++;
+    if (tags != NULL && slot->tags.time_ms == 0) {
+        slot->tags.time_ms = tags->time_ms;
+    }
+    if (tags != NULL && slot->tags.source[0] == '\0') {
+        memcpy(slot->tags.source, tags->source, sizeof(slot->tags.source));
+    }
+    if (s->fragment_num == s->fragment_count) {
+        slot->fill_bits = s->fill_bits;
+    }
+
+    if (slot->received < slot->fragment_count) {
+        return 0;
+    }
+
+    // All fragments present: concatenate in order
+    int len = 0;
+    for (int i = 0; i < slot->fragment_count; i++) {
+        if (len + slot->lengths[i] >= MAX_PAYLOAD_LENGTH) {
+            break;
+        }
+        memcpy(payload_out + len, slot->fragments[i], slot->lengths[i]);
+        len += slot->lengths[i];
+    }
+    payload_out[len] = '\0';
+    *fill_bits_out = slot->fill_bits;
+    if (tags != NULL) {
+        tags->time_ms = slot->tags.time_ms;
+        memcpy(tags->source, slot->tags.source, sizeof(tags->source));
+    }
+
+    table->stats.messages_completed++;
+    fragment_table_remove(table, index);
+    return len;
+}
+
+// Extract text from 6-bit encoded field
+void extract_text(const AISBitBuffer *binary_data, int start_pos, int num_chars, char *output) {
+    int len = 0;
+    
+    for (int i = 0; i < num_chars; i++) {
+        int64_t char_bits = extract_bits(binary_data, start_pos + (i * 6), 6);
+        if (char_bits == -1) {
+            break;
+        }
+        
+        // 0-31 map to '@'-'_', 32-63 are ASCII as-is (always printable)
+        output[len++] = (char)(char_bits < 32 ? char_bits + 64 : char_bits);
+    }
+    
+    // Trim trailing spaces
+    while (len > 0 && output[len - 1] == ' ') {
+        len--;
+    }
+    output[len] = '\0';
+}
+
+// Defaults for fields a message type does not carry
+static const AISData AIS_DATA_DEFAULTS = {
+    .nav_status = -1,
+    .heading = AIS_HEADING_NOT_AVAILABLE,
+    .utc_sec = 60
+};
+
+// Initialize AIS data structure
+void init_ais_data(AISData *data) {
+    *data = AIS_DATA_DEFAULTS;
+}
+
+// Copy a tag block's receive time and source into a decoded record
+void ais_data_set_tags(AISData *data, const NMEATagBlock *tags) {
+    data->received_ms = tags->time_ms;
+    memcpy(data->source, tags->source, sizeof(data->source));
+}
+
+/*
+ * Message schema
+ *
+ * Each message type is a list of field entries F(kind, field, pos, width, scale, sentinel, flag):
+ * the AISData field, bit offset and width in the payload, a multiplier into AISData units,
+ * a raw value meaning "not available" (AIS_NO_SENTINEL if none) and an AIS_FLAG_* bit set
+ * when the value is present. Kinds:
+ *   UINT   unsigned value * scale; the sentinel leaves the field at its default
+ *   SINT   two's-complement value * scale, same sentinel rule
+ *   LON    SINT holding the longitude, LAT the latitude, so the position can be located
+ *   CLAMP  unsigned value capped at the sentinel (UTC second 60-63 all mean "not available")
+ *   TEXT   6-bit text of width / 6 characters
+ * AIS_DEFINE_DECODER expands a list into a straight-line function with constant offsets.
+ * Numeric reads skip the bounds check: the min_bits of the list's AIS_MESSAGE_SPECS entry
+ * covers every field in it.
+ */
+#define AIS_NO_SENTINEL INT64_MIN
+
+#define AIS_DECODE_UINT(field, pos, width, scale, sentinel, flag) { \
+        int64_t raw = (int64_t)bitbuf_read(bits, pos, width); \
+        if (raw != (sentinel)) { \
+            data->field = raw * (scale); \
+            data->flags |= (flag); \
+        } \
+    }
+#define AIS_DECODE_SINT(field, pos, width, scale, sentinel, flag) { \
+        int64_t raw = (int64_t)(bitbuf_read(bits, pos, width) << (64 - (width))) >> (64 - (width)); \
+        if (raw != (sentinel)) { \
+            data->field = raw * (scale); \
+            data->flags |= (flag); \
+        } \
+    }
+#define AIS_DECODE_LON AIS_DECODE_SINT
+#define AIS_DECODE_LAT AIS_DECODE_SINT
+#define AIS_DECODE_CLAMP(field, pos, width, scale, sentinel, flag) { \
+        int64_t raw = (int64_t)bitbuf_read(bits, pos, width); \
+        data->field = raw >= (sentinel) ? (sentinel) : raw * (scale); \
+        data->flags |= (flag); \
+    }
+#define AIS_DECODE_TEXT(field, pos, width, scale, sentinel, flag) \
+    extract_text(bits, pos, (width) / 6, data->field);
+
+#define AIS_DECODE_FIELD(kind, field, pos, width, scale, sentinel, flag) \
+    AIS_DECODE_##kind(field, pos, width, scale, sentinel, flag)
+
+#define AIS_DEFINE_DECODER(name, FIELDS) \
+    static void name(const AISBitBuffer *bits, AISData *data) { \
+        FIELDS(AIS_DECODE_FIELD) \
+    }
+
+// Types 1-3: Class A position report
+#define AIS_CLASS_A_POSITION_FIELDS(F) \
+    F(UINT,  nav_status,    38,  4, 1, AIS_NO_SENTINEL, 0) \
+    F(SINT,  rot,           42,  8, 1, AIS_NO_SENTINEL, AIS_FLAG_ROT) \
+    F(UINT,  sog,           50, 10, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy,  60,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           61, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           89, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  cog,          116, 12, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  heading,      128,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(CLAMP, utc_sec,      137,  6, 1, 60, 0) \
+    F(UINT,  raim,         148,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  sync,         149,  2, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  slot,         151,  3, 1, AIS_NO_SENTINEL, 0)
+
+// Types 4 and 11: base station report, UTC/date response
+#define AIS_BASE_STATION_FIELDS(F) \
+    F(UINT,  pos_accuracy,  78,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           79, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,          107, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  raim,         148,  1, 1, AIS_NO_SENTINEL, 0)
+
+// Type 5: static and voyage related data (pos_accuracy holds the EPFD type)
+#define AIS_STATIC_VOYAGE_FIELDS(F) \
+    F(UINT,  ais_version,   38,  2, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  imo,           40, 30, 1, AIS_NO_SENTINEL, 0) \
+    F(TEXT,  callsign,      70, AIS_CALLSIGN_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(TEXT,  ship_name,    112, AIS_NAME_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  ship_type,    232,  8, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_a,        240,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_b,        249,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_c,        258,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_d,        264,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy, 270,  4, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  draught,      294,  8, 1, AIS_NO_SENTINEL, 0) \
+    F(TEXT,  destination,  302, AIS_DESTINATION_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dte,          422,  1, 1, AIS_NO_SENTINEL, 0)
+
+// Type 9: SAR aircraft position report
+#define AIS_SAR_AIRCRAFT_FIELDS(F) \
+    F(UINT,  altitude,      38, 12, 1, 4095, 0) \
+    F(UINT,  sog,           50, 10, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy,  60,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           61, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           89, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  cog,          116, 12, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  utc_sec,      128,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dte,          142,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  raim,         147,  1, 1, AIS_NO_SENTINEL, 0)
+
+// Type 17: DGNSS broadcast (low-resolution position, 1/10 minute)
+#define AIS_DGNSS_FIELDS(F) \
+    F(LON,   lon,           40, 18, 1000, AIS_LOW_RES_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           58, 17, 1000, AIS_LOW_RES_LAT_NOT_AVAILABLE, AIS_FLAG_LAT)
+
+// Type 18: Class B position report
+#define AIS_CLASS_B_POSITION_FIELDS(F) \
+    F(UINT,  sog,           46, 10, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy,  56,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           57, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           85, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  cog,          112, 12, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  heading,      124,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(CLAMP, utc_sec,      133,  6, 1, 60, 0) \
+    F(UINT,  raim,         147,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  sync,         149,  2, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  slot,         151,  3, 1, AIS_NO_SENTINEL, 0)
+
+// Type 19: extended Class B position report
+#define AIS_CLASS_B_EXTENDED_FIELDS(F) \
+    F(UINT,  sog,           46, 10, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy,  56,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           57, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           85, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  cog,          112, 12, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  heading,      124,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(CLAMP, utc_sec,      133,  6, 1, 60, 0) \
+    F(TEXT,  ship_name,    143, AIS_NAME_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  ship_type,    263,  8, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_a,        271,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_b,        280,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_c,        289,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_d,        295,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  raim,         305,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dte,          306,  1, 1, AIS_NO_SENTINEL, 0)
+
+// Type 21: aid-to-navigation report
+#define AIS_AID_TO_NAVIGATION_FIELDS(F) \
+    F(UINT,  aid_type,      38,  5, 1, AIS_NO_SENTINEL, 0) \
+    F(TEXT,  ship_name,     43, AIS_NAME_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  pos_accuracy, 163,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,          164, 28, 1, AIS_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,          192, 27, 1, AIS_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  dim_a,        219,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_b,        228,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_c,        237,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_d,        243,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  utc_sec,      253,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  off_position, 259,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  raim,         268,  1, 1, AIS_NO_SENTINEL, 0)
+
+// Type 21 name extension, decoded only when the message carries all of it
+#define AIS_AID_NAME_EXTENSION_FIELDS(F) \
+    F(TEXT,  name_extension, 272, AIS_NAME_EXTENSION_CHARS * 6, 1, AIS_NO_SENTINEL, 0)
+
+// Type 24 part A: vessel name
+#define AIS_STATIC_PART_A_FIELDS(F) \
+    F(TEXT,  ship_name,     40, AIS_NAME_CHARS * 6, 1, AIS_NO_SENTINEL, 0)
+
+// Type 24 part B: ship type, callsign and dimensions
+#define AIS_STATIC_PART_B_FIELDS(F) \
+    F(UINT,  ship_type,     40,  8, 1, AIS_NO_SENTINEL, 0) \
+    F(TEXT,  callsign,      90, AIS_CALLSIGN_CHARS * 6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_a,        132,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_b,        141,  9, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_c,        150,  6, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  dim_d,        156,  6, 1, AIS_NO_SENTINEL, 0)
+
+// Type 27: long-range broadcast (whole knots/degrees stored in tenths, low-resolution position)
+#define AIS_LONG_RANGE_FIELDS(F) \
+    F(UINT,  pos_accuracy,  38,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  raim,          39,  1, 1, AIS_NO_SENTINEL, 0) \
+    F(UINT,  nav_status,    40,  4, 1, AIS_NO_SENTINEL, 0) \
+    F(LON,   lon,           44, 18, 1000, AIS_LOW_RES_LON_NOT_AVAILABLE, AIS_FLAG_LON) \
+    F(LAT,   lat,           62, 17, 1000, AIS_LOW_RES_LAT_NOT_AVAILABLE, AIS_FLAG_LAT) \
+    F(UINT,  sog,           79,  6, 10, 63, 0) \
+    F(UINT,  cog,           85,  9, 10, AIS_NO_SENTINEL, 0) \
+    F(UINT,  gnss,          94,  1, 1, AIS_NO_SENTINEL, 0)
+
+AIS_DEFINE_DECODER(decode_class_a_position, AIS_CLASS_A_POSITION_FIELDS)
+AIS_DEFINE_DECODER(decode_base_station, AIS_BASE_STATION_FIELDS)
+AIS_DEFINE_DECODER(decode_static_voyage, AIS_STATIC_VOYAGE_FIELDS)
+AIS_DEFINE_DECODER(decode_sar_aircraft, AIS_SAR_AIRCRAFT_FIELDS)
+AIS_DEFINE_DECODER(decode_dgnss, AIS_DGNSS_FIELDS)
+AIS_DEFINE_DECODER(decode_class_b_position, AIS_CLASS_B_POSITION_FIELDS)
+AIS_DEFINE_DECODER(decode_class_b_extended, AIS_CLASS_B_EXTENDED_FIELDS)
+AIS_DEFINE_DECODER(decode_aid_to_navigation_base, AIS_AID_TO_NAVIGATION_FIELDS)
+AIS_DEFINE_DECODER(decode_aid_name_extension, AIS_AID_NAME_EXTENSION_FIELDS)
+AIS_DEFINE_DECODER(decode_static_part_a, AIS_STATIC_PART_A_FIELDS)
+AIS_DEFINE_DECODER(decode_static_part_b, AIS_STATIC_PART_B_FIELDS)
+AIS_DEFINE_DECODER(decode_long_range, AIS_LONG_RANGE_FIELDS)
+
+#define AIS_AID_NAME_EXTENSION_MIN_BITS (272 + AIS_NAME_EXTENSION_CHARS * 6)
+
+static void decode_aid_to_navigation(const AISBitBuffer *bits, AISData *data) {
+    decode_aid_to_navigation_base(bits, data);
+    if (bits->length >= AIS_AID_NAME_EXTENSION_MIN_BITS) {
+        decode_aid_name_extension(bits, data);
+    }
+}
+
+// Type 24 comes in two parts with different layouts
+static void decode_static_data_report(const AISBitBuffer *bits, AISData *data) {
+    switch (bitbuf_read(bits, 38, 2)) {
+    case 0:
+        decode_static_part_a(bits, data);
+        break;
+    case 1:
+        decode_static_part_b(bits, data);
+        break;
+    default:
+        break;
+    }
+}
+
+typedef void (*AISTypeDecoder)(const AISBitBuffer *bits, AISData *data);
+
+// Decoder and minimum payload length of each message type; types without an entry (or too
+// short for it) keep only the common header fields
+typedef struct {
+    AISTypeDecoder decode;
+    int min_bits;
+} AISMessageSpec;
+
+static const AISMessageSpec AIS_MESSAGE_SPECS[28] = {
+    [1]  = {decode_class_a_position, 168},
+    [2]  = {decode_class_a_position, 168},
+    [3]  = {decode_class_a_position, 168},
+    [4]  = {decode_base_station, 168},
+    [5]  = {decode_static_voyage, 424},
+    [9]  = {decode_sar_aircraft, 168},
+    [11] = {decode_base_station, 168},
+    [17] = {decode_dgnss, 80},
+    [18] = {decode_class_b_position, 168},
+    [19] = {decode_class_b_extended, 312},
+    [21] = {decode_aid_to_navigation, 272},
+    [24] = {decode_static_data_report, 168},
+    [27] = {decode_long_range, 96}
+};
+
+// Field read kinds of AISFieldOp, the F kinds of the field lists
+enum {
+    AIS_FIELD_UINT,
+    AIS_FIELD_SINT,
+    AIS_FIELD_CLAMP,
+    AIS_FIELD_TEXT,
+    AIS_FIELD_LON = AIS_FIELD_SINT,
+    AIS_FIELD_LAT = AIS_FIELD_SINT
+};
+
+#define AIS_FIELD_OP_AT(min_bits, kind, field, pos, width, scale, sentinel, flag) \
+    {offsetof(AISData, field), pos, min_bits, width, AIS_FIELD_##kind, (uint8_t)sizeof(((AISData *)0)->field), \
+     flag, scale, sentinel},
+#define AIS_FIELD_OP(kind, field, pos, width, scale, sentinel, flag) \
+    AIS_FIELD_OP_AT(0, kind, field, pos, width, scale, sentinel, flag)
+#define AIS_NAME_EXTENSION_FIELD_OP(kind, field, pos, width, scale, sentinel, flag) \
+    AIS_FIELD_OP_AT(AIS_AID_NAME_EXTENSION_MIN_BITS, kind, field, pos, width, scale, sentinel, flag)
+
+// Column of every op in the tables below, in the same order
+#define AIS_FIELD_COLUMN(kind, field, pos, width, scale, sentinel, flag) AIS_COLUMN_##field,
+
+// All field reads of each layout, in the order the generated decoders make them
+#define AIS_FIELD_LAYOUT_LIST(L) \
+    L(AIS_CLASS_A_POSITION_FIELDS, AIS_FIELD_OP) \
+    L(AIS_BASE_STATION_FIELDS, AIS_FIELD_OP) \
+    L(AIS_STATIC_VOYAGE_FIELDS, AIS_FIELD_OP) \
+    L(AIS_SAR_AIRCRAFT_FIELDS, AIS_FIELD_OP) \
+    L(AIS_DGNSS_FIELDS, AIS_FIELD_OP) \
+    L(AIS_CLASS_B_POSITION_FIELDS, AIS_FIELD_OP) \
+    L(AIS_CLASS_B_EXTENDED_FIELDS, AIS_FIELD_OP) \
+    L(AIS_AID_TO_NAVIGATION_FIELDS, AIS_FIELD_OP) \
+    L(AIS_AID_NAME_EXTENSION_FIELDS, AIS_NAME_EXTENSION_FIELD_OP) \
+    L(AIS_STATIC_PART_A_FIELDS, AIS_FIELD_OP) \
+    L(AIS_STATIC_PART_B_FIELDS, AIS_FIELD_OP) \
+    L(AIS_LONG_RANGE_FIELDS, AIS_FIELD_OP)
+
+#define AIS_FIELD_OP_ENTRIES(FIELDS, OP) FIELDS(OP)
+#define AIS_FIELD_COLUMN_ENTRIES(FIELDS, OP) FIELDS(AIS_FIELD_COLUMN)
+#define AIS_FIELD_LAYOUT_ID(FIELDS, OP) FIELDS##_OPS,
+
+static const AISFieldOp AIS_FIELD_OPS[] = {
+    AIS_FIELD_LAYOUT_LIST(AIS_FIELD_OP_ENTRIES)
+};
+
+static const uint8_t AIS_FIELD_OP_COLUMNS[] = {
+    AIS_FIELD_LAYOUT_LIST(AIS_FIELD_COLUMN_ENTRIES)
+};
+
+// Number of ops in each field list, and where each list starts in AIS_FIELD_OPS
+#define AIS_FIELD_COUNT_ONE(kind, field, pos, width, scale, sentinel, flag) + 1
+#define AIS_FIELD_LIST_SIZE(FIELDS, OP) (0 FIELDS(AIS_FIELD_COUNT_ONE)),
+
+static const uint8_t AIS_FIELD_LIST_SIZES[] = {
+    0,
+    AIS_FIELD_LAYOUT_LIST(AIS_FIELD_LIST_SIZE)
+};
+
+// Index into AIS_FIELD_LIST_SIZES of each list; 0 is no list
+enum {
+    AIS_FIELD_LIST_NONE,
+    AIS_FIELD_LAYOUT_LIST(AIS_FIELD_LAYOUT_ID)
+    AIS_FIELD_LIST_COUNT
+};
+
+_Static_assert(sizeof(AIS_FIELD_OPS) / sizeof(AIS_FIELD_OPS[0]) <= AIS_PROJECTION_MAX_OPS,
+               "AIS_PROJECTION_MAX_OPS is too small for the field lists");
+_Static_assert(AIS_FIELD_LIST_COUNT == AIS_FIELD_LISTS + 1, "AIS_FIELD_LISTS does not match the field lists");
+
+// Field lists read for each message type, then type 24 part B (type 21 reads two)
+#define AIS_STATIC_PART_B_LAYOUT 28
+static const uint8_t AIS_LAYOUT_FIELD_LISTS[29][2] = {
+    [1]  = {AIS_CLASS_A_POSITION_FIELDS_OPS},
+    [2]  = {AIS_CLASS_A_POSITION_FIELDS_OPS},
+    [3]  = {AIS_CLASS_A_POSITION_FIELDS_OPS},
+    [4]  = {AIS_BASE_STATION_FIELDS_OPS},
+    [5]  = {AIS_STATIC_VOYAGE_FIELDS_OPS},
+    [9]  = {AIS_SAR_AIRCRAFT_FIELDS_OPS},
+    [11] = {AIS_BASE_STATION_FIELDS_OPS},
+    [17] = {AIS_DGNSS_FIELDS_OPS},
+    [18] = {AIS_CLASS_B_POSITION_FIELDS_OPS},
+    [19] = {AIS_CLASS_B_EXTENDED_FIELDS_OPS},
+    [21] = {AIS_AID_TO_NAVIGATION_FIELDS_OPS, AIS_AID_NAME_EXTENSION_FIELDS_OPS},
+    [24] = {AIS_STATIC_PART_A_FIELDS_OPS},
+    [27] = {AIS_LONG_RANGE_FIELDS_OPS},
+    [AIS_STATIC_PART_B_LAYOUT] = {AIS_STATIC_PART_B_FIELDS_OPS}
+};
+
+// Column index of a field name ("lat") or CSV header name ("latitude"); -1 if unknown
+int ais_column_index(const char *name, int len) {
+    for (int c = 0; c < RECORD_COLUMN_COUNT; c++) {
+        const char *csv = RECORD_COLUMNS[c].csv_name;
+        if ((int)strlen(RECORD_COLUMNS[c].name) == len && memcmp(RECORD_COLUMNS[c].name, name, (size_t)len) == 0) {
+            return c;
+        }
+        if (csv != NULL && strncmp(csv, name, (size_t)len) == 0 && (csv[len] == '\0' || csv[len] == ',')) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+// Build the decode plan for a mask of AIS_COLUMN_BIT values
+void ais_projection_init(AISProjection *projection, uint64_t columns) {
+    int n = 0;
+
+    projection->columns = columns & AIS_ALL_COLUMNS;
+    projection->all = projection->columns == AIS_ALL_COLUMNS;
+    projection->first_op[0] = 0;
+    for (int list = 1, i = 0; list < AIS_FIELD_LIST_COUNT; list++) {
+        projection->first_op[list] = (uint16_t)n;
+        for (int end = i + AIS_FIELD_LIST_SIZES[list]; i < end; i++) {
+            if ((projection->columns >> AIS_FIELD_OP_COLUMNS[i]) & 1) {
+                projection->ops[n++] = AIS_FIELD_OPS[i];
+            }
+        }
+    }
+    projection->first_op[AIS_FIELD_LIST_COUNT] = (uint16_t)n;
+
+    projection->csv_column_count = 0;
+    for (int c = 0; c < RECORD_COLUMN_COUNT; c++) {
+        if (RECORD_COLUMNS[c].csv_name != NULL && ((projection->columns >> c) & 1)) {
+            projection->csv_columns[projection->csv_column_count++] = (uint8_t)c;
+        }
+    }
+}
+
+// Run a plan's field reads; same results as the generated decoders for those fields
+static void apply_field_ops(const AISFieldOp *op, const AISFieldOp *end, const AISBitBuffer *bits,
+                            AISData *data) {
+    for (; op < end; op++) {
+        uint8_t *field = (uint8_t *)data + op->offset;
+        if (bits->length < op->min_bits) {
+            continue;
+        }
+        if (op->kind == AIS_FIELD_TEXT) {
+            extract_text(bits, op->pos, op->width / 6, (char *)field);
+            continue;
+        }
+
+        int64_t raw = (int64_t)bitbuf_read(bits, op->pos, op->width);
+        int64_t value;
+        if (op->kind == AIS_FIELD_CLAMP) {
+            value = raw >= op->sentinel ? op->sentinel : raw * op->scale;
+        } else {
+            if (op->kind == AIS_FIELD_SINT) {
+                raw = (int64_t)((uint64_t)raw << (64 - op->width)) >> (64 - op->width);
+            }
+            if (raw == op->sentinel) {
+                continue;
+            }
+            value = raw * op->scale;
+        }
+        data->flags |= op->flag;
+
+        switch (op->size) {
+        case 1: {
+            uint8_t v = (uint8_t)value;
+            memcpy(field, &v, 1);
+            break;
+        }
+        case 2: {
+            uint16_t v = (uint16_t)value;
+            memcpy(field, &v, 2);
+            break;
+        }
+        default: {
+            uint32_t v = (uint32_t)value;
+            memcpy(field, &v, 4);
+            break;
+        }
+        }
+    }
+}
+
+// Decode the fields of a type with a plan (type 24 picks its part's layout)
+static void decode_projected(const AISProjection *projection, int msg_type, const AISBitBuffer *bits,
+                             AISData *data) {
+    int layout = msg_type;
+    if (msg_type == 24) {
+        int part = (int)bitbuf_read(bits, 38, 2);
+        if (part > 1) {
+            return;
+        }
+        layout = part == 1 ? AIS_STATIC_PART_B_LAYOUT : 24;
+    }
+    for (int k = 0; k < 2 && AIS_LAYOUT_FIELD_LISTS[layout][k] != AIS_FIELD_LIST_NONE; k++) {
+        int list = AIS_LAYOUT_FIELD_LISTS[layout][k];
+        apply_field_ops(projection->ops + projection->first_op[list], projection->ops + projection->first_op[list + 1],
+                        bits, data);
+    }
+}
+
+// Where a type keeps its position, taken from the LON and LAT entries of its field list
+typedef struct {
+    int16_t pos;
+    int8_t width;
+    int16_t scale;
+    int32_t sentinel;
+} AISPositionField;
+
+typedef struct {
+    AISPositionField lon;
+    AISPositionField lat;
+} AISPositionLayout;
+
+#define AIS_LOCATE_UINT(pos, width, scale, sentinel)
+#define AIS_LOCATE_SINT(pos, width, scale, sentinel)
+#define AIS_LOCATE_CLAMP(pos, width, scale, sentinel)
+#define AIS_LOCATE_TEXT(pos, width, scale, sentinel)
+#define AIS_LOCATE_LON(pos, width, scale, sentinel) .lon = {pos, width, scale, sentinel},
+#define AIS_LOCATE_LAT(pos, width, scale, sentinel) .lat = {pos, width, scale, sentinel},
+#define AIS_LOCATE_FIELD(kind, field, pos, width, scale, sentinel, flag) \
+    AIS_LOCATE_##kind(pos, width, scale, sentinel)
+#define AIS_POSITION_LAYOUT(FIELDS) {FIELDS(AIS_LOCATE_FIELD)}
+
+// Types without a position have width 0
+static const AISPositionLayout AIS_POSITION_LAYOUTS[28] = {
+    [1]  = AIS_POSITION_LAYOUT(AIS_CLASS_A_POSITION_FIELDS),
+    [2]  = AIS_POSITION_LAYOUT(AIS_CLASS_A_POSITION_FIELDS),
+    [3]  = AIS_POSITION_LAYOUT(AIS_CLASS_A_POSITION_FIELDS),
+    [4]  = AIS_POSITION_LAYOUT(AIS_BASE_STATION_FIELDS),
+    [9]  = AIS_POSITION_LAYOUT(AIS_SAR_AIRCRAFT_FIELDS),
+    [11] = AIS_POSITION_LAYOUT(AIS_BASE_STATION_FIELDS),
+    [17] = AIS_POSITION_LAYOUT(AIS_DGNSS_FIELDS),
+    [18] = AIS_POSITION_LAYOUT(AIS_CLASS_B_POSITION_FIELDS),
+    [19] = AIS_POSITION_LAYOUT(AIS_CLASS_B_EXTENDED_FIELDS),
+    [21] = AIS_POSITION_LAYOUT(AIS_AID_TO_NAVIGATION_FIELDS),
+    [27] = AIS_POSITION_LAYOUT(AIS_LONG_RANGE_FIELDS)
+};
+
+// Read one position field the way AIS_DECODE_SINT would; returns 0 if it is the sentinel
+static int read_position_field(const AISBitBuffer *bits, const AISPositionField *f, int32_t *value) {
+    int64_t raw = (int64_t)(bitbuf_read(bits, f->pos, f->width) << (64 - f->width)) >> (64 - f->width);
+    if (raw == f->sentinel) {
+        return 0;
+    }
+    *value = (int32_t)(raw * f->scale);
+    return 1;
+}
+
+// Position of an armoured payload without decoding it: only the characters up to the end of
+// the latitude are de-armoured. Gives the lon/lat decode_ais_payload would (AISData units);
+// returns 0 if the type has no position, the payload is too short to decode or either
+// coordinate is "not available"
+int peek_ais_position(const char *payload, int payload_len, int32_t *lon, int32_t *lat) {
+    if (payload_len < 1) {
+        return 0;
+    }
+    int type = convert_ais_char(payload[0]);
+    if (type < 1 || type > 27 || AIS_POSITION_LAYOUTS[type].lon.width == 0 ||
+        payload_len * 6 < AIS_MESSAGE_SPECS[type].min_bits) {
+        return 0;
+    }
+    const AISPositionLayout *layout = &AIS_POSITION_LAYOUTS[type];
+    int end = layout->lat.pos + layout->lat.width;
+    if (layout->lon.pos + layout->lon.width > end) {
+        end = layout->lon.pos + layout->lon.width;
+    }
+    AISBitBuffer bits;
+    if (!dearmor_payload(payload, (end + 5) / 6, &bits)) {
+        return 0;
+    }
+    return read_position_field(&bits, &layout->lon, lon) && read_position_field(&bits, &layout->lat, lat);
+}
+
+// Decode de-armoured bits into data (already initialised), checking the type and length;
+// projection NULL decodes every field
+static AISStatus decode_ais_bits(const AISProjection *projection, const AISBitBuffer *bits, AISData *data) {
+    if (bits->length >= 6) {
+        data->msg_type = (uint8_t)bitbuf_read(bits, 0, 6);
+        if (data->msg_type < 1 || data->msg_type > 27) {
+            return AIS_STATUS_INVALID_TYPE;
+        }
+    }
+    if (bits->length < 38) {
+        return AIS_STATUS_TOO_SHORT;
+    }
+
+    // Get basic message info
+    data->repeat_ind = (uint8_t)bitbuf_read(bits, 6, 2);
+    data->mmsi = (uint32_t)bitbuf_read(bits, 8, 30);
+
+    const AISMessageSpec *spec = &AIS_MESSAGE_SPECS[data->msg_type];
+    if (spec->decode != NULL && bits->length >= spec->min_bits) {
+        if (projection == NULL || projection->all) {
+            spec->decode(bits, data);
+        } else {
+            decode_projected(projection, data->msg_type, bits, data);
+        }
+    }
+    return AIS_STATUS_DECODED;
+}
+
+// Decode a complete (possibly reassembled) armoured payload, saying why it was not decoded.
+// On AIS_STATUS_INVALID_TYPE, data->msg_type holds the type found
+AISStatus decode_ais_payload_status(const char *payload, int payload_len, AISData *data) {
+    return decode_ais_payload_projected(NULL, payload, payload_len, data);
+}
+
+// decode_ais_payload_status filling only the columns of a plan (NULL = all); the others keep
+// their init_ais_data defaults
+AISStatus decode_ais_payload_projected(const AISProjection *projection, const char *payload, int payload_len,
+                                       AISData *data) {
+    AISBitBuffer bits;
+
+    init_ais_data(data);
+    if (!dearmor_payload(payload, payload_len, &bits)) {
+        return AIS_STATUS_INVALID_CHARS;
+    }
+    return decode_ais_bits(projection, &bits, data);
+}
+
+// Decode a complete (possibly reassembled) armoured payload; returns 0 if it is not a valid message
+int decode_ais_payload(const char *payload, int payload_len, AISData *data) {
+    return decode_ais_payload_status(payload, payload_len, data) == AIS_STATUS_DECODED;
+}
+
+// Main decode function
+int decode_ais(const char *nmea_sentence, AISData *data) {
+    NMEASentence sentence;
+    NMEATagBlock tags;
+    int len = (int)strlen(nmea_sentence);
+    int tag_len = parse_nmea_tag_block(nmea_sentence, len, &tags);
+
+    if (tag_len < 0 || !parse_nmea_sentence(nmea_sentence + tag_len, len - tag_len, &sentence)) {
+        init_ais_data(data);
+        return 0;
+    }
+    int ok = decode_ais_payload(sentence.payload, sentence.payload_len, data);
+    ais_data_set_tags(data, &tags);
+    return ok;
+}
+
+/*
+ * Encoding
+ *
+ * The inverse of decode_ais_payload, generated from the same field lists: AIS_DEFINE_ENCODER
+ * writes each field of an AISData into the payload bits (divided by its scale, or the
+ * sentinel when the field's flag is clear), then the bits are armoured and wrapped in
+ * checksummed !AIVDM sentences. Fields AISData does not carry (type 4's date, type 18's
+ * unit flags, ...) are sent as zero. Text is padded with spaces, which the decoder trims.
+ */
+
+static const char AIS_ARMOUR_CHARS[] = "0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVW`abcdefghijklmnopqrstuvw";
+
+// Write the low bit_length bits of value at start_pos, MSB first (bit_length 1-64)
+static inline void bitbuf_write(AISBitBuffer *bits, int start_pos, int bit_length, uint64_t value) {
+    int word = start_pos >> 6;
+    int offset = start_pos & 63;
+    uint64_t top = value << (64 - bit_length);
+    uint64_t mask = ~0ull << (64 - bit_length);
+    bits->words[word] = (bits->words[word] & ~(mask >> offset)) | (top >> offset);
+    if (offset + bit_length > 64) {
+        bits->words[word + 1] = (bits->words[word + 1] & ~(mask << (64 - offset))) | (top << (64 - offset));
+    }
+}
+
+// Raw field value: the sentinel when the record says the field is absent
+#define AIS_ENCODE_VALUE(field, scale, sentinel, flag) \
+    ((sentinel) != AIS_NO_SENTINEL && (flag) != 0 && !(data->flags & (flag)) \
+        ? (uint64_t)(sentinel) : (uint64_t)(int64_t)(data->field / (scale)))
+
+#define AIS_ENCODE_UINT(field, pos, width, scale, sentinel, flag) \
+    bitbuf_write(bits, pos, width, AIS_ENCODE_VALUE(field, scale, sentinel, flag));
+#define AIS_ENCODE_SINT(field, pos, width, scale, sentinel, flag) \
+    bitbuf_write(bits, pos, width, AIS_ENCODE_VALUE(field, scale, sentinel, flag));
+#define AIS_ENCODE_LON AIS_ENCODE_SINT
+#define AIS_ENCODE_LAT AIS_ENCODE_SINT
+#define AIS_ENCODE_CLAMP(field, pos, width, scale, sentinel, flag) \
+    bitbuf_write(bits, pos, width, AIS_ENCODE_VALUE(field, scale, AIS_NO_SENTINEL, flag));
+#define AIS_ENCODE_TEXT(field, pos, width, scale, sentinel, flag) \
+    encode_text(bits, pos, (width) / 6, data->field);
+
+#define AIS_ENCODE_FIELD(kind, field, pos, width, scale, sentinel, flag) \
+    AIS_ENCODE_##kind(field, pos, width, scale, sentinel, flag)
+
+#define AIS_DEFINE_ENCODER(name, FIELDS) \
+    static void name(AISBitBuffer *bits, const AISData *data) { \
+        FIELDS(AIS_ENCODE_FIELD) \
+    }
+
+// 6-bit text: '@'-'_' are 0-31, ' '-'?' are 32-63; lower case is sent as upper case
+static void encode_text(AISBitBuffer *bits, int start_pos, int num_chars, const char *text) {
+    int ended = 0;
+    for (int i = 0; i < num_chars; i++) {
+        unsigned char c = ended ? ' ' : (unsigned char)text[i];
+        if (c == '\0') {
+            ended = 1;
+            c = ' ';
+        }
+        if (c >= 'a' && c <= 'z') {
+            c = (unsigned char)(c - 32);
+        }
+        bitbuf_write(bits, start_pos + i * 6, 6, (uint64_t)(c >= 64 ? c - 64 : c) & 63);
+    }
+}
+
+AIS_DEFINE_ENCODER(encode_class_a_position, AIS_CLASS_A_POSITION_FIELDS)
+AIS_DEFINE_ENCODER(encode_base_station, AIS_BASE_STATION_FIELDS)
+AIS_DEFINE_ENCODER(encode_static_voyage, AIS_STATIC_VOYAGE_FIELDS)
+AIS_DEFINE_ENCODER(encode_sar_aircraft, AIS_SAR_AIRCRAFT_FIELDS)
+AIS_DEFINE_ENCODER(encode_dgnss, AIS_DGNSS_FIELDS)
+AIS_DEFINE_ENCODER(encode_class_b_position, AIS_CLASS_B_POSITION_FIELDS)
+AIS_DEFINE_ENCODER(encode_class_b_extended, AIS_CLASS_B_EXTENDED_FIELDS)
+AIS_DEFINE_ENCODER(encode_aid_to_navigation, AIS_AID_TO_NAVIGATION_FIELDS)
+AIS_DEFINE_ENCODER(encode_aid_name_extension, AIS_AID_NAME_EXTENSION_FIELDS)
+AIS_DEFINE_ENCODER(encode_static_part_a, AIS_STATIC_PART_A_FIELDS)
+AIS_DEFINE_ENCODER(encode_static_part_b, AIS_STATIC_PART_B_FIELDS)
+AIS_DEFINE_ENCODER(encode_long_range, AIS_LONG_RANGE_FIELDS)
+
+typedef void (*AISTypeEncoder)(AISBitBuffer *bits, const AISData *data);
+
+// Encoder and payload length of each type; 0 bits = the type cannot be encoded
+static const struct {
+    AISTypeEncoder encode;
+    int bits;
+} AIS_MESSAGE_ENCODERS[28] = {
+    [1]  = {encode_class_a_position, 168},
+    [2]  = {encode_class_a_position, 168},
+    [3]  = {encode_class_a_position, 168},
+    [4]  = {encode_base_station, 168},
+    [5]  = {encode_static_voyage, 424},
+    [9]  = {encode_sar_aircraft, 168},
+    [11] = {encode_base_station, 168},
+    [17] = {encode_dgnss, 80},
+    [18] = {encode_class_b_position, 168},
+    [19] = {encode_class_b_extended, 312},
+    [21] = {encode_aid_to_navigation, 272},
+    [24] = {NULL, 168},  // Part A or B, see encode_ais_payload
+    [27] = {encode_long_range, 96}
+};
+
+// Armour a record into payload (NUL-terminated, up to MAX_PAYLOAD_LENGTH - 1 characters).
+// Type 24 is sent as part A when ship_name is set, else as part B, both padded to 168 bits as
+// many transponders do. Returns the payload length and sets *fill_bits, or returns 0 for a
+// type without an encoder
+int encode_ais_payload(const AISData *data, char *payload, int *fill_bits) {
+    AISBitBuffer bits;
+
+    if (data->msg_type < 1 || data->msg_type > 27 || AIS_MESSAGE_ENCODERS[data->msg_type].bits == 0) {
+        return 0;
+    }
+    memset(bits.words, 0, sizeof(bits.words));
+    bitbuf_write(&bits, 0, 6, data->msg_type);
+    bitbuf_write(&bits, 6, 2, data->repeat_ind);
+    bitbuf_write(&bits, 8, 30, data->mmsi);
+
+    int length = AIS_MESSAGE_ENCODERS[data->msg_type].bits;
+    if (data->msg_type == 24) {
+        if (data->ship_name[0] != '\0') {
+            encode_static_part_a(&bits, data);
+        } else {
+            bitbuf_write(&bits, 38, 2, 1);
+            encode_static_part_b(&bits, data);
+        }
+    } else {
+        AIS_MESSAGE_ENCODERS[data->msg_type].encode(&bits, data);
+        if (data->msg_type == 21 && data->name_extension[0] != '\0') {
+            encode_aid_name_extension(&bits, data);
+            length = 272 + AIS_NAME_EXTENSION_CHARS * 6;
+        }
+    }
+
+    int num_chars = (length + 5) / 6;
+    for (int i = 0; i < num_chars; i++) {
+        payload[i] = AIS_ARMOUR_CHARS[bitbuf_read(&bits, i * 6, 6)];
+    }
+    payload[num_chars] = '\0';
+    *fill_bits = num_chars * 6 - length;
+    return num_chars;
+}
+
+// Wrap an armoured payload in !AIVDM sentences of at most AIS_SENTENCE_PAYLOAD_CHARS payload
+// characters each, with checksums and "\n" line ends. seq_id (0-9) is used only when the
+// payload needs several sentences. out needs AIS_MAX_SENTENCE_BYTES per sentence; returns
+// the bytes written
+int encode_nmea_sentences(const char *payload, int payload_len, int fill_bits, char channel, int seq_id,
+                          char *out) {
+    int count = (payload_len + AIS_SENTENCE_PAYLOAD_CHARS - 1) / AIS_SENTENCE_PAYLOAD_CHARS;
+    char *p = out;
+
+    if (count < 1) {
+        count = 1;
+    }
+    for (int n = 1; n <= count; n++) {
+        char *start = p;
+        int offset = (n - 1) * AIS_SENTENCE_PAYLOAD_CHARS;
+        int chars = payload_len - offset < AIS_SENTENCE_PAYLOAD_CHARS ? payload_len - offset
+                                                                      : AIS_SENTENCE_PAYLOAD_CHARS;
+        memcpy(p, "!AIVDM,", 7);
+        p += 7;
+        *p++ = (char)('0' + count);
+        *p++ = ',';
+        *p++ = (char)('0' + n);
+        *p++ = ',';
+        if (count > 1) {
+            *p++ = (char)('0' + seq_id % 10);
+        }
+        *p++ = ',';
+        if (channel != '\0') {
+            *p++ = channel;
+        }
+        *p++ = ',';
+        memcpy(p, payload + offset, (size_t)chars);
+        p += chars;
+        *p++ = ',';
+        *p++ = (char)('0' + (n == count ? fill_bits : 0));
+
+        uint8_t sum = nmea_xor(start + 1, (int)(p - start - 1));
+        *p++ = '*';
+        *p++ = "0123456789ABCDEF"[sum >> 4];
+        *p++ = "0123456789ABCDEF"[sum & 15];
+        *p++ = '\n';
+    }
+    return (int)(p - out);
+}
+
+// Tenths of a degree printed for each |raw ROT| 0-126: (raw / 4.733)^2 rounded like "%.1f"
+static const uint16_t ROT_TENTHS[127] = {
+    0, 0, 2, 4, 7, 11, 16, 22, 29, 36, 45, 54,
+    64, 75, 87, 100, 114, 129, 145, 161, 179, 197, 216, 236,
+    257, 279, 302, 325, 350, 375, 402, 429, 457, 486, 516, 547,
+    579, 611, 645, 679, 714, 750, 787, 825, 864, 904, 945, 986,
+    1029, 1072, 1116, 1161, 1207, 1254, 1302, 1350, 1400, 1450, 1502, 1554,
+    1607, 1661, 1716, 1772, 1828, 1886, 1945, 2004, 2064, 2125, 2187, 2250,
+    2314, 2379, 2445, 2511, 2578, 2647, 2716, 2786, 2857, 2929, 3002, 3075,
+    3150, 3225, 3302, 3379, 3457, 3536, 3616, 3697, 3778, 3861, 3944, 4029,
+    4114, 4200, 4287, 4375, 4464, 4554, 4644, 4736, 4828, 4922, 5016, 5111,
+    5207, 5304, 5401, 5500, 5600, 5700, 5801, 5904, 6007, 6111, 6216, 6322,
+    6428, 6536, 6644, 6754, 6864, 6975, 7087
+};
+
+
+static char *put_uint(char *out, uint32_t value) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+static char *put_int(char *out, int32_t value) {
+    if (value < 0) {
+        *out++ = '-';
+        return put_uint(out, (uint32_t)(-(int64_t)value));
+    }
+    return put_uint(out, (uint32_t)value);
+}
+
+// Fixed point with one decimal, e.g. 183 -> "18.3"
+static char *put_tenths(char *out, uint32_t tenths) {
+    out = put_uint(out, tenths / 10);
+    *out++ = '.';
+    *out++ = (char)('0' + tenths % 10);
+    return out;
+}
+
+static char *put_text(char *out, const char *text) {
+    while (*text) {
+        *out++ = *text++;
+    }
+    return out;
+}
+
+// |degrees| with 7 decimals from 1/10000 minute units, then the hemisphere column.
+// raw / 600000 degrees is raw * 50 / 3 ten-millionths; the remainder is never a tie,
+// so integer rounding matches "%.7f" exactly
+static char *put_coordinate(char *out, int32_t raw, int present, char positive, char negative) {
+    if (!present) {
+        *out++ = '0';
+        *out++ = ',';
+        *out++ = positive;
+        return out;
+    }
+
+    uint64_t magnitude = raw < 0 ? (uint64_t)(-(int64_t)raw) : (uint64_t)raw;
+    uint64_t ten_millionths = (magnitude * 50 + 1) / 3;
+    uint32_t fraction = (uint32_t)(ten_millionths % 10000000);
+
+    out = put_uint(out, (uint32_t)(ten_millionths / 10000000));
+    *out++ = '.';
+    for (uint32_t div = 1000000; div > 0; div /= 10) {
+        *out++ = (char)('0' + (fraction / div) % 10);
+    }
+    *out++ = ',';
+    *out++ = raw < 0 ? negative : positive;
+    return out;
+}
+
+static char *put_rot(char *out, const AISData *data) {
+    if (!(data->flags & AIS_FLAG_ROT)) {
+        *out++ = '0';
+        return out;
+    }
+    switch (data->rot) {
+    case -128: return put_text(out, "-128.0");
+    case -127: return put_text(out, "-720.0");
+    case 127:  return put_text(out, "+127.0");
+    default:
+        break;
+    }
+    *out++ = data->rot < 0 ? '-' : '+';
+    return put_tenths(out, ROT_TENTHS[data->rot < 0 ? -data->rot : data->rot]);
+}
+
+// Unix seconds with milliseconds, or nothing when there is no receive time
+static char *put_time(char *out, uint64_t ms) {
+    if (ms == 0) {
+        return out;
+    }
+    uint32_t millis = (uint32_t)(ms % 1000);
+    out = put_uint(out, (uint32_t)(ms / 1000));
+    *out++ = '.';
+    *out++ = (char)('0' + millis / 100);
+    *out++ = (char)('0' + millis / 10 % 10);
+    *out++ = (char)('0' + millis % 10);
+    return out;
+}
+
+// CSV formatting of each kind in AIS_RECORD_COLUMNS, with its trailing separator
+#define AIS_CSV_PUT_UINT(field)    out = put_uint(out, data->field); *out++ = ',';
+#define AIS_CSV_PUT_INT(field)     out = put_int(out, data->field); *out++ = ',';
+#define AIS_CSV_PUT_ROT(field)     out = put_rot(out, data); *out++ = ',';
+#define AIS_CSV_PUT_SOG(field)     out = put_tenths(out, data->field == AIS_SOG_NOT_AVAILABLE ? 0 : data->field); *out++ = ',';
+#define AIS_CSV_PUT_COG(field)     out = put_tenths(out, data->field >= AIS_COG_NOT_AVAILABLE ? AIS_COG_NOT_AVAILABLE : data->field); *out++ = ',';
+#define AIS_CSV_PUT_LON(field)     out = put_coordinate(out, data->field, data->flags & AIS_FLAG_LON, 'E', 'W'); *out++ = ',';
+#define AIS_CSV_PUT_LAT(field)     out = put_coordinate(out, data->field, data->flags & AIS_FLAG_LAT, 'N', 'S'); *out++ = ',';
+#define AIS_CSV_PUT_TEXT(field)    out = put_text(out, data->field); *out++ = ',';
+#define AIS_CSV_PUT_TIME(field)    out = put_time(out, data->field); *out++ = ',';
+#define AIS_CSV_PUT_DRAUGHT(field) out = data->field > 0 ? put_tenths(out, data->field) : put_text(out, "0"); *out++ = ',';
+#define AIS_CSV_PUT_NONE(field)
+
+#define AIS_CSV_PUT(field, csv, csv_name, dtype, flags) AIS_CSV_PUT_##csv(field)
+
+// Convert decoded data to CSV line; returns its length
+int make_csv_line(const AISData *data, char *output) {
+    char *out = output;
+
+    AIS_RECORD_COLUMNS(AIS_CSV_PUT)
+    *--out = '\0'; // Drop the last separator
+    return (int)(out - output);
+}
+
+// Write the CSV header line matching make_csv_line
+void write_csv_header(FILE *file) {
+    const char *separator = "";
+    for (int c = 0; c < RECORD_COLUMN_COUNT; c++) {
+        if (RECORD_COLUMNS[c].csv_name != NULL) {
+            fprintf(file, "%s%s", separator, RECORD_COLUMNS[c].csv_name);
+            separator = ",";
+        }
+    }
+    fputc('\n', file);
+}
+
+#define AIS_CSV_CASE(field, csv, csv_name, dtype, flags) \
+    case AIS_COLUMN_##field: \
+        AIS_CSV_PUT_##csv(field) \
+        break;
+
+// make_csv_line with only the columns of a plan (NULL = all)
+int make_csv_line_projected(const AISProjection *projection, const AISData *data, char *output) {
+    if (projection == NULL || projection->all) {
+        return make_csv_line(data, output);
+    }
+
+    char *out = output;
+    for (int i = 0; i < projection->csv_column_count; i++) {
+        switch (projection->csv_columns[i]) {
+        AIS_RECORD_COLUMNS(AIS_CSV_CASE)
+        default:
+            break;
+        }
+    }
+    if (out > output) {
+        out--; // Drop the last separator
+    }
+    *out = '\0';
+    return (int)(out - output);
+}
+
+// Write the CSV header line matching make_csv_line_projected
+void write_csv_header_projected(FILE *file, const AISProjection *projection) {
+    if (projection == NULL || projection->all) {
+        write_csv_header(file);
+        return;
+    }
+    for (int i = 0; i < projection->csv_column_count; i++) {
+        fprintf(file, "%s%s", i ? "," : "", RECORD_COLUMNS[projection->csv_columns[i]].csv_name);
+    }
+    fputc('\n', file);
+}
+
+/*
+ * Batch decoding
+ *
+ * decode_ais_batch takes a block of sentences through one stage at a time: checksum and
+ * split, reassembly, de-armouring, then field decoding grouped by message type. Each stage
+ * is a tight loop over the block (the SIMD checksum and de-armouring kernels back to back,
+ * one decoder function per type group) instead of a dispatch per sentence. All state is in
+ * the caller's AISDecoder and all output in the caller's arrays; nothing is allocated.
+ */
+#define AIS_BATCH_BLOCK 64  // Sentences per pass through the stages
+
+void ais_decoder_init(AISDecoder *decoder, int verify_checksums) {
+    fragment_table_init(&decoder->fragments, FRAGMENT_TIMEOUT_LINES);
+    decoder->line_clock = 0;
+    decoder->verify_checksums = verify_checksums;
+    decoder->kernel = select_dearmor_kernel();
+    decoder->projection = NULL;
+}
+
+// Decode up to one block; see decode_ais_batch
+static int decode_ais_block(AISDecoder *decoder, const char *const *sentences, const int *lengths, int count,
+                            int first, AISData *records, int *sources, uint8_t *statuses) {
+    const char *payloads[AIS_BATCH_BLOCK];
+    int payload_lens[AIS_BATCH_BLOCK];
+    int origins[AIS_BATCH_BLOCK];
+    NMEATagBlock tags[AIS_BATCH_BLOCK];
+    char assembled[AIS_BATCH_BLOCK][MAX_PAYLOAD_LENGTH];
+    AISBitBuffer bits[AIS_BATCH_BLOCK];
+    uint8_t types[AIS_BATCH_BLOCK];
+    int by_type[AIS_BATCH_BLOCK];
+    int type_start[29];
+    int num_payloads = 0;
+
+    // Checksum, split and reassembly, in input order
+    for (int i = 0; i < count; i++) {
+        const char *line = sentences[i];
+        int len = lengths != NULL ? lengths[i] : (int)strlen(line);
+        AISStatus status = AIS_STATUS_FRAGMENT;
+        NMEASentence sentence;
+        NMEATagBlock *tag_block = &tags[num_payloads];
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            len--;
+        }
+        int tag_len = len > 0 ? parse_nmea_tag_block(line, len, tag_block) : 0;
+        if (tag_len > 0) {
+            line += tag_len;
+            len -= tag_len;
+        }
+        if (len == 0 && tag_len == 0) {
+            status = AIS_STATUS_EMPTY;
+        } else {
+            decoder->line_clock++;
+            int checksum = decoder->verify_checksums ? verify_nmea_checksum(line, len) : 1;
+            if (checksum == 1 && decoder->verify_checksums && tag_block->checksum == 0) {
+                checksum = 0;
+            }
+            if (tag_len < 0) {
+                status = AIS_STATUS_MALFORMED;
+            } else if (checksum != 1) {
+                status = checksum == 0 ? AIS_STATUS_BAD_CHECKSUM : AIS_STATUS_MISSING_CHECKSUM;
+            } else if (!parse_nmea_sentence(line, len, &sentence)) {
+                status = AIS_STATUS_MALFORMED;
+            } else if (sentence.fragment_count == 1) {
+                payloads[num_payloads] = sentence.payload;
+                payload_lens[num_payloads] = sentence.payload_len;
+                origins[num_payloads++] = i;
+            } else {
+                int fill_bits;
+                int n = fragment_table_add(&decoder->fragments, &sentence, tag_block, decoder->line_clock,
+                                           assembled[num_payloads], &fill_bits);
+                if (n > 0) {
+                    payloads[num_payloads] = assembled[num_payloads];
+                    payload_lens[num_payloads] = n;
+                    origins[num_payloads++] = i;
+                }
+            }
+        }
+        if (statuses != NULL) {
+            statuses[i] = (uint8_t)status;
+        }
+    }
+
+    // De-armour every complete payload and check its type and length
+    int num_valid = 0;
+    memset(type_start, 0, sizeof(type_start));
+    for (int k = 0; k < num_payloads; k++) {
+        AISStatus status = AIS_STATUS_DECODED;
+        if (!dearmor_with_kernel(decoder->kernel, payloads[k], payload_lens[k], &bits[k])) {
+            status = AIS_STATUS_INVALID_CHARS;
+        } else if (bits[k].length >= 6 &&
+                   (bitbuf_read(&bits[k], 0, 6) < 1 || bitbuf_read(&bits[k], 0, 6) > 27)) {
+            status = AIS_STATUS_INVALID_TYPE;
+        } else if (bits[k].length < 38) {
+            status = AIS_STATUS_TOO_SHORT;
+        }
+        if (statuses != NULL) {
+            statuses[origins[k]] = (uint8_t)status;
+        }
+        if (status != AIS_STATUS_DECODED) {
+            continue;
+        }
+        types[num_valid] = (uint8_t)bitbuf_read(&bits[k], 0, 6);
+        origins[num_valid] = origins[k];
+        if (num_valid != k) {
+            bits[num_valid] = bits[k];
+            tags[num_valid] = tags[k];
+        }
+        type_start[types[num_valid] + 1]++;
+        num_valid++;
+    }
+
+    // Group by type (counting sort), then run each type's decoder over its whole group;
+    // records keep input order because each one goes to its own slot
+    for (int t = 1; t <= 28; t++) {
+        type_start[t] += type_start[t - 1];
+    }
+    for (int k = 0; k < num_valid; k++) {
+        by_type[type_start[types[k]]++] = k;
+    }
+    for (int g = 0; g < num_valid;) {
+        const AISMessageSpec *spec = &AIS_MESSAGE_SPECS[types[by_type[g]]];
+        int type = types[by_type[g]];
+        for (; g < num_valid && types[by_type[g]] == type; g++) {
+            int k = by_type[g];
+            const AISBitBuffer *b = &bits[k];
+            AISData *data = &records[k];
+            *data = AIS_DATA_DEFAULTS;
+            ais_data_set_tags(data, &tags[k]);
+            data->msg_type = (uint8_t)type;
+            data->repeat_ind = (uint8_t)bitbuf_read(b, 6, 2);
+            data->mmsi = (uint32_t)bitbuf_read(b, 8, 30);
+            if (spec->decode == NULL || b->length < spec->min_bits) {
+                continue;
+            }
+            if (decoder->projection == NULL || decoder->projection->all) {
+                spec->decode(b, data);
+            } else {
+                decode_projected(decoder->projection, type, b, data);
+            }
+        }
+    }
+    if (sources != NULL) {
+        for (int k = 0; k < num_valid; k++) {
+            sources[k] = first + origins[k];
+        }
+    }
+    return num_valid;
+}
+
+// Decode count sentences (lengths NULL = NUL-terminated; a trailing "\r\n" is ignored) into
+// records, which needs room for count entries; records come out in input order, a
+// multi-sentence message at the position of its last sentence. sources (optional) gets the
+// index of the sentence that completed each record, statuses (optional) an AISStatus per
+// sentence. Returns the number of records written
+int decode_ais_batch(AISDecoder *decoder, const char *const *sentences, const int *lengths, int count,
+                     AISData *records, int *sources, uint8_t *statuses) {
+    int written = 0;
+    for (int first = 0; first < count; first += AIS_BATCH_BLOCK) {
+        int n = count - first < AIS_BATCH_BLOCK ? count - first : AIS_BATCH_BLOCK;
+        written += decode_ais_block(decoder, sentences + first, lengths != NULL ? lengths + first : NULL, n, first,
+                                    records + written, sources != NULL ? sources + written : NULL,
+                                    statuses != NULL ? statuses + first : NULL);
+    }
+    return written;
+}
@@ -0,0 +1,338 @@
+/*
+ * AIS Decoding Library for Final Year Project
+ * Purpose: Public types and functions of ais_decoder_lib.c - NMEA parsing, reassembly,
+ *          decoding (one sentence at a time or in batches), encoding and CSV formatting
+ * Build: gcc -O2 app.c ais_decoder_lib.c -lm -lpthread
+ *
+ * There is no global mutable state: everything a decoder keeps between sentences is in the
+ * caller's AISDecoder (or FragmentTable), so threads with their own decoders need no locking.
+ * Nothing is allocated; all buffers are supplied by the caller.
+ */
+
+#ifndef AIS_DECODER_LIB_H
+#define AIS_DECODER_LIB_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAX_LINE_LENGTH 1024
+#define MAX_PAYLOAD_LENGTH 256
+#define MAX_BINARY_LENGTH 1536
+
+// Longest 6-bit text fields (characters, excluding the terminator)
+#define AIS_NAME_CHARS 20
+#define AIS_CALLSIGN_CHARS 7
+#define AIS_DESTINATION_CHARS 20
+#define AIS_NAME_EXTENSION_CHARS 14
+#define AIS_SOURCE_CHARS 15          // Tag block source (s:) kept, longer ones are cut
+
+// Multi-sentence reassembly limits
+#define MAX_FRAGMENTS 9              // Fragment count is a single NMEA digit
+#define MAX_FRAGMENT_LENGTH 96       // Payload chars per sentence (NMEA caps sentences at 82 chars)
+#define FRAGMENT_TABLE_SIZE 64       // Open-addressing slots, power of two
+#define FRAGMENT_TABLE_MAX_LOAD 48   // Oldest partial message is evicted beyond this
+#define FRAGMENT_TIMEOUT_LINES 200   // Partial messages older than this many lines are dropped
+// Encoding
+#define AIS_SENTENCE_PAYLOAD_CHARS 60  // Payload characters per sentence before splitting
+#define AIS_MAX_SENTENCE_BYTES 96      // One encoded sentence including "\n"
+
+// Field-present bits in AISData.flags
+#define AIS_FLAG_LON 0x01  // Longitude available (the message has a position)
+#define AIS_FLAG_LAT 0x02  // Latitude available
+#define AIS_FLAG_ROT 0x04  // Rate of turn field present (types 1-3)
+
+// Sentinels in the raw fields
+#define AIS_SOG_NOT_AVAILABLE 1023
+#define AIS_COG_NOT_AVAILABLE 3600
+#define AIS_HEADING_NOT_AVAILABLE 511
+#define AIS_LON_NOT_AVAILABLE 0x6791AC0          // 181 degrees in 1/10000 minute
+#define AIS_LAT_NOT_AVAILABLE 0x3412140          // 91 degrees
+#define AIS_LOW_RES_LON_NOT_AVAILABLE 0x1A838    // 181 degrees in 1/10 minute (types 17, 27)
+#define AIS_LOW_RES_LAT_NOT_AVAILABLE 0xD548     // 91 degrees
+
+// Structure to hold decoded AIS data as scaled integers; text is produced only by make_csv_line
+typedef struct {
+    uint32_t mmsi;
+    uint32_t imo;
+    int32_t lon;             // 1/10000 minute (degrees * 600000), valid with AIS_FLAG_LON
+    int32_t lat;             // 1/10000 minute, valid with AIS_FLAG_LAT
+    uint64_t received_ms;    // Receive time (Unix ms), 0 if the input has no clock
+    uint16_t sog;            // Knots * 10, AIS_SOG_NOT_AVAILABLE if unknown
+    uint16_t cog;            // Degrees * 10, >= AIS_COG_NOT_AVAILABLE if unknown
+    uint16_t heading;        // Degrees, AIS_HEADING_NOT_AVAILABLE if unknown
+    uint16_t altitude;
+    uint16_t dim_a;
+    uint16_t dim_b;
+    uint8_t dim_c;
+    uint8_t dim_d;
+    uint8_t msg_type;
+    uint8_t repeat_ind;
+    int8_t nav_status;       // -1 when the message has none
+    int8_t rot;              // Raw ROT indicator, valid with AIS_FLAG_ROT
+    uint8_t pos_accuracy;
+    uint8_t utc_sec;
+    uint8_t sync;
+    uint8_t slot;
+    uint8_t raim;
+    uint8_t ship_type;
+    uint8_t draught;         // Metres * 10
+    uint8_t ais_version;
+    uint8_t dte;
+    uint8_t aid_type;
+    uint8_t off_position;
+    uint8_t gnss;
+    uint8_t flags;           // AIS_FLAG_* bits
+    char ship_name[AIS_NAME_CHARS + 1];
+    char callsign[AIS_CALLSIGN_CHARS + 1];
+    char destination[AIS_DESTINATION_CHARS + 1];
+    char name_extension[AIS_NAME_EXTENSION_CHARS + 1];
+    char source[AIS_SOURCE_CHARS + 1];  // Receiving station from the tag block, "" if none
+} AISData;
+// Packed bit buffer holding the de-armoured payload, MSB first
+#define BITBUF_WORDS ((MAX_BINARY_LENGTH + 63) / 64)
+
+typedef struct {
+    uint64_t words[BITBUF_WORDS + 1]; // Spare word so a read never needs a bounds branch
+    int length;                       // Number of valid bits
+} AISBitBuffer;
+
+// Read up to 64 raw bits starting at start_pos (no bounds check)
+static inline uint64_t bitbuf_read(const AISBitBuffer *bits, int start_pos, int bit_length) {
+    int word = start_pos >> 6;
+    int offset = start_pos & 63;
+    uint64_t hi = bits->words[word] << offset;
+    uint64_t lo = offset ? bits->words[word + 1] >> (64 - offset) : 0;
+    return (hi | lo) >> (64 - bit_length);
+}
+// De-armouring kernel: consumes a multiple of 4 characters, returns count consumed or -1
+typedef int (*DearmorKernel)(const unsigned char *payload, int num_chars, uint8_t *packed);
+
+// Fields of an AIVDM/AIVDO sentence; payload points into the original line
+typedef struct {
+    int fragment_count;
+    int fragment_num;
+    int seq_id;          // -1 when the field is empty
+    char channel;        // '\0' when the field is empty
+    const char *payload;
+    int payload_len;
+    int fill_bits;
+} NMEASentence;
+
+// NMEA 4.0 tag block, e.g. \g:1-2-73,s:rx1,c:1697040000*5A\ in front of a sentence
+typedef struct {
+    uint64_t time_ms;    // c: receive time as Unix ms, 0 if absent
+    int group_id;        // g: sentence group, keys reassembly instead of sequence ID and channel; -1 if absent
+    int checksum;        // 1 matches, 0 mismatch, -1 no checksum (like verify_nmea_checksum)
+    char source[AIS_SOURCE_CHARS + 1];  // s: receiving station, "" if absent
+} NMEATagBlock;
+// Partial multi-sentence message waiting for its remaining fragments
+typedef struct {
+    int in_use;
+    int key;
+    int fragment_count;
+    int received_mask;
+    int received;
+    int fill_bits;
+    uint64_t first_seen;
+    NMEATagBlock tags;   // Receive time and source of the message, from whichever fragment had them
+    unsigned char lengths[MAX_FRAGMENTS];
+    char fragments[MAX_FRAGMENTS][MAX_FRAGMENT_LENGTH];
+} FragmentSlot;
+
+// Reassembly statistics
+typedef struct {
+    uint64_t fragments_received;
+    uint64_t messages_completed;
+    uint64_t orphaned_fragments;  // Fragments discarded without completing a message
+    uint64_t timed_out;           // Partial messages dropped after FRAGMENT_TIMEOUT_LINES
+    uint64_t evicted;             // Partial messages dropped because the table was full
+    uint64_t superseded;          // Partial messages replaced by a new message with the same key
+} FragmentStats;
+
+// Fixed-size reassembly table keyed by sequence ID and channel
+typedef struct {
+    FragmentSlot slots[FRAGMENT_TABLE_SIZE];
+    int count;
+    uint64_t timeout;
+    uint64_t next_sweep;
+    FragmentStats stats;
+} FragmentTable;
+// Outcome of one sentence (decode_ais_payload_status, decode_ais_batch)
+typedef enum {
+    AIS_STATUS_DECODED,           // A record was produced
+    AIS_STATUS_FRAGMENT,          // Part of a multi-sentence message still being assembled
+    AIS_STATUS_EMPTY,             // Blank line
+    AIS_STATUS_BAD_CHECKSUM,
+    AIS_STATUS_MISSING_CHECKSUM,
+    AIS_STATUS_MALFORMED,         // Not an AIVDM/AIVDO sentence
+    AIS_STATUS_INVALID_CHARS,     // Payload outside the 6-bit armouring alphabet
+    AIS_STATUS_INVALID_TYPE,      // Message type outside 1-27
+    AIS_STATUS_TOO_SHORT          // Fewer bits than the common header
+} AISStatus;
+
+#define COLUMNAR_DICTIONARY 0x01     // Column flag: u4 ids into the string dictionary
+
+/*
+ * Output record
+ *
+ * One entry C(field, csv, csv_name, dtype, flags) per AISData field, in CSV column order.
+ * csv names the put_* formatting of make_csv_line (NONE = not in the CSV), csv_name the
+ * header column(s) it writes, dtype and flags describe the columnar array. make_csv_line,
+ * the CSV header and the columnar writer are all generated from this list.
+ */
+#define AIS_RECORD_COLUMNS(C) \
+    C(msg_type,       UINT,    "message_type",             "|u1", 0) \
+    C(repeat_ind,     UINT,    "repeat_indicator",         "|u1", 0) \
+    C(mmsi,           UINT,    "mmsi",                     "<u4", 0) \
+    C(nav_status,     INT,     "navigation_status",        "|i1", 0) \
+    C(rot,            ROT,     "rate_of_turn",             "|i1", 0) \
+    C(sog,            SOG,     "speed_over_ground",        "<u2", 0) \
+    C(pos_accuracy,   UINT,    "position_accuracy",        "|u1", 0) \
+    C(lon,            LON,     "longitude,lon_hemisphere", "<i4", 0) \
+    C(lat,            LAT,     "latitude,lat_hemisphere",  "<i4", 0) \
+    C(cog,            COG,     "course_over_ground",       "<u2", 0) \
+    C(heading,        UINT,    "true_heading",             "<u2", 0) \
+    C(utc_sec,        UINT,    "utc_second",               "|u1", 0) \
+    C(sync,           UINT,    "sync_state",               "|u1", 0) \
+    C(slot,           UINT,    "slot_timeout",             "|u1", 0) \
+    C(raim,           UINT,    "raim_flag",                "|u1", 0) \
+    C(ship_name,      TEXT,    "ship_name",                "<u4", COLUMNAR_DICTIONARY) \
+    C(ship_type,      UINT,    "ship_type",                "|u1", 0) \
+    C(callsign,       TEXT,    "callsign",                 "<u4", COLUMNAR_DICTIONARY) \
+    C(destination,    TEXT,    "destination",              "<u4", COLUMNAR_DICTIONARY) \
+    C(draught,        DRAUGHT, "draught",                  "|u1", 0) \
+    C(imo,            UINT,    "imo",                      "<u4", 0) \
+    C(dim_a,          UINT,    "dim_a",                    "<u2", 0) \
+    C(dim_b,          UINT,    "dim_b",                    "<u2", 0) \
+    C(dim_c,          UINT,    "dim_c",                    "|u1", 0) \
+    C(dim_d,          UINT,    "dim_d",                    "|u1", 0) \
+    C(ais_version,    UINT,    "ais_version",              "|u1", 0) \
+    C(dte,            UINT,    "dte",                      "|u1", 0) \
+    C(altitude,       UINT,    "altitude",                 "<u2", 0) \
+    C(aid_type,       UINT,    "aid_type",                 "|u1", 0) \
+    C(name_extension, TEXT,    "name_extension",           "<u4", COLUMNAR_DICTIONARY) \
+    C(off_position,   UINT,    "off_position",             "|u1", 0) \
+    C(gnss,           UINT,    "gnss",                     "|u1", 0) \
+    C(received_ms,    TIME,    "receive_time",             "<u8", 0) \
+    C(source,         TEXT,    "source",                   "<u4", COLUMNAR_DICTIONARY) \
+    C(flags,          NONE,    NULL,                       "|u1", 0)
+
+// One field of the output record
+typedef struct {
+    const char *name;      // AISData field, also the columnar column name
+    const char *csv_name;  // CSV header column(s), NULL if not written to the CSV
+    const char *dtype;     // numpy type string of the columnar array
+    int width;             // Bytes per columnar value
+    size_t offset;         // Offset of the field in AISData
+    uint32_t flags;        // COLUMNAR_DICTIONARY for text fields
+} RecordColumn;
+
+#define AIS_RECORD_COLUMN_ENTRY(field, csv, csv_name, dtype, flags) \
+    {#field, csv_name, dtype, ((flags) & COLUMNAR_DICTIONARY) ? 4 : (int)sizeof(((AISData *)0)->field), \
+     offsetof(AISData, field), flags},
+
+static const RecordColumn RECORD_COLUMNS[] = {
+    AIS_RECORD_COLUMNS(AIS_RECORD_COLUMN_ENTRY)
+};
+
+#define RECORD_COLUMN_COUNT ((int)(sizeof(RECORD_COLUMNS) / sizeof(RECORD_COLUMNS[0])))
+
+// Index of each field in RECORD_COLUMNS, e.g. AIS_COLUMN_lat, and its bit in a column mask
+#define AIS_RECORD_COLUMN_ID(field, csv, csv_name, dtype, flags) AIS_COLUMN_##field,
+typedef enum {
+    AIS_RECORD_COLUMNS(AIS_RECORD_COLUMN_ID)
+    AIS_COLUMN_COUNT
+} AISColumnId;
+
+#define AIS_COLUMN_BIT(field) (1ull << AIS_COLUMN_##field)
+#define AIS_ALL_COLUMNS ((1ull << AIS_COLUMN_COUNT) - 1)
+
+/*
+ * Column projection
+ *
+ * ais_projection_init turns a column mask into a decode plan: for each field list of the
+ * message schema, the reads of the requested columns only, so a decode with the plan never looks at (or
+ * extracts the text of) a field nobody asked for. The common header (msg_type, repeat_ind,
+ * mmsi) is always decoded. With every column requested the plan falls back to the generated
+ * straight-line decoders.
+ */
+#define AIS_PROJECTION_MAX_OPS 128   // Field reads over all field lists
+#define AIS_FIELD_LISTS 12           // Field lists in the message schema
+
+// One field read of a decode plan
+typedef struct {
+    uint16_t offset;     // Of the field in AISData
+    uint16_t pos;        // First bit in the payload
+    uint16_t min_bits;   // Skipped on shorter payloads (the optional type 21 name extension)
+    uint8_t width;       // Bits
+    uint8_t kind;        // How to read it, see ais_decoder_lib.c
+    uint8_t size;        // Bytes of the AISData field
+    uint8_t flag;        // AIS_FLAG_* set when present
+    int32_t scale;
+    int64_t sentinel;
+} AISFieldOp;
+
+typedef struct {
+    uint64_t columns;                          // AIS_COLUMN_BIT mask the plan was built for
+    int all;                                   // Every column: use the full decoders
+    uint16_t first_op[AIS_FIELD_LISTS + 2];    // List l reads ops[first_op[l]..first_op[l + 1]), l >= 1
+    AISFieldOp ops[AIS_PROJECTION_MAX_OPS];
+    int csv_column_count;
+    uint8_t csv_columns[AIS_COLUMN_COUNT];     // Requested columns that appear in the CSV, in order
+} AISProjection;
+
+// State of one batch decoding stream; give each thread its own
+typedef struct {
+    FragmentTable fragments;
+    uint64_t line_clock;     // Non-empty sentences seen, the reassembly clock
+    int verify_checksums;
+    DearmorKernel kernel;    // Chosen for this CPU by ais_decoder_init
+    const AISProjection *projection;  // Columns to decode, NULL = all (ais_decoder_init's default)
+} AISDecoder;
+
+// Bits and characters
+int convert_ais_char(char c);
+int64_t extract_bits(const AISBitBuffer *bits, int start_pos, int bit_length);
+int64_t extract_signed_bits(const AISBitBuffer *bits, int start_pos, int bit_length);
+void extract_text(const AISBitBuffer *binary_data, int start_pos, int num_chars, char *output);
+int dearmor_payload(const char *payload, int num_chars, AISBitBuffer *bits);
+int convert_payload_to_binary(const char *payload, AISBitBuffer *bits);
+
+// NMEA sentences and reassembly
+int get_payload_from_nmea(const char *sentence, char *payload);
+int parse_nmea_tag_block(const char *line, int len, NMEATagBlock *tags);
+int parse_nmea_sentence(const char *sentence, int len, NMEASentence *out);
+int verify_nmea_checksum(const char *sentence, int len);
+void fragment_table_init(FragmentTable *table, uint64_t timeout);
+void fragment_table_expire(FragmentTable *table, uint64_t now);
+int fragment_table_add(FragmentTable *table, const NMEASentence *s, NMEATagBlock *tags, uint64_t now,
+                       char *payload_out, int *fill_bits_out);
+
+// Decoding
+void init_ais_data(AISData *data);
+void ais_data_set_tags(AISData *data, const NMEATagBlock *tags);
+AISStatus decode_ais_payload_status(const char *payload, int payload_len, AISData *data);
+int decode_ais_payload(const char *payload, int payload_len, AISData *data);
+int decode_ais(const char *nmea_sentence, AISData *data);
+int ais_column_index(const char *name, int len);
+void ais_projection_init(AISProjection *projection, uint64_t columns);
+AISStatus decode_ais_payload_projected(const AISProjection *projection, const char *payload, int payload_len,
+                                       AISData *data);
+int peek_ais_position(const char *payload, int payload_len, int32_t *lon, int32_t *lat);
+void ais_decoder_init(AISDecoder *decoder, int verify_checksums);
+int decode_ais_batch(AISDecoder *decoder, const char *const *sentences, const int *lengths, int count,
+                     AISData *records, int *sources, uint8_t *statuses);
+
+// Encoding
+int encode_ais_payload(const AISData *data, char *payload, int *fill_bits);
+int encode_nmea_sentences(const char *payload, int payload_len, int fill_bits, char channel, int seq_id,
+                          char *out);
+
+// CSV output
+int make_csv_line(const AISData *data, char *output);
+void write_csv_header(FILE *file);
+int make_csv_line_projected(const AISProjection *projection, const AISData *data, char *output);
+void write_csv_header_projected(FILE *file, const AISProjection *projection);
+
+#endif // AIS_DECODER_LIB_H
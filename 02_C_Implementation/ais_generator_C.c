@@ -0,0 +1,808 @@
+/*
+ * AIS Traffic Generator for Final Year Project
+ * Purpose: Synthesize NMEA AIS traffic (class A/B tracks, base stations, AtoNs and their static
+ *          reports) with optional spoofing and corrupted sentences, for load tests and detector checks
+ * Output: !AIVDM sentences, and optionally a ground-truth CSV of every injected anomaly
+ * Build: gcc -O2 ais_generator_C.c -o ais_generator_C -lm -lpthread (add -lws2_32 on Windows)
+ */
+
+// The encoder lives in the decoding library; the refined decoder is compiled in without its main()
+#define AIS_DECODER_NO_MAIN
+#include "ais_decoder_lib.c"
+#include "refined_ais_decoder_C.c"
+
+// Fleet defaults
+#define GEN_DEFAULT_CLASS_A 1000
+#define GEN_DEFAULT_CLASS_B 300
+#define GEN_DEFAULT_BASE_STATIONS 20
+#define GEN_DEFAULT_ATONS 50
+#define GEN_DEFAULT_DURATION 3600         // Simulated seconds
+
+// Reporting intervals (seconds); kept at or under 30 s for moving vessels so the
+// clockless spoof check can still tell the gap between two reports from the UTC second
+#define GEN_CLASS_A_INTERVAL 10
+#define GEN_CLASS_B_INTERVAL 30
+#define GEN_BASE_STATION_INTERVAL 10
+#define GEN_ATON_INTERVAL 180
+#define GEN_STATIC_INTERVAL 360
+
+// Injected anomalies
+#define GEN_TELEPORT_MIN_DEG 0.5          // A teleported report lands this far away...
+#define GEN_TELEPORT_MAX_DEG 3.0          // ...at most
+#define GEN_CIRCLE_RADIUS_DEG 0.02        // Circle spoofing ring (about 2 km)
+#define GEN_CIRCLE_STEP_DEG 40.0          // Angle advanced per report on the ring
+
+#define GEN_FIRST_MMSI 211000000          // Ships are numbered upwards from here
+#define GEN_FIRST_BASE_STATION_MMSI 2110000
+#define GEN_FIRST_ATON_MMSI 992110000
+#define GEN_OUTPUT_BUFFER (1 << 20)       // Bytes collected before each fwrite
+#define GEN_CHECK_REPORTS 5               // Round-trip mismatches printed in full
+
+typedef enum {
+    GEN_CLASS_A,
+    GEN_CLASS_B,
+    GEN_BASE_STATION,
+    GEN_AID_TO_NAVIGATION
+} GenVesselKind;
+
+// How a transmitter's reported positions relate to a real track
+typedef enum {
+    GEN_TRACK_TRUE,    // Reports where it is
+    GEN_TRACK_CLONE,   // Uses another vessel's MMSI and name from somewhere else
+    GEN_TRACK_CIRCLE   // Reports points on a small ring instead of its position
+} GenTrackMode;
+
+// Kinds of injected anomaly, as written to the truth file
+typedef enum {
+    GEN_INJECT_TELEPORT,
+    GEN_INJECT_CLONE,
+    GEN_INJECT_CIRCLE,
+    GEN_INJECT_BAD_CHECKSUM,    // Checksum digits altered
+    GEN_INJECT_FLIPPED_CHAR,    // A payload character changed, old checksum kept
+    GEN_INJECT_INVALID_CHAR,    // Character outside the armour alphabet, checksum fixed up
+    GEN_INJECT_TRUNCATED,       // Sentence cut short
+    GEN_INJECT_LOST_FRAGMENT,   // One sentence of a multi-sentence message left out
+    GEN_INJECT_COUNT
+} GenInjection;
+
+static const char *const GEN_INJECTION_NAMES[GEN_INJECT_COUNT] = {
+    "teleport", "clone", "circle", "bad_checksum", "flipped_char", "invalid_char", "truncated",
+    "lost_fragment"
+};
+
+static const char *const GEN_PORTS[] = {
+    "ROTTERDAM", "HAMBURG", "ANTWERP", "FELIXSTOWE", "BREMERHAVEN", "LE HAVRE", "DOVER",
+    "IJMUIDEN", "ESBJERG", "ABERDEEN", "GOTHENBURG", "DUNKIRK"
+};
+#define GEN_PORT_COUNT ((int)(sizeof(GEN_PORTS) / sizeof(GEN_PORTS[0])))
+
+typedef struct {
+    uint32_t mmsi;
+    uint8_t kind;                 // GenVesselKind
+    uint8_t mode;                 // GenTrackMode
+    uint8_t ship_type;
+    uint8_t nav_status;
+    double lon;                   // Degrees
+    double lat;
+    double sog;                   // Knots
+    double cog;                   // Degrees
+    double turn;                  // Degrees of course change per second
+    double circle_angle;          // GEN_TRACK_CIRCLE: position on the ring
+    uint32_t last_move;           // Simulated second of the last position update
+    uint16_t dim_a;
+    uint16_t dim_b;
+    uint8_t dim_c;
+    uint8_t dim_d;
+    char channel;                 // Alternates A/B per message
+    char name[AIS_NAME_CHARS + 1];
+    char callsign[AIS_CALLSIGN_CHARS + 1];
+    char destination[AIS_DESTINATION_CHARS + 1];
+} GenVessel;
+
+// Message kinds, each on its own fixed schedule
+typedef enum {
+    GEN_MSG_CLASS_A_POSITION,
+    GEN_MSG_CLASS_A_STATIC,
+    GEN_MSG_CLASS_B_POSITION,
+    GEN_MSG_CLASS_B_STATIC,
+    GEN_MSG_BASE_STATION,
+    GEN_MSG_AID_TO_NAVIGATION,
+    GEN_MSG_KIND_COUNT
+} GenMessageKind;
+
+// Transmitters of one message kind grouped by phase: those due at second t are
+// members[offsets[t % interval] .. offsets[t % interval + 1])
+typedef struct {
+    int interval;
+    int *offsets;
+    int *members;
+} GenSchedule;
+
+typedef struct {
+    int class_a;
+    int class_b;
+    int base_stations;
+    int atons;
+    uint32_t duration;
+    uint64_t max_messages;        // 0 = no limit
+    uint64_t seed;
+    double region[4];             // lon0, lat0, lon1, lat1
+    double teleport_rate;         // Per position report
+    int clones;
+    int circles;
+    double corrupt_rate;          // Per message
+    int check;                    // Decode every payload again and compare
+} GenOptions;
+
+typedef struct {
+    const GenOptions *options;
+    GenVessel *vessels;
+    int vessel_count;
+    GenSchedule schedules[GEN_MSG_KIND_COUNT];
+    uint64_t rng;
+    FILE *out;
+    FILE *truth;
+    char *buffer;
+    size_t buffered;
+    int seq_id;
+    uint64_t messages;
+    uint64_t lines;
+    uint64_t bytes;
+    uint64_t injected[GEN_INJECT_COUNT];
+    uint64_t check_failures;
+} Generator;
+
+static uint64_t gen_random(Generator *gen) {
+    gen->rng ^= gen->rng >> 12;
+    gen->rng ^= gen->rng << 25;
+    gen->rng ^= gen->rng >> 27;
+    return gen->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double gen_uniform(Generator *gen, double lo, double hi) {
+    return lo + (hi - lo) * (double)(gen_random(gen) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int gen_below(Generator *gen, int n) {
+    return (int)(gen_random(gen) % (uint64_t)n);
+}
+
+static void gen_random_letters(Generator *gen, char *out, int len) {
+    for (int i = 0; i < len; i++) {
+        out[i] = (char)('A' + gen_below(gen, 26));
+    }
+    out[len] = '\0';
+}
+
+static void gen_init_vessel(Generator *gen, GenVessel *v, GenVesselKind kind, uint32_t mmsi) {
+    const double *region = gen->options->region;
+
+    memset(v, 0, sizeof(*v));
+    v->kind = (uint8_t)kind;
+    v->mmsi = mmsi;
+    v->lon = gen_uniform(gen, region[0], region[2]);
+    v->lat = gen_uniform(gen, region[1], region[3]);
+    v->cog = gen_uniform(gen, 0.0, 360.0);
+    v->channel = gen_below(gen, 2) ? 'B' : 'A';
+    gen_random_letters(gen, v->callsign, 4);
+
+    switch (kind) {
+    case GEN_CLASS_A:
+        // Most ships under way, some at anchor or moored
+        v->nav_status = (uint8_t)(gen_below(gen, 10) == 0 ? 1 + 4 * gen_below(gen, 2) : 0);
+        v->sog = v->nav_status == 0 ? gen_uniform(gen, 6.0, 22.0) : gen_uniform(gen, 0.0, 0.3);
+        v->turn = gen_uniform(gen, -0.05, 0.05);
+        v->ship_type = (uint8_t)(gen_below(gen, 2) ? 70 + gen_below(gen, 10) : 80 + gen_below(gen, 10));
+        v->dim_a = (uint16_t)(50 + gen_below(gen, 250));
+        v->dim_b = (uint16_t)(10 + gen_below(gen, 60));
+        v->dim_c = (uint8_t)(5 + gen_below(gen, 20));
+        v->dim_d = (uint8_t)(5 + gen_below(gen, 20));
+        snprintf(v->name, sizeof(v->name), "GEN VESSEL %u", mmsi % 1000000);
+        strcpy(v->destination, GEN_PORTS[gen_below(gen, GEN_PORT_COUNT)]);
+        break;
+    case GEN_CLASS_B:
+        v->sog = gen_uniform(gen, 0.0, 12.0);
+        v->turn = gen_uniform(gen, -0.2, 0.2);
+        v->ship_type = (uint8_t)(gen_below(gen, 2) ? 36 : 37);  // Sailing, pleasure craft
+        v->dim_a = (uint16_t)(5 + gen_below(gen, 15));
+        v->dim_b = (uint16_t)(2 + gen_below(gen, 5));
+        v->dim_c = (uint8_t)(1 + gen_below(gen, 3));
+        v->dim_d = (uint8_t)(1 + gen_below(gen, 3));
+        snprintf(v->name, sizeof(v->name), "GEN YACHT %u", mmsi % 1000000);
+        break;
+    case GEN_BASE_STATION:
+        snprintf(v->name, sizeof(v->name), "BASE %u", mmsi);
+        break;
+    case GEN_AID_TO_NAVIGATION:
+        v->ship_type = (uint8_t)(1 + gen_below(gen, 31));  // Aid type
+        snprintf(v->name, sizeof(v->name), "GEN BUOY %u", mmsi % 100000);
+        break;
+    }
+}
+
+// Move a vessel along its track up to simulated second now, turning slowly and staying in
+// the region
+static void gen_advance(Generator *gen, GenVessel *v, uint32_t now) {
+    const double *region = gen->options->region;
+    double dt = (double)(now - v->last_move);
+    v->last_move = now;
+    if (dt <= 0.0 || v->sog <= 0.0) {
+        return;
+    }
+
+    double nm = v->sog * dt / 3600.0;
+    double rad = v->cog * M_PI / 180.0;
+    v->lat += nm / 60.0 * cos(rad);
+    v->lon += nm / 60.0 * sin(rad) / cos(v->lat * M_PI / 180.0);
+    v->cog += v->turn * dt;
+    if (v->lon < region[0] || v->lon > region[2]) {
+        v->cog = 360.0 - v->cog;
+        v->lon = v->lon < region[0] ? region[0] : region[2];
+    }
+    if (v->lat < region[1] || v->lat > region[3]) {
+        v->cog = 180.0 - v->cog;
+        v->lat = v->lat < region[1] ? region[1] : region[3];
+    }
+    v->cog = fmod(v->cog + 360.0, 360.0);
+}
+
+// Degrees to AISData units (1/10000 minute)
+static int32_t gen_degrees_to_ais(double degrees) {
+    return (int32_t)lrint(degrees * 600000.0);
+}
+
+static void gen_flush(Generator *gen) {
+    if (gen->buffered > 0) {
+        fwrite(gen->buffer, 1, gen->buffered, gen->out);
+        gen->bytes += gen->buffered;
+        gen->buffered = 0;
+    }
+}
+
+static void gen_record_injection(Generator *gen, GenInjection kind, const AISData *data) {
+    gen->injected[kind]++;
+    if (gen->truth != NULL) {
+        fprintf(gen->truth, "%llu,%llu,%u,%u,%s\n", (unsigned long long)gen->messages,
+                (unsigned long long)gen->lines + 1, data->mmsi, data->msg_type, GEN_INJECTION_NAMES[kind]);
+    }
+}
+
+// Damage the sentences of one message in place; returns the new length
+static int gen_corrupt(Generator *gen, char *text, int len, const AISData *data) {
+    int sentences = 0;
+    for (int i = 0; i < len; i++) {
+        sentences += text[i] == '\n';
+    }
+    int kind = GEN_INJECT_BAD_CHECKSUM + gen_below(gen, sentences > 1 ? 5 : 4);
+
+    // Work on the last sentence: its payload sits between the 5th and 6th comma
+    char *line = text;
+    for (char *p = text; p < text + len - 1; p++) {
+        if (*p == '\n') {
+            line = p + 1;
+        }
+    }
+    int line_len = (int)(text + len - line) - 1;
+    char *payload = line;
+    for (int commas = 0; commas < 5; payload++) {
+        commas += *payload == ',';
+    }
+    char *payload_end = memchr(payload, ',', (size_t)(line + line_len - payload));
+    int payload_len = payload_end != NULL ? (int)(payload_end - payload) : 0;
+    if (payload_len == 0) {
+        kind = GEN_INJECT_BAD_CHECKSUM;
+    }
+
+    switch (kind) {
+    case GEN_INJECT_BAD_CHECKSUM:
+        line[line_len - 1] = line[line_len - 1] == '0' ? '1' : '0';
+        break;
+    case GEN_INJECT_FLIPPED_CHAR: {
+        char *c = payload + gen_below(gen, payload_len);
+        *c = AIS_ARMOUR_CHARS[(convert_ais_char(*c) + 1 + gen_below(gen, 63)) & 63];
+        break;
+    }
+    case GEN_INJECT_INVALID_CHAR: {
+        payload[gen_below(gen, payload_len)] = 'x';
+        uint8_t sum = nmea_xor(line + 1, line_len - 4);
+        line[line_len - 2] = "0123456789ABCDEF"[sum >> 4];
+        line[line_len - 1] = "0123456789ABCDEF"[sum & 15];
+        break;
+    }
+    case GEN_INJECT_TRUNCATED: {
+        int keep = 7 + gen_below(gen, line_len - 7);
+        line[keep] = '\n';
+        len = (int)(line - text) + keep + 1;
+        break;
+    }
+    case GEN_INJECT_LOST_FRAGMENT: {
+        // Drop the first sentence, so the rest arrive without a start
+        char *second = memchr(text, '\n', (size_t)len) + 1;
+        len -= (int)(second - text);
+        memmove(text, second, (size_t)len);
+        break;
+    }
+    }
+    gen_record_injection(gen, (GenInjection)kind, data);
+    return len;
+}
+
+// Compare a record with what the decoder makes of its payload
+static void gen_check(Generator *gen, const AISData *data, const char *payload, int payload_len) {
+    AISData decoded;
+    char expected[MAX_LINE_LENGTH * 3];
+    char actual[MAX_LINE_LENGTH * 3];
+
+    make_csv_line(data, expected);
+    if (!decode_ais_payload(payload, payload_len, &decoded)) {
+        strcpy(actual, "(not decoded)");
+    } else {
+        make_csv_line(&decoded, actual);
+    }
+    if (strcmp(expected, actual) != 0) {
+        if (gen->check_failures < GEN_CHECK_REPORTS) {
+            fprintf(stderr, "Round-trip mismatch for %s\n  sent:    %s\n  decoded: %s\n", payload, expected, actual);
+        }
+        gen->check_failures++;
+    }
+}
+
+// Encode one record and queue its sentences, corrupting them at the configured rate
+static void gen_emit(Generator *gen, GenVessel *v, const AISData *data) {
+    char payload[MAX_PAYLOAD_LENGTH];
+    char text[AIS_MAX_SENTENCE_BYTES * MAX_FRAGMENTS];
+    int fill_bits;
+
+    int payload_len = encode_ais_payload(data, payload, &fill_bits);
+    if (payload_len == 0) {
+        return;
+    }
+    if (gen->options->check) {
+        gen_check(gen, data, payload, payload_len);
+    }
+    int len = encode_nmea_sentences(payload, payload_len, fill_bits, v->channel, gen->seq_id, text);
+    if (len > AIS_MAX_SENTENCE_BYTES) {
+        gen->seq_id = (gen->seq_id + 1) % 10;
+    }
+    v->channel = v->channel == 'A' ? 'B' : 'A';
+
+    gen->messages++;
+    if (gen->options->corrupt_rate > 0.0 && gen_uniform(gen, 0.0, 1.0) < gen->options->corrupt_rate) {
+        len = gen_corrupt(gen, text, len, data);
+    }
+    if (gen->buffered + (size_t)len > GEN_OUTPUT_BUFFER) {
+        gen_flush(gen);
+    }
+    memcpy(gen->buffer + gen->buffered, text, (size_t)len);
+    gen->buffered += (size_t)len;
+    for (int i = 0; i < len; i++) {
+        gen->lines += text[i] == '\n';
+    }
+}
+
+// Position report of a moving vessel, with any spoofing applied to what it reports
+static void gen_position_report(Generator *gen, GenVessel *v, uint32_t now) {
+    AISData data;
+    init_ais_data(&data);
+    gen_advance(gen, v, now);
+
+    double lon = v->lon;
+    double lat = v->lat;
+    double sog = v->sog;
+    double cog = v->cog;
+    int injection = -1;
+    if (v->mode == GEN_TRACK_CIRCLE) {
+        // The ring is centred on the true position; course follows the ring's tangent
+        v->circle_angle = fmod(v->circle_angle + GEN_CIRCLE_STEP_DEG, 360.0);
+        double rad = v->circle_angle * M_PI / 180.0;
+        lat += GEN_CIRCLE_RADIUS_DEG * cos(rad);
+        lon += GEN_CIRCLE_RADIUS_DEG * sin(rad) / cos(v->lat * M_PI / 180.0);
+        cog = fmod(v->circle_angle + 90.0, 360.0);
+        injection = GEN_INJECT_CIRCLE;
+    } else if (v->mode == GEN_TRACK_CLONE) {
+        injection = GEN_INJECT_CLONE;
+    } else if (gen->options->teleport_rate > 0.0 && gen_uniform(gen, 0.0, 1.0) < gen->options->teleport_rate) {
+        double jump = gen_uniform(gen, GEN_TELEPORT_MIN_DEG, GEN_TELEPORT_MAX_DEG);
+        double rad = gen_uniform(gen, 0.0, 2.0 * M_PI);
+        lat += jump * cos(rad);
+        lon += jump * sin(rad);
+        if (lat > 89.0 || lat < -89.0) {
+            lat = v->lat - jump * cos(rad);
+        }
+        injection = GEN_INJECT_TELEPORT;
+    }
+
+    data.msg_type = v->kind == GEN_CLASS_A ? 1 : 18;
+    data.mmsi = v->mmsi;
+    data.sog = (uint16_t)lrint(sog * 10.0);
+    data.cog = (uint16_t)(lrint(cog * 10.0) % 3600);
+    data.heading = (uint16_t)(lrint(v->cog) % 360);
+    data.lon = gen_degrees_to_ais(lon);
+    data.lat = gen_degrees_to_ais(lat);
+    data.utc_sec = (uint8_t)(now % 60);
+    data.pos_accuracy = 1;
+    data.flags = AIS_FLAG_LON | AIS_FLAG_LAT;
+    if (v->kind == GEN_CLASS_A) {
+        data.nav_status = (int8_t)v->nav_status;
+        data.rot = 0;
+        data.flags |= AIS_FLAG_ROT;
+        data.slot = (uint8_t)(now % 8);
+    } else {
+        data.heading = AIS_HEADING_NOT_AVAILABLE;  // Most class B units have no compass
+    }
+
+    if (injection >= 0) {
+        gen_record_injection(gen, (GenInjection)injection, &data);
+    }
+    gen_emit(gen, v, &data);
+}
+
+static void gen_static_report(Generator *gen, GenVessel *v) {
+    AISData data;
+    init_ais_data(&data);
+    data.mmsi = v->mmsi;
+    data.ship_type = v->ship_type;
+    data.dim_a = v->dim_a;
+    data.dim_b = v->dim_b;
+    data.dim_c = v->dim_c;
+    data.dim_d = v->dim_d;
+    strcpy(data.callsign, v->callsign);
+
+    if (v->kind == GEN_CLASS_A) {
+        data.msg_type = 5;
+        data.imo = 9000000 + v->mmsi % 1000000;
+        strcpy(data.ship_name, v->name);
+        strcpy(data.destination, v->destination);
+        data.draught = (uint8_t)(40 + v->dim_a / 4);
+        data.pos_accuracy = 1;  // EPFD: GPS
+        gen_emit(gen, v, &data);
+        return;
+    }
+
+    // Class B static data goes out as part A (name) then part B (type, callsign, size)
+    data.msg_type = 24;
+    AISData part_a = data;
+    init_ais_data(&part_a);
+    part_a.msg_type = 24;
+    part_a.mmsi = v->mmsi;
+    strcpy(part_a.ship_name, v->name);
+    gen_emit(gen, v, &part_a);
+    gen_emit(gen, v, &data);
+}
+
+static void gen_base_station_report(Generator *gen, GenVessel *v) {
+    AISData data;
+    init_ais_data(&data);
+    data.msg_type = 4;
+    data.mmsi = v->mmsi;
+    data.pos_accuracy = 1;
+    data.lon = gen_degrees_to_ais(v->lon);
+    data.lat = gen_degrees_to_ais(v->lat);
+    data.flags = AIS_FLAG_LON | AIS_FLAG_LAT;
+    gen_emit(gen, v, &data);
+}
+
+static void gen_aid_report(Generator *gen, GenVessel *v, uint32_t now) {
+    AISData data;
+    init_ais_data(&data);
+    data.msg_type = 21;
+    data.mmsi = v->mmsi;
+    data.aid_type = v->ship_type;
+    strcpy(data.ship_name, v->name);
+    data.lon = gen_degrees_to_ais(v->lon);
+    data.lat = gen_degrees_to_ais(v->lat);
+    data.flags = AIS_FLAG_LON | AIS_FLAG_LAT;
+    data.dim_a = 1;
+    data.dim_b = 1;
+    data.dim_c = 1;
+    data.dim_d = 1;
+    data.utc_sec = (uint8_t)(now % 60);
+    gen_emit(gen, v, &data);
+}
+
+// Group transmitters of one kind by a random phase within the interval
+static int gen_build_schedule(Generator *gen, GenSchedule *schedule, int interval, const int *members, int count) {
+    int *phase = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    schedule->interval = interval;
+    schedule->offsets = calloc((size_t)interval + 1, sizeof(int));
+    schedule->members = malloc((size_t)(count > 0 ? count : 1) * sizeof(int));
+    if (phase == NULL || schedule->offsets == NULL || schedule->members == NULL) {
+        free(phase);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        phase[i] = gen_below(gen, interval);
+        schedule->offsets[phase[i] + 1]++;
+    }
+    for (int p = 0; p < interval; p++) {
+        schedule->offsets[p + 1] += schedule->offsets[p];
+    }
+    int *fill = malloc((size_t)interval * sizeof(int));
+    if (fill == NULL) {
+        free(phase);
+        return 0;
+    }
+    memcpy(fill, schedule->offsets, (size_t)interval * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        schedule->members[fill[phase[i]]++] = members[i];
+    }
+    free(fill);
+    free(phase);
+    return 1;
+}
+
+static void gen_free(Generator *gen) {
+    for (int k = 0; k < GEN_MSG_KIND_COUNT; k++) {
+        free(gen->schedules[k].offsets);
+        free(gen->schedules[k].members);
+    }
+    free(gen->vessels);
+    free(gen->buffer);
+}
+
+// Create the fleet (clones and circle spoofers are extra transmitters) and its schedules
+static int gen_setup(Generator *gen, const GenOptions *options) {
+    memset(gen, 0, sizeof(*gen));
+    gen->options = options;
+    gen->rng = options->seed ? options->seed : 1;
+
+    int clones = options->class_a > 0 ? options->clones : 0;
+    int total = options->class_a + options->class_b + options->base_stations + options->atons + clones +
+                options->circles;
+    gen->vessels = calloc((size_t)(total > 0 ? total : 1), sizeof(GenVessel));
+    gen->buffer = malloc(GEN_OUTPUT_BUFFER);
+    int *lists[GEN_MSG_KIND_COUNT];
+    int counts[GEN_MSG_KIND_COUNT];
+    memset(counts, 0, sizeof(counts));
+    for (int k = 0; k < GEN_MSG_KIND_COUNT; k++) {
+        lists[k] = malloc((size_t)(total > 0 ? total : 1) * sizeof(int));
+    }
+    int ok = gen->vessels != NULL && gen->buffer != NULL;
+    for (int k = 0; k < GEN_MSG_KIND_COUNT; k++) {
+        ok = ok && lists[k] != NULL;
+    }
+
+    for (int i = 0; ok && i < total; i++) {
+        GenVessel *v = &gen->vessels[i];
+        int n = i;
+        if (n < options->class_a) {
+            gen_init_vessel(gen, v, GEN_CLASS_A, GEN_FIRST_MMSI + (uint32_t)n);
+        } else if ((n -= options->class_a) < options->class_b) {
+            gen_init_vessel(gen, v, GEN_CLASS_B, GEN_FIRST_MMSI + (uint32_t)(options->class_a + n));
+        } else if ((n -= options->class_b) < options->base_stations) {
+            gen_init_vessel(gen, v, GEN_BASE_STATION, GEN_FIRST_BASE_STATION_MMSI + (uint32_t)n);
+        } else if ((n -= options->base_stations) < options->atons) {
+            gen_init_vessel(gen, v, GEN_AID_TO_NAVIGATION, GEN_FIRST_ATON_MMSI + (uint32_t)n);
+        } else if ((n -= options->atons) < clones) {
+            // Same identity as a real class A ship, transmitting from elsewhere
+            const GenVessel *victim = &gen->vessels[gen_below(gen, options->class_a)];
+            gen_init_vessel(gen, v, GEN_CLASS_A, victim->mmsi);
+            strcpy(v->name, victim->name);
+            strcpy(v->callsign, victim->callsign);
+            v->ship_type = victim->ship_type;
+            v->mode = GEN_TRACK_CLONE;
+        } else {
+            gen_init_vessel(gen, v, GEN_CLASS_A, GEN_FIRST_MMSI + (uint32_t)(options->class_a + options->class_b + n));
+            v->sog = gen_uniform(gen, 4.0, 12.0);
+            v->mode = GEN_TRACK_CIRCLE;
+        }
+
+        switch (v->kind) {
+        case GEN_CLASS_A:
+            lists[GEN_MSG_CLASS_A_POSITION][counts[GEN_MSG_CLASS_A_POSITION]++] = i;
+            lists[GEN_MSG_CLASS_A_STATIC][counts[GEN_MSG_CLASS_A_STATIC]++] = i;
+            break;
+        case GEN_CLASS_B:
+            lists[GEN_MSG_CLASS_B_POSITION][counts[GEN_MSG_CLASS_B_POSITION]++] = i;
+            lists[GEN_MSG_CLASS_B_STATIC][counts[GEN_MSG_CLASS_B_STATIC]++] = i;
+            break;
+        case GEN_BASE_STATION:
+            lists[GEN_MSG_BASE_STATION][counts[GEN_MSG_BASE_STATION]++] = i;
+            break;
+        default:
+            lists[GEN_MSG_AID_TO_NAVIGATION][counts[GEN_MSG_AID_TO_NAVIGATION]++] = i;
+            break;
+        }
+    }
+    gen->vessel_count = total;
+
+    static const int intervals[GEN_MSG_KIND_COUNT] = {
+        GEN_CLASS_A_INTERVAL, GEN_STATIC_INTERVAL, GEN_CLASS_B_INTERVAL, GEN_STATIC_INTERVAL,
+        GEN_BASE_STATION_INTERVAL, GEN_ATON_INTERVAL
+    };
+    for (int k = 0; ok && k < GEN_MSG_KIND_COUNT; k++) {
+        ok = gen_build_schedule(gen, &gen->schedules[k], intervals[k], lists[k], counts[k]);
+    }
+    for (int k = 0; k < GEN_MSG_KIND_COUNT; k++) {
+        free(lists[k]);
+    }
+    return ok;
+}
+
+// Run the simulation second by second until the duration or message limit is reached
+static void gen_run(Generator *gen) {
+    const GenOptions *options = gen->options;
+    for (uint32_t now = 0; now < options->duration; now++) {
+        for (int k = 0; k < GEN_MSG_KIND_COUNT; k++) {
+            const GenSchedule *schedule = &gen->schedules[k];
+            int phase = (int)(now % (uint32_t)schedule->interval);
+            for (int m = schedule->offsets[phase]; m < schedule->offsets[phase + 1]; m++) {
+                GenVessel *v = &gen->vessels[schedule->members[m]];
+                switch ((GenMessageKind)k) {
+                case GEN_MSG_CLASS_A_POSITION:
+                case GEN_MSG_CLASS_B_POSITION:
+                    gen_position_report(gen, v, now);
+                    break;
+                case GEN_MSG_CLASS_A_STATIC:
+                case GEN_MSG_CLASS_B_STATIC:
+                    gen_static_report(gen, v);
+                    break;
+                case GEN_MSG_BASE_STATION:
+                    gen_base_station_report(gen, v);
+                    break;
+                default:
+                    gen_aid_report(gen, v, now);
+                    break;
+                }
+                if (options->max_messages != 0 && gen->messages >= options->max_messages) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void print_generator_usage(const char *program) {
+    printf("Usage: %s [options] [output_file]\n\n", program);
+    printf("Writes synthetic !AIVDM traffic to output_file (stdout if omitted or \"-\").\n");
+    printf("Class A ships report every %d s with static data every %d s, class B every %d s,\n",
+           GEN_CLASS_A_INTERVAL, GEN_STATIC_INTERVAL, GEN_CLASS_B_INTERVAL);
+    printf("base stations every %d s and AtoNs every %d s, alternating channels A and B.\n\n",
+           GEN_BASE_STATION_INTERVAL, GEN_ATON_INTERVAL);
+    printf("Options:\n");
+    printf("  --class-a=N        Class A ships (default %d)\n", GEN_DEFAULT_CLASS_A);
+    printf("  --class-b=N        Class B vessels (default %d)\n", GEN_DEFAULT_CLASS_B);
+    printf("  --base-stations=N  Base stations (default %d)\n", GEN_DEFAULT_BASE_STATIONS);
+    printf("  --atons=N          Aids to navigation (default %d)\n", GEN_DEFAULT_ATONS);
+    printf("  --duration=S       Simulated seconds (default %d)\n", GEN_DEFAULT_DURATION);
+    printf("  --messages=N       Stop after N messages\n");
+    printf("  --seed=N           Random seed (same seed, same traffic)\n");
+    printf("  --region=LON0,LAT0,LON1,LAT1  Area the fleet sails in (default 0,51,9,58)\n");
+    printf("  --teleport=P       Chance per position report of a jump of %.1f-%.1f degrees\n",
+           GEN_TELEPORT_MIN_DEG, GEN_TELEPORT_MAX_DEG);
+    printf("  --clones=N         Extra transmitters reusing real class A MMSIs elsewhere\n");
+    printf("  --circles=N        Extra ships reporting points on a ring around themselves\n");
+    printf("  --corrupt=P        Chance per message of damaged sentences (bad checksum, changed\n");
+    printf("                     or invalid character, truncation, lost fragment)\n");
+    printf("  --truth=FILE       Write every injected anomaly as message,line,mmsi,msg_type,injection\n");
+    printf("  --check            Decode every payload again and report round-trip mismatches\n");
+}
+
+int main(int argc, char *argv[]) {
+    GenOptions options;
+    const char *output_filename = NULL;
+    const char *truth_filename = NULL;
+    Generator gen;
+
+    memset(&options, 0, sizeof(options));
+    options.class_a = GEN_DEFAULT_CLASS_A;
+    options.class_b = GEN_DEFAULT_CLASS_B;
+    options.base_stations = GEN_DEFAULT_BASE_STATIONS;
+    options.atons = GEN_DEFAULT_ATONS;
+    options.duration = GEN_DEFAULT_DURATION;
+    options.seed = 1;
+    options.region[0] = 0.0;
+    options.region[1] = 51.0;
+    options.region[2] = 9.0;
+    options.region[3] = 58.0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--class-a=", 10) == 0) {
+            options.class_a = atoi(arg + 10);
+        } else if (strncmp(arg, "--class-b=", 10) == 0) {
+            options.class_b = atoi(arg + 10);
+        } else if (strncmp(arg, "--base-stations=", 16) == 0) {
+            options.base_stations = atoi(arg + 16);
+        } else if (strncmp(arg, "--atons=", 8) == 0) {
+            options.atons = atoi(arg + 8);
+        } else if (strncmp(arg, "--duration=", 11) == 0) {
+            options.duration = (uint32_t)strtoul(arg + 11, NULL, 10);
+        } else if (strncmp(arg, "--messages=", 11) == 0) {
+            options.max_messages = strtoull(arg + 11, NULL, 10);
+            if (options.duration == GEN_DEFAULT_DURATION) {
+                options.duration = UINT32_MAX;  // The message count decides when to stop
+            }
+        } else if (strncmp(arg, "--seed=", 7) == 0) {
+            options.seed = strtoull(arg + 7, NULL, 10);
+        } else if (strncmp(arg, "--region=", 9) == 0) {
+            if (sscanf(arg + 9, "%lf,%lf,%lf,%lf", &options.region[0], &options.region[1], &options.region[2],
+                       &options.region[3]) != 4 ||
+                options.region[0] >= options.region[2] || options.region[1] >= options.region[3] ||
+                options.region[1] < -85.0 || options.region[3] > 85.0) {
+                printf("Invalid region: %s\n", arg + 9);
+                return 1;
+            }
+        } else if (strncmp(arg, "--teleport=", 11) == 0) {
+            options.teleport_rate = atof(arg + 11);
+        } else if (strncmp(arg, "--clones=", 9) == 0) {
+            options.clones = atoi(arg + 9);
+        } else if (strncmp(arg, "--circles=", 10) == 0) {
+            options.circles = atoi(arg + 10);
+        } else if (strncmp(arg, "--corrupt=", 10) == 0) {
+            options.corrupt_rate = atof(arg + 10);
+        } else if (strncmp(arg, "--truth=", 8) == 0) {
+            truth_filename = arg + 8;
+        } else if (strcmp(arg, "--check") == 0) {
+            options.check = 1;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_generator_usage(argv[0]);
+            return 0;
+        } else if (arg[0] != '-' || strcmp(arg, "-") == 0) {
+            output_filename = arg;
+        } else {
+            printf("Unknown argument: %s\n\n", arg);
+            print_generator_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.class_a < 0 || options.class_b < 0 || options.base_stations < 0 || options.atons < 0 ||
+        options.clones < 0 || options.circles < 0) {
+        print_generator_usage(argv[0]);
+        return 1;
+    }
+
+    if (!gen_setup(&gen, &options)) {
+        fprintf(stderr, "Error: Could not allocate the fleet\n");
+        gen_free(&gen);
+        return 1;
+    }
+    int to_stdout = output_filename == NULL || strcmp(output_filename, "-") == 0;
+    gen.out = to_stdout ? stdout : fopen(output_filename, "wb");
+    if (gen.out == NULL) {
+        fprintf(stderr, "Error: Could not open output file %s\n", output_filename);
+        gen_free(&gen);
+        return 1;
+    }
+    if (truth_filename != NULL) {
+        gen.truth = fopen(truth_filename, "w");
+        if (gen.truth == NULL) {
+            fprintf(stderr, "Error: Could not open truth file %s\n", truth_filename);
+            if (!to_stdout) {
+                fclose(gen.out);
+            }
+            gen_free(&gen);
+            return 1;
+        }
+        fprintf(gen.truth, "message,line,mmsi,msg_type,injection\n");
+    }
+
+    uint64_t start_ms = wall_clock_ms();
+    gen_run(&gen);
+    gen_flush(&gen);
+    uint64_t elapsed_ms = wall_clock_ms() - start_ms;
+
+    if (!to_stdout) {
+        fclose(gen.out);
+    }
+    if (gen.truth != NULL) {
+        fclose(gen.truth);
+    }
+
+    // The summary goes to stderr so the traffic can be piped straight into the decoder
+    fprintf(stderr, "Transmitters: %d\n", gen.vessel_count);
+    fprintf(stderr, "Messages: %llu in %llu sentences (%.1f MB)\n", (unsigned long long)gen.messages,
+            (unsigned long long)gen.lines, gen.bytes / (1024.0 * 1024.0));
+    fprintf(stderr, "Elapsed: %llu ms (%.2f million messages/s)\n", (unsigned long long)elapsed_ms,
+            elapsed_ms > 0 ? gen.messages / (elapsed_ms * 1000.0) : 0.0);
+    for (int i = 0; i < GEN_INJECT_COUNT; i++) {
+        if (gen.injected[i] > 0) {
+            fprintf(stderr, "  Injected %s: %llu\n", GEN_INJECTION_NAMES[i], (unsigned long long)gen.injected[i]);
+        }
+    }
+    if (options.check) {
+        fprintf(stderr, "Round-trip mismatches: %llu\n", (unsigned long long)gen.check_failures);
+    }
+    gen_free(&gen);
+    return options.check && gen.check_failures > 0 ? 2 : 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * AIS Spoofing Check Test for Final Year Project
+ * Purpose: Feed hand-made position reports through the vessel table and spoofing detector
+ *          and check which of them raise an alert
+ * Output: One line per case on the console; exit status 1 if any case fails
+ * Build: gcc -O2 ais_spoof_test_C.c -o ais_spoof_test_C -lm -lpthread (add -lws2_32 on Windows)
+ */
+
+// The decoding library and the refined decoder are compiled into this program as they are,
+// the decoder without its main()
+#define AIS_DECODER_NO_MAIN
+#include "ais_decoder_lib.c"
+#include "refined_ais_decoder_C.c"
+
+#define TEST_MMSI 244123456
+#define TEST_LAT 31200000  // 52 degrees north, in 1/10000 minute
+#define TEST_LON 2400000   // 4 degrees east
+
+// A type 1 report heading north at sog (1/10 knot), without a receive clock
+static VesselReport make_report(uint8_t utc_sec, int32_t lat, uint16_t sog) {
+    VesselReport report;
+    memset(&report, 0, sizeof(report));
+    report.mmsi = TEST_MMSI;
+    report.msg_type = 1;
+    report.lon = TEST_LON;
+    report.lat = lat;
+    report.sog = sog;
+    report.cog = 0;
+    report.heading = 0;
+    report.utc_sec = utc_sec;
+    report.flags = AIS_FLAG_LON | AIS_FLAG_LAT;
+    return report;
+}
+
+// Apply two reports of one vessel; returns the alerts the second one raised
+static uint64_t alerts_for_pair(const VesselReport *first, const VesselReport *second) {
+    VesselTable vessels;
+    SpoofDetector detector;
+
+    memset(&detector, 0, sizeof(detector));
+    if (!vessel_table_init(&vessels, 1024)) {
+        printf("Error: Could not allocate the vessel table\n");
+        exit(1);
+    }
+    vessel_table_update(&vessels, first, &detector);
+    vessel_table_update(&vessels, second, &detector);
+    vessel_table_free(&vessels);
+    return detector.alerts;
+}
+
+static int check(const char *name, uint64_t alerts, uint64_t expected) {
+    int ok = alerts == expected;
+    printf("%s: %s (alerts %llu, expected %llu)\n", ok ? "PASS" : "FAIL", name,
+           (unsigned long long)alerts, (unsigned long long)expected);
+    return ok;
+}
+
+int main(void) {
+    int ok = 1;
+
+    // 12 knots for one minute is about 370 m; the UTC second fields are equal
+    int32_t one_minute_north = (int32_t)(370.0 / 1852.0 * 10000.0);
+    VesselReport first = make_report(17, TEST_LAT, 120);
+    VesselReport second = make_report(17, TEST_LAT + one_minute_north, 120);
+    ok &= check("60 s apart, same utc_sec, normal travel", alerts_for_pair(&first, &second), 0);
+
+    // Two minutes of travel still fits when the seconds fields agree
+    second = make_report(17, TEST_LAT + 2 * one_minute_north, 120);
+    ok &= check("120 s apart, same utc_sec, normal travel", alerts_for_pair(&first, &second), 0);
+
+    // 30 km in what can only be a minute or two is a jump
+    second = make_report(17, TEST_LAT + (int32_t)(30000.0 / 1852.0 * 10000.0), 120);
+    ok &= check("same utc_sec, 30 km jump", alerts_for_pair(&first, &second), 1);
+
+    // 20 s of travel 20 s apart
+    second = make_report(37, TEST_LAT + one_minute_north / 3, 120);
+    ok &= check("20 s apart, normal travel", alerts_for_pair(&first, &second), 0);
+
+    return ok ? 0 : 1;
+}
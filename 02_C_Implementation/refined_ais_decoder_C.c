@@ -1,7 +1,9 @@
 /*
  * AIS Message Decoder for Final Year Project
  * Purpose: Decode different types of AIS messages from NMEA format
- * Output: CSV format with all the navigation fields
+ * Output: CSV format with all the navigation fields, or a columnar binary archive
+ * Build: gcc -O2 refined_ais_decoder_C.c ais_decoder_lib.c -o refined_ais_decoder -lm -lpthread
+ *        (add -lws2_32 on Windows)
  * Reference: https://gpsd.gitlab.io/gpsd/AIVDM.html#_json_ais_encoding
  */
 
@@ -9,797 +11,4933 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <pthread.h>
 
-#define MAX_LINE_LENGTH 1024
-#define MAX_PAYLOAD_LENGTH 256
-#define MAX_BINARY_LENGTH 1536
-#define MAX_TEXT_LENGTH 128
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AIS_HAVE_X86_SIMD 1
+#endif
 
-// Structure to hold decoded AIS data
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <io.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "ais_decoder_lib.h"
+
+
+// Duplicate suppression (--dedup)
+#define DEDUP_SET_SLOTS 32768        // Per generation, power of two; two generations are kept
+#define DEDUP_SET_MAX_LOAD 24576     // A generation this full is rotated out early
+#define DEDUP_WINDOW_LINES 1000      // Default window for file input (no receive clock)
+#define DEDUP_WINDOW_SECONDS 10      // Default window when streaming
+
+// Decode memo cache (--memo)
+#define MEMO_CACHE_SETS 1024         // Power of two
+#define MEMO_CACHE_WAYS 4            // Entries per set, least recently used is replaced
+// Types whose payloads are retransmitted byte for byte: static and voyage data (5),
+// addressed/broadcast binary (6, 8), data link management (20), aid to navigation (21) and
+// static data report (24). Position and base station reports (1-4) carry a fresh time stamp
+// and almost never repeat, so they would only evict useful entries
+#define MEMO_CACHE_TYPES ((1u << 5) | (1u << 6) | (1u << 8) | (1u << 20) | (1u << 21) | (1u << 24))
+
+// Parallel batch decoding
+#define BATCH_CHUNK_BYTES (4 * 1024 * 1024)  // Input bytes per work item
+#define BATCH_CHUNKS_PER_THREAD 4            // Decoded chunks allowed to wait for the writer
+#define MAX_THREADS 256
+
+// Streaming ingest
+#define STREAM_RING_SLOTS 8192       // Lines buffered between the reader and the decoder
+#define STREAM_READ_SIZE 65536       // Bytes per read()/recv() call
+#define STREAM_POLL_MS 500           // Socket receive timeout, so Ctrl+C is noticed
+#define FOLLOW_POLL_MS 50            // Size check interval for followed files where inotify is missing
+#define FOLLOW_CHECKPOINT_MS 1000    // Most time between follow-mode checkpoints
+#define FOLLOW_CHECKPOINT_MAGIC "AISCKP1"
+#define FOLLOW_CHECKPOINT_VERSION 1
+
+// Instrumentation (--metrics)
+#define METRICS_SAMPLE_LINES 16          // One line in this many is timed stage by stage
+#define METRICS_HISTOGRAM_SUB_BITS 2     // Log-linear buckets, 4 per power of two (HDR-style)
+#define METRICS_HISTOGRAM_BUCKETS (64 << METRICS_HISTOGRAM_SUB_BITS)
+#define METRICS_EXPORT_SECONDS 10        // Default interval between snapshots
+#define METRICS_CHECK_LINES 65536        // Lines between snapshot-due checks, power of two
+
+// Columnar output
+#define COLUMNAR_MAGIC "AISCOL1"     // 8 bytes with the terminator, at both ends of the file
+#define COLUMNAR_VERSION 1
+#define COLUMNAR_ALIGN 64            // Every array starts on a 64-byte boundary
+#define COLUMNAR_GROUP_ROWS 65536    // Rows buffered per row group
+#define COLUMNAR_TYPES 28            // Type index entries (message types 0-27)
+
+// MMSI index shared by the per-vessel tables
+#define MMSI_INDEX_INITIAL_ROWS 1024      // Rows allocated on the first add; doubles when full
+
+// Per-vessel state
+#define VESSEL_TABLE_INITIAL_SLOTS 65536  // Power of two; doubles when 3/4 full
+#define VESSEL_STATE_BYTES 64             // One cache line per vessel
+#define VESSEL_SUMMARY_TOP 10             // Busiest MMSIs listed with their channel split
+// Fields vessel_report_from_ais reads besides the header, decoded whatever --columns says
+#define VESSEL_COLUMNS (AIS_COLUMN_BIT(lon) | AIS_COLUMN_BIT(lat) | AIS_COLUMN_BIT(sog) | \
+                        AIS_COLUMN_BIT(cog) | AIS_COLUMN_BIT(heading) | AIS_COLUMN_BIT(utc_sec))
+
+// Static data cache (--enrich)
+#define STATIC_CACHE_INITIAL_SLOTS 16384  // Power of two; doubles when 3/4 full
+// Fields the cache keeps, decoded whatever --columns says
+#define STATIC_COLUMNS (AIS_COLUMN_BIT(ship_name) | AIS_COLUMN_BIT(callsign) | AIS_COLUMN_BIT(destination) | \
+                        AIS_COLUMN_BIT(ship_type) | AIS_COLUMN_BIT(imo) | AIS_COLUMN_BIT(draught) | \
+                        AIS_COLUMN_BIT(dim_a) | AIS_COLUMN_BIT(dim_b) | AIS_COLUMN_BIT(dim_c) | AIS_COLUMN_BIT(dim_d))
+#define RECORD_CACHE_ONLY 0x80  // AISData.flags: buffered only to feed the cache, not written
+
+// Track store (--tracks)
+#define TRACK_STORE_INITIAL_SLOTS 16384  // Power of two; doubles when 3/4 full
+#define TRACK_BLOCK_BYTES 512            // Header and deltas of one piece of a track
+#define TRACK_POOL_BLOCKS 2048           // Blocks per allocation (1 MB)
+#define TRACK_POINT_MAX_BYTES 26         // Longest encoded point: varints of 10 + 5 + 5 + 3 + 3 bytes
+
+// Track simplification (--simplify)
+#define SIMPLIFY_INITIAL_SLOTS 16384     // Power of two; doubles when 3/4 full
+#define SIMPLIFY_WINDOW_POINTS 64        // Points held back per vessel; a full window is written
+
+// Spoofing detector thresholds
+#define SPOOF_SPEED_FACTOR 2.0             // Allowed multiple of the reported SOG...
+#define SPOOF_SPEED_MARGIN_KNOTS 5.0       // ...plus this, so slow vessels tolerate GPS jitter
+#define SPOOF_DISTANCE_SLACK_M 300.0       // Position noise allowed on top of the speed bound
+#define SPOOF_UNKNOWN_SOG_KNOTS 50.0       // Speed assumed when SOG is not available
+#define SPOOF_COURSE_MIN_DISTANCE_M 500.0  // Shorter moves have no reliable direction
+#define SPOOF_COURSE_MIN_SOG_KNOTS 3.0     // Nor do vessels that are barely moving
+#define SPOOF_COURSE_TOLERANCE_DEG 60.0    // Track bearing vs COG/heading
+#define SPOOF_FLAT_MAX_RADIANS 0.02        // Equirectangular distance below ~1.1 degrees...
+#define SPOOF_FLAT_MAX_LATITUDE 1.2        // ...and below ~69 degrees latitude, else haversine
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#error "The columnar writer stores arrays in host order and assumes little-endian"
+#endif
+
+
+// MMSI straight from the armoured payload (bits 8-37 live in characters 1-6), so a copy can
+// be matched before it is de-armoured; 0 if the payload is too short or not valid armour
+static uint32_t armoured_mmsi(const char *payload, int len) {
+    if (len < 7) {
+        return 0;
+    }
+    uint64_t bits = 0;
+    for (int i = 1; i <= 6; i++) {
+        int v = convert_ais_char(payload[i]);
+        if (v < 0) {
+            return 0;
+        }
+        bits = (bits << 6) | (uint64_t)v;
+    }
+    return (uint32_t)(bits >> 4) & 0x3FFFFFFF;
+}
+
+// 64-bit hash of a payload, eight characters per multiply
+static uint64_t payload_hash(const char *payload, int len) {
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ (uint64_t)len;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, payload + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    if (i < len) {
+        uint64_t w = 0;
+        memcpy(&w, payload + i, (size_t)(len - i));
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    return h * 0xC4CEB9FE1A85EC53ULL;
+}
+
+// One remembered message; hash 0 marks an empty slot
+typedef struct {
+    uint64_t hash;
+    uint32_t mmsi;
+    uint32_t seen;             // Clock of the latest copy, truncated (the window is far shorter)
+} DedupEntry;
+
+// Messages seen inside the window, in a fixed amount of memory. Entries go into the current
+// generation; once it spans a whole window (or fills up) the previous one is cleared and
+// becomes current, so an entry lives for at least one window and at most two
+typedef struct {
+    DedupEntry *generations[2];
+    int current;
+    uint32_t count;            // Entries in the current generation
+    uint64_t started;          // Clock when the current generation was started
+    uint64_t window;           // Lines for file input, milliseconds with a receive clock
+    int timed;                 // Clock is ctx->clock_ms rather than ctx->line_clock
+    uint64_t early_rotations;  // Generations rotated out because they were full
+} DedupSet;
+
+DedupSet *dedup_set_create(uint64_t window, int timed) {
+    DedupSet *set = calloc(1, sizeof(DedupSet));
+    if (set == NULL) {
+        return NULL;
+    }
+    set->generations[0] = calloc(DEDUP_SET_SLOTS, sizeof(DedupEntry));
+    set->generations[1] = calloc(DEDUP_SET_SLOTS, sizeof(DedupEntry));
+    if (set->generations[0] == NULL || set->generations[1] == NULL) {
+        free(set->generations[0]);
+        free(set->generations[1]);
+        free(set);
+        return NULL;
+    }
+    set->window = window;
+    set->timed = timed;
+    return set;
+}
+
+void dedup_set_free(DedupSet *set) {
+    if (set != NULL) {
+        free(set->generations[0]);
+        free(set->generations[1]);
+        free(set);
+    }
+}
+
+// Forget everything (a parallel worker starting its next chunk)
+void dedup_set_reset(DedupSet *set) {
+    memset(set->generations[0], 0, DEDUP_SET_SLOTS * sizeof(DedupEntry));
+    memset(set->generations[1], 0, DEDUP_SET_SLOTS * sizeof(DedupEntry));
+    set->current = 0;
+    set->count = 0;
+    set->started = 0;
+    set->early_rotations = 0;
+}
+
+static DedupEntry *dedup_probe(DedupEntry *slots, uint64_t hash, uint32_t mmsi) {
+    uint32_t i = (uint32_t)hash & (DEDUP_SET_SLOTS - 1);
+    while (slots[i].hash != 0 && (slots[i].hash != hash || slots[i].mmsi != mmsi)) {
+        i = (i + 1) & (DEDUP_SET_SLOTS - 1);
+    }
+    return &slots[i];
+}
+
+// Record a message; returns 1 if the same payload from the same MMSI was already seen within
+// the window. The window runs from the latest copy, so a chunk's warm-up replay of the
+// preceding window leaves the set answering exactly as the serial run would
+int dedup_set_check(DedupSet *set, const char *payload, int len, uint32_t mmsi, uint64_t now) {
+    uint64_t hash = payload_hash(payload, len) | 1;
+
+    if (now - set->started >= set->window || set->count >= DEDUP_SET_MAX_LOAD) {
+        if (set->count >= DEDUP_SET_MAX_LOAD) {
+            set->early_rotations++;
+        }
+        set->current ^= 1;
+        memset(set->generations[set->current], 0, DEDUP_SET_SLOTS * sizeof(DedupEntry));
+        set->count = 0;
+        set->started = now;
+    }
+
+    DedupEntry *entry = dedup_probe(set->generations[set->current], hash, mmsi);
+    int duplicate = 0;
+    if (entry->hash != 0) {
+        duplicate = (uint32_t)now - entry->seen <= set->window;
+    } else {
+        DedupEntry *old = dedup_probe(set->generations[set->current ^ 1], hash, mmsi);
+        duplicate = old->hash != 0 && (uint32_t)now - old->seen <= set->window;
+        entry->hash = hash;
+        entry->mmsi = mmsi;
+        set->count++;
+    }
+    entry->seen = (uint32_t)now;
+    return duplicate;
+}
+
+// One memoised decode; hash 0 marks an empty way
+typedef struct {
+    uint64_t hash;
+    uint32_t last_used;
+    int payload_len;
+    AISData data;
+} MemoEntry;
+
+// Fixed-size set-associative cache from payload hash to decoded record. The 64-bit hash and
+// length stand in for the payload itself; a false match needs a hash collision within one set
+typedef struct {
+    MemoEntry entries[MEMO_CACHE_SETS][MEMO_CACHE_WAYS];
+    uint32_t clock;
+} MemoCache;
+
+MemoCache *memo_cache_create(void) {
+    return calloc(1, sizeof(MemoCache));
+}
+
+// Whether messages of this type (from the first payload character) are worth caching
+static int memo_cache_wants(const char *payload, int payload_len) {
+    int msg_type = payload_len > 0 ? convert_ais_char(payload[0]) : -1;
+    return msg_type >= 0 && msg_type < 32 && ((MEMO_CACHE_TYPES >> msg_type) & 1);
+}
+
+// Copy the cached record for this payload into data; returns 0 on a miss
+int memo_cache_lookup(MemoCache *cache, uint64_t hash, int payload_len, AISData *data) {
+    MemoEntry *set = cache->entries[(hash >> 32) & (MEMO_CACHE_SETS - 1)];
+    for (int i = 0; i < MEMO_CACHE_WAYS; i++) {
+        if (set[i].hash == hash && set[i].payload_len == payload_len) {
+            set[i].last_used = ++cache->clock;
+            *data = set[i].data;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void memo_cache_store(MemoCache *cache, uint64_t hash, int payload_len, const AISData *data) {
+    MemoEntry *set = cache->entries[(hash >> 32) & (MEMO_CACHE_SETS - 1)];
+    MemoEntry *victim = &set[0];
+    for (int i = 1; i < MEMO_CACHE_WAYS; i++) {
+        if (set[i].last_used < victim->last_used) {
+            victim = &set[i];
+        }
+    }
+    victim->hash = hash;
+    victim->last_used = ++cache->clock;
+    victim->payload_len = payload_len;
+    victim->data = *data;
+}
+
+// Inclusive MMSI range; a single MMSI has first == last
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+} MmsiRange;
+
+// Which messages to keep (--types, --mmsi, --bbox). Every test works on the armoured payload,
+// so a rejected message is never de-armoured beyond the characters the test needs
+typedef struct {
+    uint32_t type_mask;          // Bit per message type to keep, 0 = every type
+    MmsiRange *mmsi_ranges;      // Sorted, non-overlapping; NULL = every MMSI
+    int mmsi_range_count;
+    int bbox;                    // Keep only messages with a position inside the box
+    int32_t min_lon, max_lon;    // 1/10000 minute as in AISData; min > max crosses 180 degrees
+    int32_t min_lat, max_lat;
+} MessageFilter;
+
+void message_filter_free(MessageFilter *filter) {
+    free(filter->mmsi_ranges);
+    filter->mmsi_ranges = NULL;
+    filter->mmsi_range_count = 0;
+}
+
+int message_filter_active(const MessageFilter *filter) {
+    return filter->type_mask != 0 || filter->mmsi_ranges != NULL || filter->bbox;
+}
+
+// Parse "1,2,3,18" or "1-3,18" into a type mask; returns 0 if malformed
+int parse_type_filter(const char *spec, uint32_t *mask) {
+    const char *p = spec;
+    *mask = 0;
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end != p && *end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+        }
+        if (end == p || first < 1 || last > 27 || first > last || (*end != ',' && *end != '\0')) {
+            return 0;
+        }
+        for (long t = first; t <= last; t++) {
+            *mask |= 1u << t;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    return *mask != 0;
+}
+
+static int compare_mmsi_ranges(const void *a, const void *b) {
+    const MmsiRange *x = a;
+    const MmsiRange *y = b;
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+// Add MMSIs and ranges ("244123456", "211000000-211999999") separated by commas or white
+// space; returns 0 if malformed or out of memory
+static int add_mmsi_ranges(MessageFilter *filter, const char *text, int *cap) {
+    const char *p = text;
+    while (*p) {
+        if (*p == ',' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+            p++;
+            continue;
+        }
+        char *end;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last = first;
+        if (end != p && *end == '-') {
+            p = end + 1;
+            last = strtoul(p, &end, 10);
+        }
+        if (end == p || first > last || last > 0x3FFFFFFF ||
+            (*end != '\0' && *end != ',' && *end != ' ' && *end != '\t' && *end != '\r' && *end != '\n')) {
+            return 0;
+        }
+        if (filter->mmsi_range_count == *cap) {
+            *cap = *cap ? *cap * 2 : 64;
+            MmsiRange *grown = realloc(filter->mmsi_ranges, (size_t)*cap * sizeof(MmsiRange));
+            if (grown == NULL) {
+                return 0;
+            }
+            filter->mmsi_ranges = grown;
+        }
+        filter->mmsi_ranges[filter->mmsi_range_count].first = (uint32_t)first;
+        filter->mmsi_ranges[filter->mmsi_range_count].last = (uint32_t)last;
+        filter->mmsi_range_count++;
+        p = end;
+    }
+    return 1;
+}
+
+// Parse an MMSI list, or @FILE holding one; ranges are sorted and merged so a lookup is one
+// binary search. Returns 0 if malformed, unreadable or empty
+int parse_mmsi_filter(MessageFilter *filter, const char *spec) {
+    int cap = filter->mmsi_range_count;
+    int ok;
+    if (spec[0] == '@') {
+        FILE *file = fopen(spec + 1, "rb");
+        if (file == NULL) {
+            return 0;
+        }
+        char line[MAX_LINE_LENGTH];
+        ok = 1;
+        while (ok && fgets(line, sizeof(line), file) != NULL) {
+            if (line[0] != '#') {
+                ok = add_mmsi_ranges(filter, line, &cap);
+            }
+        }
+        fclose(file);
+    } else {
+        ok = add_mmsi_ranges(filter, spec, &cap);
+    }
+    if (!ok || filter->mmsi_range_count == 0) {
+        return 0;
+    }
+
+    qsort(filter->mmsi_ranges, (size_t)filter->mmsi_range_count, sizeof(MmsiRange), compare_mmsi_ranges);
+    int merged = 0;
+    for (int i = 1; i < filter->mmsi_range_count; i++) {
+        MmsiRange *last = &filter->mmsi_ranges[merged];
+        if (filter->mmsi_ranges[i].first <= last->last + 1) {
+            if (filter->mmsi_ranges[i].last > last->last) {
+                last->last = filter->mmsi_ranges[i].last;
+            }
+        } else {
+            filter->mmsi_ranges[++merged] = filter->mmsi_ranges[i];
+        }
+    }
+    filter->mmsi_range_count = merged + 1;
+    return 1;
+}
+
+// Parse "WEST,SOUTH,EAST,NORTH" in decimal degrees; returns 0 if malformed
+int parse_bbox_filter(MessageFilter *filter, const char *spec) {
+    double west, south, east, north;
+    char extra;
+    if (sscanf(spec, "%lf,%lf,%lf,%lf%c", &west, &south, &east, &north, &extra) != 4 ||
+        west < -180.0 || west > 180.0 || east < -180.0 || east > 180.0 ||
+        south < -90.0 || north > 90.0 || south > north) {
+        return 0;
+    }
+    filter->bbox = 1;
+    filter->min_lon = (int32_t)lrint(west * 600000.0);
+    filter->max_lon = (int32_t)lrint(east * 600000.0);
+    filter->min_lat = (int32_t)lrint(south * 600000.0);
+    filter->max_lat = (int32_t)lrint(north * 600000.0);
+    return 1;
+}
+
+// Parse a comma-separated list of column names (AISData field or CSV header names) into an
+// AIS_COLUMN_BIT mask; returns 0 if a name is unknown
+int parse_column_list(const char *spec, uint64_t *columns) {
+    const char *p = spec;
+    *columns = 0;
+    while (*p) {
+        const char *end = strchr(p, ',');
+        int len = end != NULL ? (int)(end - p) : (int)strlen(p);
+        int column = ais_column_index(p, len);
+        if (column < 0) {
+            return 0;
+        }
+        *columns |= 1ull << column;
+        p += len + (end != NULL);
+    }
+    return *columns != 0;
+}
+
+static int mmsi_in_ranges(const MessageFilter *filter, uint32_t mmsi) {
+    int lo = 0;
+    int hi = filter->mmsi_range_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) >> 1;
+        if (mmsi < filter->mmsi_ranges[mid].first) {
+            hi = mid - 1;
+        } else if (mmsi > filter->mmsi_ranges[mid].last) {
+            lo = mid + 1;
+        } else {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether a reassembled payload passes the filter: type from the first character, MMSI from
+// the next six, then (only with --bbox) the position bits de-armoured by peek_ais_position
+static int message_filter_pass(const MessageFilter *filter, const char *payload, int payload_len) {
+    if (filter->type_mask != 0) {
+        int msg_type = payload_len > 0 ? convert_ais_char(payload[0]) : -1;
+        if (msg_type < 0 || msg_type >= 32 || !((filter->type_mask >> msg_type) & 1)) {
+            return 0;
+        }
+    }
+    if (filter->mmsi_ranges != NULL && !mmsi_in_ranges(filter, armoured_mmsi(payload, payload_len))) {
+        return 0;
+    }
+    if (filter->bbox) {
+        int32_t lon, lat;
+        if (!peek_ais_position(payload, payload_len, &lon, &lat) ||
+            lat < filter->min_lat || lat > filter->max_lat) {
+            return 0;
+        }
+        if (filter->min_lon <= filter->max_lon ? lon < filter->min_lon || lon > filter->max_lon
+                                               : lon < filter->min_lon && lon > filter->max_lon) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Columnar archive (--format=columnar)
+ *
+ * Every field in AIS_RECORD_COLUMNS (or those picked with --columns) is stored as a
+ * fixed-width little-endian array, so a reader can memory-map the file and view lat/lon/mmsi
+ * in place without parsing anything. Rows are written in row groups of up to
+ * COLUMNAR_GROUP_ROWS; every array starts 64-byte aligned.
+ *
+ *   header   64 bytes: "AISCOL1\0", u32 version, u32 column count, zero padding
+ *   groups   per row group: one array per column, then the group's row numbers (u4,
+ *            group-local) sorted by message type
+ *   footer   column directory: per column char name[24], char dtype[4] (numpy type
+ *            string, NUL-padded), u32 flags
+ *            group directory: per group u64 first row, u64 row count, u64 offset of each column
+ *            type index: per group and message type 0-27, u64 offset and u64 count of its
+ *            row numbers (offset 0 when the count is 0)
+ *            dictionary: u32 end offset of each string, then the string bytes; string i
+ *            spans [end[i-1], end[i]) and string 0 is ""
+ *   trailer  last 64 bytes: u64 rows, u64 column directory, group directory, type index
+ *            and dictionary offsets, u32 groups, u32 columns, u32 strings, u32 version,
+ *            "AISCOL1\0"
+ *
+ * Text columns (COLUMNAR_DICTIONARY flag) hold u4 ids into the dictionary. Units are
+ * those of AISData: lon/lat in 1/10000 minute, sog/cog/draught in tenths, and the flags
+ * column tells whether lon, lat and rot are present. Reading it with numpy:
+ *
+ *   m = np.memmap(path, dtype=np.uint8, mode="r")
+ *   rows, cols_at, groups_at, types_at, dict_at, groups, ncols, nstrings = \
+ *       struct.unpack_from("<5Q3I", m, len(m) - 64)
+ *   cols = np.frombuffer(m, [("name", "S24"), ("dtype", "S4"), ("flags", "<u4")], ncols, cols_at)
+ *   gdir = np.frombuffer(m, "<u8", groups * (2 + ncols), groups_at).reshape(groups, 2 + ncols)
+ *   def column(name):
+ *       c = list(cols["name"]).index(name.encode())
+ *       return np.concatenate([np.frombuffer(m, cols["dtype"][c].decode(), g[1], g[2 + c]) for g in gdir])
+ *   lat = column("lat") / 600000.0
+ *
+ * With a single row group (up to 65536 rows) column() is a view into the mapping.
+ */
+
+// Distinct strings of the text columns, looked up through an open-addressing hash table
+typedef struct {
+    char *bytes;          // All strings back to back, no terminators
+    size_t length;
+    size_t capacity;
+    uint32_t *ends;       // ends[i] = end of string i in bytes
+    uint32_t count;
+    uint32_t ends_capacity;
+    uint32_t *slots;      // String id + 1, 0 = empty
+    uint32_t slot_mask;
+} StringDictionary;
+
+// Fixed-size end of the file that locates everything else
+typedef struct {
+    uint64_t rows;
+    uint64_t columns_offset;
+    uint64_t groups_offset;
+    uint64_t types_offset;
+    uint64_t dictionary_offset;
+    uint32_t groups;
+    uint32_t columns;
+    uint32_t strings;
+    uint32_t version;
+    char magic[8];
+} ColumnarTrailer;
+
+typedef struct {
+    FILE *file;
+    uint64_t offset;                  // Bytes written so far
+    uint64_t rows;
+    uint32_t group_rows;              // Rows buffered for the current group
+    int column_count;                 // Columns written (--columns), in RECORD_COLUMNS order
+    uint8_t column_ids[RECORD_COLUMN_COUNT];
+    uint8_t *columns[RECORD_COLUMN_COUNT];
+    uint8_t *types;                   // Message type of each buffered row, for the type index
+    uint32_t *type_order;             // Scratch for the group's type index
+    uint64_t *group_directory;        // 2 + column_count values per group
+    uint64_t *type_index;             // 2 * COLUMNAR_TYPES values per group
+    uint32_t num_groups;
+    uint32_t groups_capacity;
+    StringDictionary strings;
+    int failed;                       // Write or allocation error, reported by close
+} ColumnarWriter;
+
+static uint32_t fnv1a_hash(const char *text, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static uint32_t string_dictionary_start(const StringDictionary *dict, uint32_t id) {
+    return id ? dict->ends[id - 1] : 0;
+}
+
+static uint32_t string_dictionary_intern(StringDictionary *dict, const char *text);
+
+// Empty dictionary holding "" as string 0; returns 0 if out of memory
+static int string_dictionary_init(StringDictionary *dict) {
+    memset(dict, 0, sizeof(*dict));
+    dict->capacity = 16 * 1024;
+    dict->bytes = malloc(dict->capacity);
+    dict->ends_capacity = 1024;
+    dict->ends = malloc(dict->ends_capacity * sizeof(uint32_t));
+    dict->slot_mask = 2047;
+    dict->slots = calloc(dict->slot_mask + 1, sizeof(uint32_t));
+    return dict->bytes != NULL && dict->ends != NULL && dict->slots != NULL && string_dictionary_intern(dict, "") == 0;
+}
+
+static void string_dictionary_free(StringDictionary *dict) {
+    free(dict->bytes);
+    free(dict->ends);
+    free(dict->slots);
+}
+
+// Double the hash table once it is half full
+static int string_dictionary_rehash(StringDictionary *dict) {
+    uint32_t mask = dict->slot_mask * 2 + 1;
+    uint32_t *slots = calloc((size_t)mask + 1, sizeof(uint32_t));
+    if (slots == NULL) {
+        return 0;
+    }
+    for (uint32_t id = 0; id < dict->count; id++) {
+        uint32_t start = string_dictionary_start(dict, id);
+        uint32_t slot = fnv1a_hash(dict->bytes + start, dict->ends[id] - start) & mask;
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = id + 1;
+    }
+    free(dict->slots);
+    dict->slots = slots;
+    dict->slot_mask = mask;
+    return 1;
+}
+
+// Id of text in the dictionary, adding it if new; UINT32_MAX if out of memory
+static uint32_t string_dictionary_intern(StringDictionary *dict, const char *text) {
+    size_t len = strlen(text);
+
+    if ((dict->count + 1) * 2 > dict->slot_mask + 1 && !string_dictionary_rehash(dict)) {
+        return UINT32_MAX;
+    }
+
+    uint32_t slot = fnv1a_hash(text, len) & dict->slot_mask;
+    while (dict->slots[slot] != 0) {
+        uint32_t id = dict->slots[slot] - 1;
+        uint32_t start = string_dictionary_start(dict, id);
+        if (dict->ends[id] - start == len && memcmp(dict->bytes + start, text, len) == 0) {
+            return id;
+        }
+        slot = (slot + 1) & dict->slot_mask;
+    }
+
+    if (dict->length + len > dict->capacity) {
+        size_t capacity = dict->capacity * 2 + len;
+        char *bytes = realloc(dict->bytes, capacity);
+        if (bytes == NULL) {
+            return UINT32_MAX;
+        }
+        dict->bytes = bytes;
+        dict->capacity = capacity;
+    }
+    if (dict->count == dict->ends_capacity) {
+        uint32_t *ends = realloc(dict->ends, (size_t)dict->ends_capacity * 2 * sizeof(uint32_t));
+        if (ends == NULL) {
+            return UINT32_MAX;
+        }
+        dict->ends = ends;
+        dict->ends_capacity *= 2;
+    }
+
+    memcpy(dict->bytes + dict->length, text, len);
+    dict->length += len;
+    dict->ends[dict->count] = (uint32_t)dict->length;
+    dict->slots[slot] = dict->count + 1;
+    return dict->count++;
+}
+
+static void columnar_write(ColumnarWriter *w, const void *data, size_t len) {
+    if (len > 0 && fwrite(data, 1, len, w->file) != len) {
+        w->failed = 1;
+    }
+    w->offset += len;
+}
+
+// Zero-fill up to the next COLUMNAR_ALIGN boundary
+static void columnar_pad(ColumnarWriter *w) {
+    static const uint8_t zeros[COLUMNAR_ALIGN];
+    columnar_write(w, zeros, (size_t)(-w->offset & (COLUMNAR_ALIGN - 1)));
+}
+
+void columnar_writer_free(ColumnarWriter *w) {
+    for (int c = 0; c < w->column_count; c++) {
+        free(w->columns[c]);
+    }
+    free(w->types);
+    free(w->type_order);
+    free(w->group_directory);
+    free(w->type_index);
+    string_dictionary_free(&w->strings);
+    free(w);
+}
+
+// Start an archive of the columns of a plan (NULL = all) on a file opened in binary mode;
+// NULL if out of memory
+ColumnarWriter *columnar_writer_open(FILE *file, const AISProjection *projection) {
+    ColumnarWriter *w = calloc(1, sizeof(ColumnarWriter));
+    int ok = w != NULL;
+
+    for (int c = 0; ok && c < RECORD_COLUMN_COUNT; c++) {
+        if (projection != NULL && !((projection->columns >> c) & 1)) {
+            continue;
+        }
+        w->column_ids[w->column_count] = (uint8_t)c;
+        w->columns[w->column_count] = malloc((size_t)COLUMNAR_GROUP_ROWS * RECORD_COLUMNS[c].width);
+        ok = w->columns[w->column_count++] != NULL;
+    }
+    if (ok) {
+        w->types = malloc(COLUMNAR_GROUP_ROWS);
+        w->type_order = malloc(COLUMNAR_GROUP_ROWS * sizeof(uint32_t));
+        ok = string_dictionary_init(&w->strings) && w->types != NULL && w->type_order != NULL;
+    }
+    if (!ok) {
+        if (w != NULL) {
+            columnar_writer_free(w);
+        }
+        return NULL;
+    }
+
+    uint8_t header[COLUMNAR_ALIGN];
+    uint32_t version = COLUMNAR_VERSION;
+    uint32_t columns = (uint32_t)w->column_count;
+    memset(header, 0, sizeof(header));
+    memcpy(header, COLUMNAR_MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &columns, 4);
+    w->file = file;
+    columnar_write(w, header, sizeof(header));
+    return w;
+}
+
+// Write the buffered rows as one row group: its column arrays, then its type index
+static void columnar_flush_group(ColumnarWriter *w) {
+    uint32_t rows = w->group_rows;
+
+    if (rows == 0) {
+        return;
+    }
+    if (w->num_groups == w->groups_capacity) {
+        uint32_t capacity = w->groups_capacity ? w->groups_capacity * 2 : 64;
+        uint64_t *directory = realloc(w->group_directory,
+                                      (size_t)capacity * (2 + w->column_count) * sizeof(uint64_t));
+        if (directory != NULL) {
+            w->group_directory = directory;
+        }
+        uint64_t *index = realloc(w->type_index, (size_t)capacity * 2 * COLUMNAR_TYPES * sizeof(uint64_t));
+        if (index != NULL) {
+            w->type_index = index;
+        }
+        if (directory == NULL || index == NULL) {
+            w->failed = 1;
+            w->group_rows = 0;
+            return;
+        }
+        w->groups_capacity = capacity;
+    }
+
+    uint64_t *entry = w->group_directory + (size_t)w->num_groups * (2 + w->column_count);
+    entry[0] = w->rows - rows;
+    entry[1] = rows;
+    for (int c = 0; c < w->column_count; c++) {
+        entry[2 + c] = w->offset;
+        columnar_write(w, w->columns[c], (size_t)rows * RECORD_COLUMNS[w->column_ids[c]].width);
+        columnar_pad(w);
+    }
+
+    // Counting sort of the row numbers by message type (decoded types are always 1-27)
+    const uint8_t *types = w->types;
+    uint32_t counts[COLUMNAR_TYPES] = {0};
+    uint32_t next[COLUMNAR_TYPES];
+    uint64_t *index = w->type_index + (size_t)w->num_groups * 2 * COLUMNAR_TYPES;
+    uint32_t sum = 0;
+
+    for (uint32_t r = 0; r < rows; r++) {
+        counts[types[r]]++;
+    }
+    for (int t = 0; t < COLUMNAR_TYPES; t++) {
+        next[t] = sum;
+        index[2 * t] = counts[t] ? w->offset + (uint64_t)sum * sizeof(uint32_t) : 0;
+        index[2 * t + 1] = counts[t];
+        sum += counts[t];
+    }
+    for (uint32_t r = 0; r < rows; r++) {
+        w->type_order[next[types[r]]++] = r;
+    }
+    columnar_write(w, w->type_order, (size_t)rows * sizeof(uint32_t));
+    columnar_pad(w);
+
+    w->num_groups++;
+    w->group_rows = 0;
+}
+
+void columnar_writer_append(ColumnarWriter *w, const AISData *data) {
+    uint32_t row = w->group_rows;
+
+    w->types[row] = data->msg_type;
+    for (int c = 0; c < w->column_count; c++) {
+        const RecordColumn *column = &RECORD_COLUMNS[w->column_ids[c]];
+        const uint8_t *field = (const uint8_t *)data + column->offset;
+        uint8_t *out = w->columns[c] + (size_t)row * column->width;
+
+        if (column->flags & COLUMNAR_DICTIONARY) {
+            uint32_t id = string_dictionary_intern(&w->strings, (const char *)field);
+            if (id == UINT32_MAX) {
+                w->failed = 1;
+                id = 0;
+            }
+            memcpy(out, &id, sizeof(id));
+        } else {
+            memcpy(out, field, (size_t)column->width);
+        }
+    }
+
+    w->rows++;
+    if (++w->group_rows == COLUMNAR_GROUP_ROWS) {
+        columnar_flush_group(w);
+    }
+}
+
+// Write the last row group, footer and trailer, then free the writer (the file stays open)
+// Returns 0 if anything could not be written
+int columnar_writer_close(ColumnarWriter *w) {
+    ColumnarTrailer trailer;
+
+    columnar_flush_group(w);
+    memset(&trailer, 0, sizeof(trailer));
+
+    trailer.columns_offset = w->offset;
+    for (int c = 0; c < w->column_count; c++) {
+        const RecordColumn *column = &RECORD_COLUMNS[w->column_ids[c]];
+        uint8_t entry[32];
+        memset(entry, 0, sizeof(entry));
+        strncpy((char *)entry, column->name, 23);
+        strncpy((char *)entry + 24, column->dtype, 4);
+        memcpy(entry + 28, &column->flags, 4);
+        columnar_write(w, entry, sizeof(entry));
+    }
+    columnar_pad(w);
+
+    trailer.groups_offset = w->offset;
+    columnar_write(w, w->group_directory,
+                   (size_t)w->num_groups * (2 + w->column_count) * sizeof(uint64_t));
+    columnar_pad(w);
+
+    trailer.types_offset = w->offset;
+    columnar_write(w, w->type_index, (size_t)w->num_groups * 2 * COLUMNAR_TYPES * sizeof(uint64_t));
+    columnar_pad(w);
+
+    trailer.dictionary_offset = w->offset;
+    columnar_write(w, w->strings.ends, (size_t)w->strings.count * sizeof(uint32_t));
+    columnar_write(w, w->strings.bytes, w->strings.length);
+    columnar_pad(w);
+
+    trailer.rows = w->rows;
+    trailer.groups = w->num_groups;
+    trailer.columns = (uint32_t)w->column_count;
+    trailer.strings = w->strings.count;
+    trailer.version = COLUMNAR_VERSION;
+    memcpy(trailer.magic, COLUMNAR_MAGIC, 8);
+    columnar_write(w, &trailer, sizeof(trailer));
+
+    int ok = !w->failed;
+    columnar_writer_free(w);
+    return ok;
+}
+
+// The part of a decoded message the vessel table keeps (parallel workers buffer only this)
+typedef struct {
+    uint64_t received_ms;
+    uint32_t mmsi;
+    int32_t lon;
+    int32_t lat;
+    uint16_t sog;
+    uint16_t cog;
+    uint16_t heading;
+    uint8_t msg_type;
+    uint8_t utc_sec;
+    uint8_t flags;
+    char channel;              // 'A', 'B' or '\0' (NMEA 4.0 '1'/'2' are mapped to A/B)
+    uint8_t duplicate;         // A suppressed copy: counts as a reception, nothing else
+} VesselReport;
+
+void vessel_report_from_ais(const AISData *data, VesselReport *report) {
+    report->received_ms = data->received_ms;
+    report->mmsi = data->mmsi;
+    report->lon = data->lon;
+    report->lat = data->lat;
+    report->sog = data->sog;
+    report->cog = data->cog;
+    report->heading = data->heading;
+    report->msg_type = data->msg_type;
+    report->utc_sec = data->utc_sec;
+    report->flags = data->flags;
+    report->channel = '\0';
+    report->duplicate = 0;
+}
+
+// AIS radio channel of a sentence, normalised to 'A'/'B'; '\0' when absent or unknown
+static char ais_channel(char c) {
+    if (c == 'A' || c == '1') {
+        return 'A';
+    }
+    if (c == 'B' || c == '2') {
+        return 'B';
+    }
+    return '\0';
+}
+
+static void *alloc_cache_aligned(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size, VESSEL_STATE_BYTES);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, VESSEL_STATE_BYTES, size) == 0 ? p : NULL;
+#endif
+}
+
+static void free_cache_aligned(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+/*
+ * MMSI index: open addressing (linear probing) from MMSI to a row of a dense array of
+ * fixed-size records, numbered in the order MMSIs were first seen. Every per-vessel table
+ * keeps its records as rows, so the probe and growth logic lives here only.
+ * Probing touches 8-byte slots only. The row array is cache-line aligned and each row
+ * starts with the uint32_t MMSI; rows move when the array doubles, so a row pointer is
+ * only good until the next mmsi_index_add.
+ */
+typedef struct {
+    uint32_t mmsi;             // 0 = empty slot (MMSI 0 is not a valid identity and is not added)
+    uint32_t row;
+} MmsiSlot;
+
+typedef struct {
+    MmsiSlot *slots;
+    uint32_t mask;             // Slot count - 1, slot count is a power of two
+    uint32_t count;            // Rows in use
+    uint32_t capacity;         // Rows allocated
+    size_t row_size;
+    unsigned char *rows;
+    int full;                  // Slot growth failed and the index is full; new MMSIs are ignored
+} MmsiIndex;
+
+static uint32_t mmsi_home_slot(uint32_t mask, uint32_t mmsi) {
+    return (uint32_t)((mmsi * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+// slots must be a power of two; row_size is the record size. Returns 0 if out of memory
+int mmsi_index_init(MmsiIndex *index, uint32_t slots, size_t row_size) {
+    memset(index, 0, sizeof(*index));
+    index->slots = calloc(slots, sizeof(MmsiSlot));
+    if (index->slots == NULL) {
+        return 0;
+    }
+    index->mask = slots - 1;
+    index->row_size = row_size;
+    return 1;
+}
+
+void mmsi_index_free(MmsiIndex *index) {
+    free(index->slots);
+    free_cache_aligned(index->rows);
+    index->slots = NULL;
+    index->rows = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+// Row number row (below count)
+static inline void *mmsi_index_row(const MmsiIndex *index, uint32_t row) {
+    return index->rows + (size_t)row * index->row_size;
+}
+
+// Row of mmsi, or NULL if it has not been added
+void *mmsi_index_find(const MmsiIndex *index, uint32_t mmsi) {
+    if (mmsi == 0) {
+        return NULL;
+    }
+    for (uint32_t i = mmsi_home_slot(index->mask, mmsi);; i = (i + 1) & index->mask) {
+        if (index->slots[i].mmsi == mmsi) {
+            return mmsi_index_row(index, index->slots[i].row);
+        }
+        if (index->slots[i].mmsi == 0) {
+            return NULL;
+        }
+    }
+}
+
+// Double the slot count once the index is 3/4 full; rows stay where they are
+static int mmsi_index_grow_slots(MmsiIndex *index) {
+    if (index->mask >= 0x7FFFFFFF) {
+        return 0;
+    }
+    uint32_t mask = index->mask * 2 + 1;
+    MmsiSlot *slots = calloc((size_t)mask + 1, sizeof(MmsiSlot));
+    if (slots == NULL) {
+        return 0;
+    }
+    for (uint32_t i = 0; i <= index->mask; i++) {
+        if (index->slots[i].mmsi != 0) {
+            uint32_t j = mmsi_home_slot(mask, index->slots[i].mmsi);
+            while (slots[j].mmsi != 0) {
+                j = (j + 1) & mask;
+            }
+            slots[j] = index->slots[i];
+        }
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->mask = mask;
+    return 1;
+}
+
+// Double the row array; rows move, so earlier row pointers are stale afterwards
+static int mmsi_index_grow_rows(MmsiIndex *index) {
+    uint32_t capacity = index->capacity ? index->capacity * 2 : MMSI_INDEX_INITIAL_ROWS;
+    unsigned char *rows = alloc_cache_aligned((size_t)capacity * index->row_size);
+    if (rows == NULL) {
+        return 0;
+    }
+    if (index->count > 0) {
+        memcpy(rows, index->rows, (size_t)index->count * index->row_size);
+    }
+    free_cache_aligned(index->rows);
+    index->rows = rows;
+    index->capacity = capacity;
+    return 1;
+}
+
+// Row of mmsi, adding one (zeroed apart from its MMSI) if it is new; NULL if it cannot be stored
+void *mmsi_index_add(MmsiIndex *index, uint32_t mmsi) {
+    if (mmsi == 0) {
+        return NULL;
+    }
+    uint32_t i = mmsi_home_slot(index->mask, mmsi);
+    while (index->slots[i].mmsi != mmsi) {
+        if (index->slots[i].mmsi == 0) {
+            if ((uint64_t)(index->count + 1) * 4 > (uint64_t)(index->mask + 1) * 3 && !index->full) {
+                if (mmsi_index_grow_slots(index)) {
+                    return mmsi_index_add(index, mmsi);
+                }
+                index->full = 1;
+            }
+            if (index->count == index->mask) {
+                return NULL; // Keep one empty slot so lookups terminate
+            }
+            if (index->count == index->capacity && !mmsi_index_grow_rows(index)) {
+                return NULL;
+            }
+            void *row = mmsi_index_row(index, index->count);
+            memset(row, 0, index->row_size);
+            memcpy(row, &mmsi, sizeof(mmsi));
+            index->slots[i].mmsi = mmsi;
+            index->slots[i].row = index->count++;
+            return row;
+        }
+        i = (i + 1) & index->mask;
+    }
+    return mmsi_index_row(index, index->slots[i].row);
+}
+
+// Latest known state of one vessel, exactly one cache line so a lookup touches one line
+typedef struct {
+    uint32_t mmsi;             // Set by the index when the row is added
+    int32_t lon;               // Last position (1/10000 minute), valid when flags has AIS_FLAG_LON
+    int32_t lat;
+    uint16_t sog;              // From the last position report, AISData units
+    uint16_t cog;
+    uint16_t heading;
+    uint8_t msg_type;          // Type of the last message of any kind
+    uint8_t position_type;     // Type of the last position report, 0 if none yet
+    uint8_t utc_sec;           // Time stamp field of the last position report
+    uint8_t flags;             // AIS_FLAG_* of the last position report
+    uint8_t reserved[2];
+    uint32_t messages;         // Messages of any type
+    uint32_t position_reports;
+    uint64_t last_seen_ms;     // received_ms of the last message
+    uint64_t position_ms;      // received_ms of the last position report
+    uint64_t position_seq;     // Table-wide update counter at the last position report
+    uint32_t channel_a;        // Receptions on each channel, duplicates included
+    uint32_t channel_b;
+} VesselState;
+
+// Fails to compile if VesselState is not one cache line
+typedef char vessel_state_size_check[sizeof(VesselState) == VESSEL_STATE_BYTES ? 1 : -1];
+
+// VesselState rows keyed by MMSI
+typedef struct {
+    MmsiIndex index;
+    uint64_t updates;          // Messages applied, orders position reports across vessels
+} VesselTable;
+
+// slots must be a power of two; returns 0 if out of memory
+int vessel_table_init(VesselTable *table, uint32_t slots) {
+    memset(table, 0, sizeof(*table));
+    return mmsi_index_init(&table->index, slots, sizeof(VesselState));
+}
+
+void vessel_table_free(VesselTable *table) {
+    mmsi_index_free(&table->index);
+}
+
+// State of mmsi, or NULL if it has not been seen
+VesselState *vessel_table_find(const VesselTable *table, uint32_t mmsi) {
+    return mmsi_index_find(&table->index, mmsi);
+}
+
+// Why a position report looks spoofed (bit index in spoof_reasons' result; counted in
+// SpoofDetector.reasons)
+typedef enum {
+    SPOOF_SPEED,    // Distance from the previous report needs far more than the reported SOG
+    SPOOF_COURSE,   // Direction travelled disagrees with the reported COG/heading
+    SPOOF_REASON_COUNT
+} SpoofReason;
+
+static const char *const SPOOF_REASON_NAMES[SPOOF_REASON_COUNT] = {
+    "speed",
+    "course"
+};
+
+// Kinematic plausibility check of consecutive position reports of one vessel
+typedef struct {
+    FILE *out;                             // Alert CSV, NULL to only count
+    uint64_t checked;                      // Reports scored against a previous one
+    uint64_t alerts;                       // Reports with at least one reason
+    uint64_t reasons[SPOOF_REASON_COUNT];
+} SpoofDetector;
+
+#define SPOOF_ALERT_HEADER "seq,received_ms,mmsi,msg_type,reasons,score,distance_m,elapsed_s,implied_knots,allowed_knots,track_deg,cog_deg,heading,prev_longitude,prev_latitude,longitude,latitude"
+
+#define EARTH_RADIUS_M 6371008.8
+#define METRES_PER_SECOND_PER_KNOT 0.514444
+#define AIS_UNITS_TO_RADIANS (M_PI / (180.0 * 600000.0))  // 1/10000 minute -> radians
+
+// Types whose positions are precise and frequent enough to compare (Class A and B reports)
+static int is_kinematic_type(int msg_type) {
+    return (msg_type >= 1 && msg_type <= 3) || msg_type == 18 || msg_type == 19;
+}
+
+// Great-circle distance in metres between two AIS positions, with the track bearing in degrees.
+// Equirectangular projection for the usual short hop; haversine for long hops, high latitudes
+// and the antimeridian, where the flat approximation drifts
+static double kinematic_distance(int32_t lon1, int32_t lat1, int32_t lon2, int32_t lat2, double *bearing) {
+    double phi1 = lat1 * AIS_UNITS_TO_RADIANS;
+    double phi2 = lat2 * AIS_UNITS_TO_RADIANS;
+    double dphi = phi2 - phi1;
+    double dlambda = (double)(lon2 - lon1) * AIS_UNITS_TO_RADIANS;
+
+    if (fabs(dlambda) > M_PI) {
+        dlambda -= dlambda > 0 ? 2 * M_PI : -2 * M_PI;
+    }
+    double x = dlambda * cos(0.5 * (phi1 + phi2));
+    *bearing = fmod(atan2(x, dphi) * (180.0 / M_PI) + 360.0, 360.0);
+
+    if (fabs(dphi) < SPOOF_FLAT_MAX_RADIANS && fabs(dlambda) < SPOOF_FLAT_MAX_RADIANS &&
+        fabs(phi1) < SPOOF_FLAT_MAX_LATITUDE) {
+        return EARTH_RADIUS_M * sqrt(x * x + dphi * dphi);
+    }
+    double a = sin(0.5 * dphi) * sin(0.5 * dphi) +
+               cos(phi1) * cos(phi2) * sin(0.5 * dlambda) * sin(0.5 * dlambda);
+    return 2.0 * EARTH_RADIUS_M * asin(sqrt(a < 1.0 ? a : 1.0));
+}
+
+// Smallest difference between two bearings in degrees (0-180)
+static double bearing_difference(double a, double b) {
+    double d = fabs(a - b);
+    return d > 180.0 ? 360.0 - d : d;
+}
+
+static void put_degrees(FILE *out, int32_t raw) {
+    fprintf(out, ",%.6f", raw / 600000.0);
+}
+
+// Reason bits for one reading of the time between two reports; bearing is the direction of
+// travel from the earlier to the later report
+static unsigned spoof_reasons(const VesselState *prev, const VesselReport *report, double distance,
+                              double bearing, double elapsed, double *allowed_knots, double *score) {
+    // Allow the faster of the two reported speeds, with headroom for acceleration and noise
+    double sog_knots = SPOOF_UNKNOWN_SOG_KNOTS;
+    if (report->sog != AIS_SOG_NOT_AVAILABLE && prev->sog != AIS_SOG_NOT_AVAILABLE) {
+        sog_knots = (report->sog > prev->sog ? report->sog : prev->sog) / 10.0;
+    }
+    *allowed_knots = sog_knots * SPOOF_SPEED_FACTOR + SPOOF_SPEED_MARGIN_KNOTS;
+    double allowed = *allowed_knots * METRES_PER_SECOND_PER_KNOT * elapsed + SPOOF_DISTANCE_SLACK_M;
+
+    unsigned reasons = 0;
+    *score = distance / allowed;
+    if (distance > allowed) {
+        reasons |= 1u << SPOOF_SPEED;
+    }
+
+    // Only a clear move at speed has a meaningful direction; either end's COG may match
+    // (the vessel may have turned in between), falling back to heading without COG
+    if (distance >= SPOOF_COURSE_MIN_DISTANCE_M && sog_knots >= SPOOF_COURSE_MIN_SOG_KNOTS &&
+        sog_knots != SPOOF_UNKNOWN_SOG_KNOTS) {
+        double off = 360.0;
+        if (report->cog < AIS_COG_NOT_AVAILABLE) {
+            off = bearing_difference(bearing, report->cog / 10.0);
+        }
+        if (prev->cog < AIS_COG_NOT_AVAILABLE && bearing_difference(bearing, prev->cog / 10.0) < off) {
+            off = bearing_difference(bearing, prev->cog / 10.0);
+        }
+        if (off == 360.0 && report->heading != AIS_HEADING_NOT_AVAILABLE) {
+            off = bearing_difference(bearing, report->heading);
+        }
+        if (off != 360.0 && off > SPOOF_COURSE_TOLERANCE_DEG) {
+            reasons |= 1u << SPOOF_COURSE;
+        }
+    }
+    return reasons;
+}
+
+// Compare a position report with the vessel's previous one and write an alert row if the
+// move between them is implausible
+static void spoof_check(SpoofDetector *detector, const VesselState *prev, const VesselReport *report,
+                        uint64_t seq) {
+    if (!is_kinematic_type(report->msg_type) || !is_kinematic_type(prev->position_type) ||
+        !(report->flags & AIS_FLAG_LAT) || !(prev->flags & AIS_FLAG_LAT)) {
+        return;
+    }
+
+    // Elapsed time from receive times when the input has a clock, else from the UTC second
+    // fields, which only give the gap modulo a minute (the same second is a whole minute on,
+    // never no time at all)
+    double elapsed;
+    int clockless = 0;
+    if (report->received_ms != 0 && prev->position_ms != 0) {
+        elapsed = (double)(int64_t)(report->received_ms - prev->position_ms) / 1000.0;
+    } else if (report->utc_sec < 60 && prev->utc_sec < 60) {
+        elapsed = (double)((report->utc_sec - prev->utc_sec + 60) % 60);
+        if (elapsed == 0) {
+            elapsed = 60.0;
+        }
+        clockless = 1;
+    } else {
+        return;
+    }
+    if (elapsed < 0) {
+        return;
+    }
+    detector->checked++;
+
+    double bearing;
+    double allowed_knots;
+    double score;
+    double distance = kinematic_distance(prev->lon, prev->lat, report->lon, report->lat, &bearing);
+    unsigned reasons = spoof_reasons(prev, report, distance, bearing, elapsed, &allowed_knots, &score);
+
+    // Without a clock the gap may also be a minute longer than the seconds fields say, and
+    // merged feeds deliver some reports late: the report may be 60 - elapsed seconds older
+    // than the previous one, travelling backwards along the track
+    if (reasons != 0 && clockless) {
+        double other_knots;
+        double other_score;
+        if (spoof_reasons(prev, report, distance, bearing, elapsed + 60.0, &other_knots, &other_score) == 0) {
+            return;
+        }
+        if (elapsed < 60.0 && spoof_reasons(prev, report, distance, fmod(bearing + 180.0, 360.0), 60.0 - elapsed,
+                                            &other_knots, &other_score) == 0) {
+            return;
+        }
+    }
+
+    if (reasons == 0) {
+        return;
+    }
+    detector->alerts++;
+    for (int i = 0; i < SPOOF_REASON_COUNT; i++) {
+        if (reasons & (1u << i)) {
+            detector->reasons[i]++;
+        }
+    }
+    if (detector->out == NULL) {
+        return;
+    }
+
+    FILE *out = detector->out;
+    fprintf(out, "%llu,%llu,%u,%u,", (unsigned long long)seq, (unsigned long long)report->received_ms,
+            report->mmsi, report->msg_type);
+    const char *separator = "";
+    for (int i = 0; i < SPOOF_REASON_COUNT; i++) {
+        if (reasons & (1u << i)) {
+            fprintf(out, "%s%s", separator, SPOOF_REASON_NAMES[i]);
+            separator = "|";
+        }
+    }
+    fprintf(out, ",%.2f,%.0f,%.1f,%.1f,%.1f,%.0f,", score, distance, elapsed,
+            elapsed > 0 ? distance / elapsed / METRES_PER_SECOND_PER_KNOT : 0.0, allowed_knots, bearing);
+    if (report->cog < AIS_COG_NOT_AVAILABLE) {
+        fprintf(out, "%.1f", report->cog / 10.0);
+    }
+    fprintf(out, ",");
+    if (report->heading != AIS_HEADING_NOT_AVAILABLE) {
+        fprintf(out, "%u", report->heading);
+    }
+    put_degrees(out, prev->lon);
+    put_degrees(out, prev->lat);
+    put_degrees(out, report->lon);
+    put_degrees(out, report->lat);
+    fputc('\n', out);
+}
+
+// Fold one decoded message into its vessel's state; returns the state, or NULL if not tracked.
+// With a detector, position reports are first scored against the previous state
+VesselState *vessel_table_update(VesselTable *table, const VesselReport *data, SpoofDetector *detector) {
+    if (!data->duplicate) {
+        table->updates++; // Counts every message written, so it is the message's row in the output
+    }
+    if (data->mmsi == 0) {
+        return NULL;
+    }
+    VesselState *v = mmsi_index_add(&table->index, data->mmsi);
+    if (v == NULL) {
+        return NULL;
+    }
+
+    if (data->channel == 'A') {
+        v->channel_a++;
+    } else if (data->channel == 'B') {
+        v->channel_b++;
+    }
+    if (data->duplicate) {
+        return v;
+    }
+
+    v->msg_type = data->msg_type;
+    v->messages++;
+    v->last_seen_ms = data->received_ms;
+
+    if (data->flags & AIS_FLAG_LON) {
+        if (detector != NULL && v->position_reports > 0) {
+            spoof_check(detector, v, data, table->updates);
+        }
+        v->lon = data->lon;
+        v->lat = data->lat;
+        v->sog = data->sog;
+        v->cog = data->cog;
+        v->heading = data->heading;
+        v->utc_sec = data->utc_sec;
+        v->flags = data->flags;
+        v->position_type = data->msg_type;
+        v->position_reports++;
+        v->position_ms = data->received_ms;
+        v->position_seq = table->updates;
+    }
+    return v;
+}
+
+void print_spoof_summary(FILE *out, const SpoofDetector *detector) {
+    fprintf(out, "\nSpoofing checks:\n");
+    fprintf(out, "  Position reports checked: %llu\n", (unsigned long long)detector->checked);
+    fprintf(out, "  Alerts: %llu\n", (unsigned long long)detector->alerts);
+    for (int i = 0; i < SPOOF_REASON_COUNT; i++) {
+        fprintf(out, "    %s: %llu\n", SPOOF_REASON_NAMES[i], (unsigned long long)detector->reasons[i]);
+    }
+}
+
+/*
+ * Static and voyage data cache (--enrich)
+ *
+ * Types 5, 19 and 24 name the vessel, types 1-3, 18 and 27 only say where it is. The cache
+ * keeps the latest static fields per MMSI (text interned once in a string dictionary, so a
+ * row is 32 bytes of ids and numbers) and fills them into the empty fields of each later
+ * report from that vessel. A message only overwrites the fields it carries, which is how
+ * the name from type 24 part A and the call sign, type and size from part B end up
+ * together. Enriching a record is one probe and a few copies; only a new vessel or a new
+ * string allocates, and then only when a table doubles.
+ */
+typedef struct {
+    uint32_t mmsi;             // Set by the index when the row is added
+    uint32_t imo;
+    uint32_t ship_name;        // String ids, 0 = not known yet
+    uint32_t callsign;
+    uint32_t destination;
+    uint16_t dim_a;
+    uint16_t dim_b;
+    uint8_t dim_c;
+    uint8_t dim_d;
+    uint8_t ship_type;
+    uint8_t draught;
+    uint32_t messages;         // Static messages merged into this row
+} StaticData;
+
+// Fails to compile if StaticData is not two to a cache line
+typedef char static_data_size_check[sizeof(StaticData) == VESSEL_STATE_BYTES / 2 ? 1 : -1];
+
+typedef struct {
+    MmsiIndex index;           // StaticData rows
+    StringDictionary strings;
+    uint64_t merged;           // Static messages merged
+    uint64_t enriched;         // Records that got at least one field from the cache
+} StaticCache;
+
+// Messages the cache learns from, and messages it fills in
+#define STATIC_SOURCE_TYPES ((1u << 5) | (1u << 19) | (1u << 24))
+#define STATIC_ENRICH_TYPES ((1u << 1) | (1u << 2) | (1u << 3) | (1u << 18) | (1u << 19) | (1u << 24) | (1u << 27))
+
+// slots must be a power of two; returns 0 if out of memory
+int static_cache_init(StaticCache *cache, uint32_t slots) {
+    memset(cache, 0, sizeof(*cache));
+    if (!mmsi_index_init(&cache->index, slots, sizeof(StaticData)) || !string_dictionary_init(&cache->strings)) {
+        mmsi_index_free(&cache->index);
+        string_dictionary_free(&cache->strings);
+        return 0;
+    }
+    return 1;
+}
+
+void static_cache_free(StaticCache *cache) {
+    mmsi_index_free(&cache->index);
+    string_dictionary_free(&cache->strings);
+}
+
+// Interned id of a non-empty text field, or the old id if it is empty or cannot be stored
+static uint32_t static_cache_text(StaticCache *cache, const char *text, uint32_t old) {
+    if (text[0] == '\0') {
+        return old;
+    }
+    uint32_t id = string_dictionary_intern(&cache->strings, text);
+    return id == UINT32_MAX ? old : id;
+}
+
+// Copy interned string id into a record's text field of size bytes
+static void static_cache_copy_text(const StaticCache *cache, uint32_t id, char *out, size_t size) {
+    uint32_t start = string_dictionary_start(&cache->strings, id);
+    size_t len = cache->strings.ends[id] - start;
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(out, cache->strings.bytes + start, len);
+    out[len] = '\0';
+}
+
+// Merge the static fields a message carries into its vessel's entry
+void static_cache_update(StaticCache *cache, const AISData *data) {
+    if (data->mmsi == 0) {
+        return;
+    }
+    StaticData *s = mmsi_index_add(&cache->index, data->mmsi);
+    if (s == NULL) {
+        return;
+    }
+    s->ship_name = static_cache_text(cache, data->ship_name, s->ship_name);
+    s->callsign = static_cache_text(cache, data->callsign, s->callsign);
+    s->destination = static_cache_text(cache, data->destination, s->destination);
+    if (data->ship_type != 0) {
+        s->ship_type = data->ship_type;
+    }
+    if (data->imo != 0) {
+        s->imo = data->imo;
+    }
+    if (data->draught != 0) {
+        s->draught = data->draught;
+    }
+    if (data->dim_a != 0 || data->dim_b != 0 || data->dim_c != 0 || data->dim_d != 0) {
+        s->dim_a = data->dim_a;
+        s->dim_b = data->dim_b;
+        s->dim_c = data->dim_c;
+        s->dim_d = data->dim_d;
+    }
+    s->messages++;
+    cache->merged++;
+}
+
+// Fill the empty static fields of a record from its vessel's entry; returns 1 if any was filled
+int static_cache_enrich(StaticCache *cache, AISData *data) {
+    const StaticData *s = mmsi_index_find(&cache->index, data->mmsi);
+    int filled = 0;
+
+    if (s == NULL) {
+        return 0;
+    }
+    if (data->ship_name[0] == '\0' && s->ship_name != 0) {
+        static_cache_copy_text(cache, s->ship_name, data->ship_name, sizeof(data->ship_name));
+        filled = 1;
+    }
+    if (data->callsign[0] == '\0' && s->callsign != 0) {
+        static_cache_copy_text(cache, s->callsign, data->callsign, sizeof(data->callsign));
+        filled = 1;
+    }
+    if (data->destination[0] == '\0' && s->destination != 0) {
+        static_cache_copy_text(cache, s->destination, data->destination, sizeof(data->destination));
+        filled = 1;
+    }
+    if (data->ship_type == 0 && s->ship_type != 0) {
+        data->ship_type = s->ship_type;
+        filled = 1;
+    }
+    if (data->imo == 0 && s->imo != 0) {
+        data->imo = s->imo;
+        filled = 1;
+    }
+    if (data->draught == 0 && s->draught != 0) {
+        data->draught = s->draught;
+        filled = 1;
+    }
+    if (data->dim_a == 0 && data->dim_b == 0 && data->dim_c == 0 && data->dim_d == 0 &&
+        (s->dim_a != 0 || s->dim_b != 0 || s->dim_c != 0 || s->dim_d != 0)) {
+        data->dim_a = s->dim_a;
+        data->dim_b = s->dim_b;
+        data->dim_c = s->dim_c;
+        data->dim_d = s->dim_d;
+        filled = 1;
+    }
+    cache->enriched += (uint64_t)filled;
+    return filled;
+}
+
+// Learn from a static message, then fill in what the record lacks (which merges type 24's halves)
+void static_cache_apply(StaticCache *cache, AISData *data) {
+    if (data->msg_type >= 32) {
+        return;
+    }
+    if ((STATIC_SOURCE_TYPES >> data->msg_type) & 1) {
+        static_cache_update(cache, data);
+    }
+    if ((STATIC_ENRICH_TYPES >> data->msg_type) & 1) {
+        static_cache_enrich(cache, data);
+    }
+}
+
+void print_static_summary(FILE *out, const StaticCache *cache) {
+    fprintf(out, "\nStatic data cache:\n");
+    fprintf(out, "  Vessels with static data: %u\n", cache->index.count);
+    fprintf(out, "  Static messages merged: %llu\n", (unsigned long long)cache->merged);
+    fprintf(out, "  Distinct names, call signs and destinations: %u\n", cache->strings.count - 1);
+    fprintf(out, "  Records enriched: %llu\n", (unsigned long long)cache->enriched);
+}
+
+/*
+ * Track store (--tracks)
+ *
+ * Every position report of every vessel, kept in memory for forensics. A track is a list
+ * of fixed-size blocks: the block header holds its first point in full and the time range
+ * it covers, and each later point is stored as zigzag varint differences from the point
+ * before it (receive time, lon, lat, SOG, COG), about 6 bytes a point against several
+ * hundred for an AISData. Blocks are carved out of 1 MB pool allocations and live as long
+ * as the store, so appending a point is a few byte writes plus, once a block is full,
+ * taking the next block from the pool.
+ *
+ * Reading goes through a TrackCursor, which decodes a vessel's points in append order,
+ * optionally limited to a receive time range. While a track's times never go backwards
+ * (one receiver, or a merged feed in time order) the cursor binary-searches the block
+ * headers for the first block that reaches the start of the range and stops at the first
+ * block that begins after its end; otherwise it checks every block header's time range.
+ */
+typedef struct {
+    uint64_t first_ms;         // First point, stored in full
+    uint64_t min_ms;           // Time range of the block's points
+    uint64_t max_ms;
+    int32_t lon;
+    int32_t lat;
+    uint16_t sog;
+    uint16_t cog;
+    uint16_t points;
+    uint16_t used;             // Bytes of deltas
+    uint8_t deltas[TRACK_BLOCK_BYTES - 40];
+} TrackBlock;
+
+// Fails to compile if TrackBlock does not fill its fixed size exactly
+typedef char track_block_size_check[sizeof(TrackBlock) == TRACK_BLOCK_BYTES ? 1 : -1];
+
+typedef struct {
+    uint32_t mmsi;             // Set by the index when the row is added
+    uint32_t block_count;
+    uint32_t block_cap;
+    int unordered;             // A point was older than the one before it
+    TrackBlock **blocks;       // Oldest first
+    uint64_t points;
+    uint64_t last_ms;          // Last point, the base of the next delta
+    int32_t lon;
+    int32_t lat;
+    uint16_t sog;
+    uint16_t cog;
+} TrackVessel;
+
+typedef struct {
+    MmsiIndex index;           // TrackVessel rows
+    TrackBlock **pools;        // TRACK_POOL_BLOCKS blocks each
+    uint32_t pool_count;
+    uint32_t pool_cap;
+    uint32_t pool_used;        // Blocks handed out of the newest pool
+    uint64_t blocks;
+    uint64_t points;
+    uint64_t dropped;          // Points lost to a full table or a failed allocation
+} TrackStore;
+
+// One decoded point; position and speed in AISData units
+typedef struct {
+    uint64_t time_ms;
+    int32_t lon;
+    int32_t lat;
+    uint16_t sog;
+    uint16_t cog;
+} TrackPoint;
+
+typedef struct {
+    const TrackVessel *vessel;
+    uint64_t from_ms;          // Inclusive receive time range
+    uint64_t to_ms;
+    uint32_t block;            // Next block to open
+    uint32_t left;             // Points still to decode in the open block
+    const uint8_t *next;       // Next delta in the open block
+    TrackPoint point;          // Last point decoded
+} TrackCursor;
+
+// slots must be a power of two; returns 0 if out of memory
+int track_store_init(TrackStore *store, uint32_t slots) {
+    memset(store, 0, sizeof(*store));
+    if (!mmsi_index_init(&store->index, slots, sizeof(TrackVessel))) {
+        return 0;
+    }
+    store->pool_used = TRACK_POOL_BLOCKS;  // The first block allocates the first pool
+    return 1;
+}
+
+void track_store_free(TrackStore *store) {
+    for (uint32_t i = 0; i < store->index.count; i++) {
+        free(((TrackVessel *)mmsi_index_row(&store->index, i))->blocks);
+    }
+    for (uint32_t i = 0; i < store->pool_count; i++) {
+        free(store->pools[i]);
+    }
+    free(store->pools);
+    mmsi_index_free(&store->index);
+    store->pools = NULL;
+}
+
+// Append a fresh block to v's list, taken from the newest pool; NULL if out of memory
+static TrackBlock *track_store_new_block(TrackStore *store, TrackVessel *v) {
+    if (v->block_count == v->block_cap) {
+        uint32_t cap = v->block_cap ? v->block_cap * 2 : 4;
+        TrackBlock **blocks = realloc(v->blocks, cap * sizeof(TrackBlock *));
+        if (blocks == NULL) {
+            return NULL;
+        }
+        v->blocks = blocks;
+        v->block_cap = cap;
+    }
+    if (store->pool_used == TRACK_POOL_BLOCKS) {
+        if (store->pool_count == store->pool_cap) {
+            uint32_t cap = store->pool_cap ? store->pool_cap * 2 : 64;
+            TrackBlock **pools = realloc(store->pools, cap * sizeof(TrackBlock *));
+            if (pools == NULL) {
+                return NULL;
+            }
+            store->pools = pools;
+            store->pool_cap = cap;
+        }
+        TrackBlock *pool = malloc((size_t)TRACK_POOL_BLOCKS * sizeof(TrackBlock));
+        if (pool == NULL) {
+            return NULL;
+        }
+        store->pools[store->pool_count++] = pool;
+        store->pool_used = 0;
+    }
+    TrackBlock *block = &store->pools[store->pool_count - 1][store->pool_used++];
+    v->blocks[v->block_count++] = block;
+    store->blocks++;
+    return block;
+}
+
+static uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+// Tag block times are whole seconds, so a time delta that is one is stored in seconds
+// (low bit 0) and takes a byte up to a minute; others are milliseconds (low bit 1)
+static uint64_t encode_time_delta(int64_t delta_ms) {
+    if (delta_ms % 1000 == 0) {
+        return zigzag_encode(delta_ms / 1000) << 1;
+    }
+    return (zigzag_encode(delta_ms) << 1) | 1;
+}
+
+static int64_t decode_time_delta(uint64_t code) {
+    return (code & 1) ? zigzag_decode(code >> 1) : zigzag_decode(code >> 1) * 1000;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t value) {
+    while (value >= 0x80) {
+        *p++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    *p++ = (uint8_t)value;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, uint64_t *value) {
+    uint64_t v = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        v |= (uint64_t)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *value = v | ((uint64_t)*p++ << shift);
+    return p;
+}
+
+// Add a position report to its vessel's track; anything else is ignored
+void track_store_append(TrackStore *store, const VesselReport *report) {
+    if (report->duplicate || report->mmsi == 0 || !(report->flags & AIS_FLAG_LON)) {
+        return;
+    }
+    TrackVessel *v = mmsi_index_add(&store->index, report->mmsi);
+    if (v == NULL) {
+        store->dropped++;
+        return;
+    }
+
+    // Encode against the previous point, then start a new block if it does not fit
+    TrackBlock *block = v->block_count > 0 ? v->blocks[v->block_count - 1] : NULL;
+    uint8_t encoded[TRACK_POINT_MAX_BYTES];
+    uint8_t *end = encoded;
+    if (block != NULL) {
+        end = put_varint(end, encode_time_delta((int64_t)(report->received_ms - v->last_ms)));
+        end = put_varint(end, zigzag_encode((int64_t)report->lon - v->lon));
+        end = put_varint(end, zigzag_encode((int64_t)report->lat - v->lat));
+        end = put_varint(end, zigzag_encode((int64_t)report->sog - v->sog));
+        end = put_varint(end, zigzag_encode((int64_t)report->cog - v->cog));
+    }
+    size_t length = (size_t)(end - encoded);
+    if (block == NULL || block->points == UINT16_MAX || block->used + length > sizeof(block->deltas)) {
+        block = track_store_new_block(store, v);
+        if (block == NULL) {
+            store->dropped++;
+            return;
+        }
+        block->first_ms = report->received_ms;
+        block->min_ms = report->received_ms;
+        block->max_ms = report->received_ms;
+        block->lon = report->lon;
+        block->lat = report->lat;
+        block->sog = report->sog;
+        block->cog = report->cog;
+        block->points = 1;
+        block->used = 0;
+    } else {
+        memcpy(block->deltas + block->used, encoded, length);
+        block->used = (uint16_t)(block->used + length);
+        block->points++;
+        if (report->received_ms < block->min_ms) {
+            block->min_ms = report->received_ms;
+        }
+        if (report->received_ms > block->max_ms) {
+            block->max_ms = report->received_ms;
+        }
+    }
+    if (v->points > 0 && report->received_ms < v->last_ms) {
+        v->unordered = 1;
+    }
+    v->last_ms = report->received_ms;
+    v->lon = report->lon;
+    v->lat = report->lat;
+    v->sog = report->sog;
+    v->cog = report->cog;
+    v->points++;
+    store->points++;
+}
+
+// Start reading mmsi's points received in [from_ms, to_ms]; returns 0 if it has no track
+int track_cursor_init(TrackCursor *cursor, const TrackStore *store, uint32_t mmsi, uint64_t from_ms,
+                      uint64_t to_ms) {
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->vessel = mmsi_index_find(&store->index, mmsi);
+    cursor->from_ms = from_ms;
+    cursor->to_ms = to_ms;
+    if (cursor->vessel == NULL) {
+        return 0;
+    }
+
+    // In time order, skip the blocks that end before the range starts
+    const TrackVessel *v = cursor->vessel;
+    if (!v->unordered) {
+        uint32_t lo = 0;
+        uint32_t hi = v->block_count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (v->blocks[mid]->max_ms < from_ms) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        cursor->block = lo;
+    }
+    return 1;
+}
+
+// Next point of the cursor's range; returns 0 when there are no more
+int track_cursor_next(TrackCursor *cursor, TrackPoint *point) {
+    const TrackVessel *v = cursor->vessel;
+    if (v == NULL) {
+        return 0;
+    }
+    for (;;) {
+        TrackPoint *p = &cursor->point;
+        if (cursor->left > 0) {
+            uint64_t delta;
+            cursor->next = get_varint(cursor->next, &delta);
+            p->time_ms += (uint64_t)decode_time_delta(delta);
+            cursor->next = get_varint(cursor->next, &delta);
+            p->lon = (int32_t)(p->lon + zigzag_decode(delta));
+            cursor->next = get_varint(cursor->next, &delta);
+            p->lat = (int32_t)(p->lat + zigzag_decode(delta));
+            cursor->next = get_varint(cursor->next, &delta);
+            p->sog = (uint16_t)(p->sog + zigzag_decode(delta));
+            cursor->next = get_varint(cursor->next, &delta);
+            p->cog = (uint16_t)(p->cog + zigzag_decode(delta));
+            cursor->left--;
+        } else {
+            // Open the next block whose time range overlaps the cursor's
+            const TrackBlock *block = NULL;
+            while (cursor->block < v->block_count) {
+                const TrackBlock *b = v->blocks[cursor->block++];
+                if (!v->unordered && b->min_ms > cursor->to_ms) {
+                    cursor->block = v->block_count;
+                    break;
+                }
+                if (b->max_ms >= cursor->from_ms && b->min_ms <= cursor->to_ms) {
+                    block = b;
+                    break;
+                }
+            }
+            if (block == NULL) {
+                cursor->vessel = NULL;
+                return 0;
+            }
+            p->time_ms = block->first_ms;
+            p->lon = block->lon;
+            p->lat = block->lat;
+            p->sog = block->sog;
+            p->cog = block->cog;
+            cursor->next = block->deltas;
+            cursor->left = (uint32_t)block->points - 1;
+        }
+        if (p->time_ms >= cursor->from_ms && p->time_ms <= cursor->to_ms) {
+            *point = *p;
+            return 1;
+        }
+    }
+}
+
+static int compare_mmsi(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Write the tracks as CSV, vessel by vessel in MMSI order, each in append order;
+// returns 0 if the file cannot be written
+int write_track_file(const char *filename, const TrackStore *store, uint64_t from_ms, uint64_t to_ms) {
+    FILE *out = fopen(filename, "w");
+    uint32_t *mmsis = malloc(((size_t)store->index.count + 1) * sizeof(uint32_t));
+    uint32_t n = 0;
+
+    if (out == NULL || mmsis == NULL) {
+        if (out != NULL) {
+            fclose(out);
+        }
+        free(mmsis);
+        return 0;
+    }
+    for (uint32_t i = 0; i < store->index.count; i++) {
+        mmsis[n++] = ((const TrackVessel *)mmsi_index_row(&store->index, i))->mmsi;
+    }
+    qsort(mmsis, n, sizeof(uint32_t), compare_mmsi);
+
+    fprintf(out, "mmsi,receive_time,longitude,latitude,speed_over_ground,course_over_ground\n");
+    for (uint32_t i = 0; i < n; i++) {
+        TrackCursor cursor;
+        TrackPoint point;
+        track_cursor_init(&cursor, store, mmsis[i], from_ms, to_ms);
+        while (track_cursor_next(&cursor, &point)) {
+            fprintf(out, "%u,%llu.%03u,%.7f,%.7f,%.1f,%.1f\n", mmsis[i],
+                    (unsigned long long)(point.time_ms / 1000), (unsigned)(point.time_ms % 1000),
+                    point.lon / 600000.0, point.lat / 600000.0, point.sog / 10.0, point.cog / 10.0);
+        }
+    }
+    free(mmsis);
+    int ok = !ferror(out);
+    return fclose(out) == 0 && ok;
+}
+
+void print_track_summary(FILE *out, const TrackStore *store) {
+    double bytes = (double)store->pool_count * TRACK_POOL_BLOCKS * sizeof(TrackBlock);
+    for (uint32_t i = 0; i < store->index.count; i++) {
+        bytes += (double)((const TrackVessel *)mmsi_index_row(&store->index, i))->block_cap * sizeof(TrackBlock *);
+    }
+    bytes += (store->index.mask + 1.0) * sizeof(MmsiSlot) + (double)store->index.capacity * sizeof(TrackVessel);
+    fprintf(out, "\nTrack store:\n");
+    fprintf(out, "  Vessels: %u, points: %llu\n", store->index.count, (unsigned long long)store->points);
+    fprintf(out, "  Blocks: %llu of %d bytes (%.1f MB in all)\n", (unsigned long long)store->blocks,
+            TRACK_BLOCK_BYTES, bytes / (1024.0 * 1024.0));
+    if (store->points > 0) {
+        fprintf(out, "  Bytes per point: %.2f\n", bytes / (double)store->points);
+    }
+    if (store->dropped > 0) {
+        fprintf(out, "  Points dropped (table full or out of memory): %llu\n",
+                (unsigned long long)store->dropped);
+    }
+}
+
+/*
+ * Track simplification (--simplify)
+ *
+ * An opening window per vessel, in one pass: the anchor is the last point written and the
+ * window holds the points received since. A new point is accepted into the window if every
+ * point already there lies within the tolerance of the segment from the anchor to the new
+ * point; when one does not (or the window is full), the newest window point is written and
+ * becomes the anchor. Distance is the synchronised Euclidean distance, from each point to
+ * where the segment puts the vessel at that point's receive time, so a dropped point is
+ * within the tolerance of the written track in time as well as in space (the plain
+ * point-to-segment distance is used when the segment has no duration, as in files without
+ * tag blocks). A vessel's first point is written at once and its last at the end.
+ *
+ * Each vessel costs one window of SIMPLIFY_WINDOW_POINTS points plus the record waiting
+ * to be written, and each report one distance check per window point.
+ */
+typedef struct {
+    uint64_t time_ms;
+    int32_t lon;
+    int32_t lat;
+} SimplifyPoint;
+
+typedef struct {
+    uint32_t mmsi;                                // Set by the index when the row is added
+    uint32_t count;
+    uint64_t written;                             // Points written, 0 for a new row
+    SimplifyPoint anchor;                         // Last point written
+    SimplifyPoint window[SIMPLIFY_WINDOW_POINTS]; // Points since the anchor, oldest first
+    AISData pending;                              // Record of the newest window point
+} SimplifyTrack;
+
+typedef struct {
+    MmsiIndex index;           // SimplifyTrack rows
+    double tolerance_m;
+    uint64_t points;           // Position reports seen
+    uint64_t written;
+    uint64_t dropped;          // Reports of vessels that could not be tracked
+} Simplifier;
+
+// slots must be a power of two; returns 0 if out of memory
+int simplifier_init(Simplifier *simplifier, uint32_t slots, double tolerance_m) {
+    memset(simplifier, 0, sizeof(*simplifier));
+    simplifier->tolerance_m = tolerance_m;
+    return mmsi_index_init(&simplifier->index, slots, sizeof(SimplifyTrack));
+}
+
+void simplifier_free(Simplifier *simplifier) {
+    mmsi_index_free(&simplifier->index);
+}
+
+// Does every window point lie within the tolerance of the segment from the anchor to end?
+// Works in metres on a plane tangent at the anchor, which is exact enough for a window
+static int simplify_window_fits(const Simplifier *simplifier, const SimplifyTrack *t, const SimplifyPoint *end) {
+    const SimplifyPoint *a = &t->anchor;
+    double x_scale = EARTH_RADIUS_M * AIS_UNITS_TO_RADIANS * cos(a->lat * AIS_UNITS_TO_RADIANS);
+    double y_scale = EARTH_RADIUS_M * AIS_UNITS_TO_RADIANS;
+    double limit = simplifier->tolerance_m * simplifier->tolerance_m;
+
+    // Longitude differences are wrapped so a track may cross the antimeridian
+    int64_t dlon = (int64_t)end->lon - a->lon;
+    if (dlon > 108000000) {
+        dlon -= 216000000;
+    } else if (dlon < -108000000) {
+        dlon += 216000000;
+    }
+    double ex = (double)dlon * x_scale;
+    double ey = (double)((int64_t)end->lat - a->lat) * y_scale;
+    double duration = (double)(int64_t)(end->time_ms - a->time_ms);
+    double length = ex * ex + ey * ey;
+
+    for (uint32_t i = 0; i < t->count; i++) {
+        const SimplifyPoint *p = &t->window[i];
+        dlon = (int64_t)p->lon - a->lon;
+        if (dlon > 108000000) {
+            dlon -= 216000000;
+        } else if (dlon < -108000000) {
+            dlon += 216000000;
+        }
+        double px = (double)dlon * x_scale;
+        double py = (double)((int64_t)p->lat - a->lat) * y_scale;
+        double f;
+        if (duration > 0) {
+            f = (double)(int64_t)(p->time_ms - a->time_ms) / duration;
+        } else {
+            f = length > 0 ? (px * ex + py * ey) / length : 0.0;
+        }
+        f = f < 0.0 ? 0.0 : (f > 1.0 ? 1.0 : f);
+        double dx = px - f * ex;
+        double dy = py - f * ey;
+        if (dx * dx + dy * dy > limit) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Feed one record; returns 1 with *out set to a record to write now, else 0.
+// Records without a usable position are not part of any track and are dropped
+int simplifier_push(Simplifier *simplifier, const AISData *data, AISData *out) {
+    if (data->mmsi == 0 || (data->flags & (AIS_FLAG_LON | AIS_FLAG_LAT)) != (AIS_FLAG_LON | AIS_FLAG_LAT) ||
+        data->lon == 181 * 600000 || data->lat == 91 * 600000) {
+        return 0;
+    }
+    simplifier->points++;
+    SimplifyTrack *t = mmsi_index_add(&simplifier->index, data->mmsi);
+    if (t == NULL) {
+        simplifier->dropped++;
+        return 0;
+    }
+
+    SimplifyPoint point = {data->received_ms, data->lon, data->lat};
+    if (t->written == 0) {
+        // First point of the vessel: written at once as the first anchor
+        t->anchor = point;
+        t->written++;
+        *out = *data;
+        simplifier->written++;
+        return 1;
+    }
+
+    if (t->count < SIMPLIFY_WINDOW_POINTS && simplify_window_fits(simplifier, t, &point)) {
+        t->window[t->count++] = point;
+        t->pending = *data;
+        return 0;
+    }
+
+    // The window breaks: its newest point is written and anchors a new window
+    *out = t->pending;
+    t->anchor = t->window[t->count - 1];
+    t->window[0] = point;
+    t->count = 1;
+    t->pending = *data;
+    t->written++;
+    simplifier->written++;
+    return 1;
+}
+
+// Take the record still waiting in row i (a track's last point); returns 0 if there is none
+int simplifier_take_pending(Simplifier *simplifier, uint32_t i, AISData *out) {
+    SimplifyTrack *t = mmsi_index_row(&simplifier->index, i);
+    if (t->count == 0) {
+        return 0;
+    }
+    *out = t->pending;
+    t->anchor = t->window[t->count - 1];
+    t->count = 0;
+    t->written++;
+    simplifier->written++;
+    return 1;
+}
+
+void print_simplify_summary(FILE *out, const Simplifier *simplifier) {
+    fprintf(out, "\nTrack simplification (tolerance %.1f m):\n", simplifier->tolerance_m);
+    fprintf(out, "  Vessels: %u, position reports: %llu\n", simplifier->index.count,
+            (unsigned long long)simplifier->points);
+    fprintf(out, "  Points written: %llu", (unsigned long long)simplifier->written);
+    if (simplifier->written > 0) {
+        fprintf(out, " (1 in %.1f)", (double)simplifier->points / (double)simplifier->written);
+    }
+    fprintf(out, "\n");
+    if (simplifier->dropped > 0) {
+        fprintf(out, "  Reports dropped (table full or out of memory): %llu\n",
+                (unsigned long long)simplifier->dropped);
+    }
+}
+
+// What to do with sentences whose checksum is wrong or missing
+typedef enum {
+    CHECKSUM_DROP,   // Count and drop the sentence
+    CHECKSUM_COUNT,  // Count but still decode the sentence
+    CHECKSUM_OFF     // Do not verify checksums
+} ChecksumMode;
+
+// How process_ais_file reads its input
+typedef enum {
+    INPUT_STDIO,  // fgets into a line buffer
+    INPUT_MMAP    // Map the whole file and decode lines in place
+} InputMode;
+
+// What the streaming reader does when the decoder falls behind
+typedef enum {
+    OVERFLOW_DEFAULT,  // Block for stdin/TCP, drop for UDP
+    OVERFLOW_BLOCK,    // Stop reading until there is room (backpressure to the sender)
+    OVERFLOW_DROP      // Discard the line and count it
+} OverflowPolicy;
+
+// What the decoded records are written as
+typedef enum {
+    OUTPUT_CSV,       // One text line per message
+    OUTPUT_COLUMNAR   // Binary columnar archive, see columnar_writer_open
+} OutputFormat;
+
+// Run-time options for process_ais_file and run_stream
+typedef struct {
+    ChecksumMode checksum_mode;
+    InputMode input_mode;
+    int threads;  // Worker threads for batch decoding (1 = serial, 0 = one per CPU)
+    OverflowPolicy overflow;
+    OutputFormat output_format;
+    const char *alert_filename;  // Spoofing alert CSV (--alerts), NULL = detector off
+    int dedup;                   // Drop repeated copies of a message (--dedup)
+    int dedup_window;            // Lines (file) or seconds (stream); 0 = the default for the input
+    int memo;                    // Reuse decodes of repeated payloads (--memo)
+    const char *metrics_filename;  // Metrics snapshot (--metrics), NULL = instrumentation off
+    int metrics_interval;        // Seconds between snapshots
+    const MessageFilter *filter; // Messages to keep (--types, --mmsi, --bbox), NULL = all
+    const AISProjection *decode_projection;  // Fields decoded (--columns plus what tracking needs), NULL = all
+    const AISProjection *output_projection;  // Columns written (--columns), NULL = all
+    const char *checkpoint_filename;  // Follow-mode resume state (--checkpoint), NULL = none
+    int enrich;                  // Attach cached static data to position reports (--enrich)
+    int tracks;                  // Keep every vessel's track in memory (--tracks)
+    const char *track_filename;  // Where the tracks are written at the end, NULL = summary only
+    uint64_t track_from_ms;      // Receive time range written (--track-range)
+    uint64_t track_to_ms;
+    double simplify_tolerance;   // Metres (--simplify), 0 = write every record
+} DecoderOptions;
+
+void init_decoder_options(DecoderOptions *options) {
+    options->checksum_mode = CHECKSUM_DROP;
+    options->input_mode = INPUT_STDIO;
+    options->threads = 1;
+    options->overflow = OVERFLOW_DEFAULT;
+    options->output_format = OUTPUT_CSV;
+    options->alert_filename = NULL;
+    options->dedup = 0;
+    options->dedup_window = 0;
+    options->memo = 0;
+    options->metrics_filename = NULL;
+    options->metrics_interval = METRICS_EXPORT_SECONDS;
+    options->filter = NULL;
+    options->decode_projection = NULL;
+    options->output_projection = NULL;
+    options->checkpoint_filename = NULL;
+    options->enrich = 0;
+    options->tracks = 0;
+    options->track_filename = NULL;
+    options->track_from_ms = 0;
+    options->track_to_ms = UINT64_MAX;
+    options->simplify_tolerance = 0;
+}
+
+// Reasons a line is not decoded, reported in the summary
+typedef enum {
+    REJECT_BAD_CHECKSUM,
+    REJECT_MISSING_CHECKSUM,
+    REJECT_MALFORMED,
+    REJECT_INVALID_CHARS,
+    REJECT_INVALID_TYPE,
+    REJECT_TOO_SHORT,
+    REJECT_REASON_COUNT
+} RejectReason;
+
+static const char *const REJECT_REASON_NAMES[REJECT_REASON_COUNT] = {
+    "Bad checksum",
+    "Missing checksum",
+    "Malformed sentence",
+    "Invalid payload characters",
+    "Invalid/non-standard message type",
+    "Payload too short"
+};
+
+// Label values for the metrics export
+static const char *const REJECT_REASON_KEYS[REJECT_REASON_COUNT] = {
+    "bad_checksum",
+    "missing_checksum",
+    "malformed",
+    "invalid_chars",
+    "invalid_type",
+    "too_short"
+};
+
+// Stages of process_nmea_line, timed on sampled lines
+typedef enum {
+    STAGE_CHECKSUM,
+    STAGE_PARSE,     // Sentence split and fragment reassembly
+    STAGE_FILTER,    // --types, --mmsi and --bbox on the armoured payload
+    STAGE_DEDUP,
+    STAGE_DECODE,    // Memo lookup, de-armouring and field decoding
+    STAGE_TRACK,     // Vessel state and spoof checks (only buffering in parallel workers)
+    STAGE_OUTPUT,    // CSV formatting and writing, or the columnar append
+    STAGE_COUNT
+} MetricsStage;
+
+static const char *const STAGE_NAMES[STAGE_COUNT] = {
+    "checksum",
+    "parse",
+    "filter",
+    "dedup",
+    "decode",
+    "track",
+    "output"
+};
+
+// Log-linear histogram: exact below 4, then 4 buckets per power of two (within 25%)
+typedef struct {
+    uint64_t buckets[METRICS_HISTOGRAM_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+} Histogram;
+
+// Timings collected per decoding context, so per thread, and merged with the other counters
+typedef struct {
+    uint64_t stage_ticks[STAGE_COUNT];    // metrics_ticks() spent in each stage
+    uint64_t stage_samples[STAGE_COUNT];  // Sampled lines that reached the stage
+    Histogram line_ticks;                 // Whole-line latency of sampled lines
+    Histogram queue_depth;                // Stream mode: lines waiting at each decoder wake-up
+} DecodeMetrics;
+
+// Cheap timestamp in unspecified units; metrics_clock_ns_per_tick converts
+static inline uint64_t metrics_ticks(void) {
+#ifdef AIS_HAVE_X86_SIMD
+    return __rdtsc();
+#elif defined(_WIN32)
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (uint64_t)now.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// Monotonic nanoseconds, the reference metrics_ticks is calibrated against
+static uint64_t monotonic_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, frequency;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)now.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static int histogram_bucket(uint64_t value) {
+    if (value < (1u << METRICS_HISTOGRAM_SUB_BITS)) {
+        return (int)value;
+    }
+    int msb = 63;
+    while (!(value >> msb)) {
+        msb--;
+    }
+    int shift = msb - METRICS_HISTOGRAM_SUB_BITS;
+    return ((shift + 1) << METRICS_HISTOGRAM_SUB_BITS) +
+           (int)((value >> shift) & ((1u << METRICS_HISTOGRAM_SUB_BITS) - 1));
+}
+
+// Smallest value that falls in bucket b
+static uint64_t histogram_bucket_low(int b) {
+    int octave = b >> METRICS_HISTOGRAM_SUB_BITS;
+    uint64_t sub = (uint64_t)(b & ((1 << METRICS_HISTOGRAM_SUB_BITS) - 1));
+    if (octave == 0) {
+        return sub;
+    }
+    return ((1ull << METRICS_HISTOGRAM_SUB_BITS) + sub) << (octave - 1);
+}
+
+static inline void histogram_record(Histogram *h, uint64_t value) {
+    h->buckets[histogram_bucket(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+// Upper bound of the bucket holding the q-quantile (0-1), capped at the largest value seen
+static uint64_t histogram_quantile(const Histogram *h, double q) {
+    uint64_t rank = (uint64_t)ceil(q * (double)h->count);
+    uint64_t seen = 0;
+    if (rank == 0) {
+        rank = 1;
+    }
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS - 1; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank) {
+            uint64_t high = histogram_bucket_low(b + 1) - 1;
+            return high < h->max ? high : h->max;
+        }
+    }
+    return h->max;
+}
+
+static void merge_histogram(Histogram *into, const Histogram *from) {
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS; b++) {
+        into->buckets[b] += from->buckets[b];
+    }
+    into->count += from->count;
+    into->sum += from->sum;
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+}
+
+// Close the current stage of a sampled line and start the next one at the same tick
+static inline void metrics_stage(DecodeMetrics *metrics, MetricsStage stage, uint64_t *mark) {
+    uint64_t now = metrics_ticks();
+    metrics->stage_ticks[stage] += now - *mark;
+    metrics->stage_samples[stage]++;
+    *mark = now;
+}
+
+// mark is NULL unless the line is being timed
+#define METRICS_STAGE(stats, stage, mark) \
+    if ((mark) != NULL) { metrics_stage(&(stats)->metrics, stage, mark); }
+
+// Counters collected while decoding, printed in the final summary
+typedef struct {
+    uint64_t total_messages;
+    uint64_t decoded_messages;
+    uint64_t invalid_messages;
+    uint64_t message_types[28];   // Index 1-27 for message types
+    uint64_t invalid_types[256];  // Track invalid types
+    uint64_t messages_with_position;
+    uint64_t valid_without_position;
+    uint64_t rejects[REJECT_REASON_COUNT];
+    uint64_t checksum_failures_kept;
+    uint64_t duplicates;          // Copies dropped by --dedup
+    uint64_t filtered;            // Messages dropped by --types, --mmsi or --bbox
+    uint64_t memo_hits[28];       // Per message type, decodes served by the memo cache (--memo)
+    uint64_t memo_misses;
+    uint64_t dedup_early_rotations;  // Dedup generations rotated out full, before a whole window
+    DecodeMetrics metrics;        // Stage timings and histograms (--metrics)
+} DecodeStats;
+
+// Growable in-memory output used by batch workers: CSV text or fixed-size records
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;  // An append ran out of memory
+} OutputBuffer;
+
+// Make room for extra more bytes; returns 0 if out of memory
+static int output_buffer_reserve(OutputBuffer *buf, size_t extra) {
+    if (buf->len + extra > buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : 64 * 1024;
+        while (cap < buf->len + extra) {
+            cap *= 2;
+        }
+        char *data = realloc(buf->data, cap);
+        if (data == NULL) {
+            buf->failed = 1;
+            return 0;
+        }
+        buf->data = data;
+        buf->cap = cap;
+    }
+    return 1;
+}
+
+// Append text plus a newline; returns 0 if out of memory
+int output_buffer_append_line(OutputBuffer *buf, const char *text, size_t len) {
+    if (!output_buffer_reserve(buf, len + 1)) {
+        return 0;
+    }
+    memcpy(buf->data + buf->len, text, len);
+    buf->data[buf->len + len] = '\n';
+    buf->len += len + 1;
+    return 1;
+}
+
+// Append len raw bytes (a record); returns 0 if out of memory
+int output_buffer_append(OutputBuffer *buf, const void *data, size_t len) {
+    if (!output_buffer_reserve(buf, len)) {
+        return 0;
+    }
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    return 1;
+}
+
+// Writes metrics snapshots (--metrics), defined with the stream code it also reports on
+typedef struct MetricsExporter MetricsExporter;
+void metrics_exporter_tick(MetricsExporter *exporter, const DecodeStats *stats);
+
+// Compiling with -DAIS_NO_METRICS removes the timing branch from the per-line path
+#ifdef AIS_NO_METRICS
+#define METRICS_TIMING(ctx) 0
+#else
+#define METRICS_TIMING(ctx) ((ctx)->timing)
+#endif
+
+// State shared by every line of one decoding run
+typedef struct {
+    const DecoderOptions *options;
+    FILE *output_file;
+    ColumnarWriter *columnar;     // Set for OUTPUT_COLUMNAR
+    VesselTable *vessels;         // Per-MMSI state, NULL if not tracked
+    SpoofDetector *detector;      // Scores position reports as they reach vessels, or NULL
+    StaticCache *statics;         // Static data joined onto reports (--enrich), or NULL
+    TrackStore *tracks;           // Every position report by vessel (--tracks), or NULL
+    Simplifier *simplifier;       // Thins the written tracks (--simplify), or NULL
+    OutputBuffer *output_buffer;  // CSV text goes here instead of output_file when set
+    OutputBuffer *record_buffer;  // AISData for the writer thread (parallel chunks: columnar, --enrich, --simplify)
+    OutputBuffer *report_buffer;  // VesselReport for the writer thread's vessel table (parallel chunks)
+    FragmentTable *fragments;
+    DedupSet *dedup;              // Recently seen messages (--dedup), or NULL
+    MemoCache *memo;              // Decoded records of repeated payloads (--memo), or NULL
+    uint64_t line_clock;          // Non-empty lines seen, drives fragment timeouts
+    uint64_t clock_ms;            // Receive time stamped on decoded records, 0 if unknown
+    int warm_up;                  // Only feed fragments, no output (parallel chunk prologue)
+    int appending;                // Resumed follow run: output and alerts continue the existing files
+    int timing;                   // Time sampled lines into stats.metrics (--metrics)
+    int timing_countdown;         // Lines until the next sampled one
+    MetricsExporter *exporter;    // Writes snapshots every so many lines, or NULL
+    DecodeStats stats;
+} DecodeContext;
+
+// Add the counters of one run into another
+void merge_decode_stats(DecodeStats *into, const DecodeStats *from) {
+    into->total_messages += from->total_messages;
+    into->decoded_messages += from->decoded_messages;
+    into->invalid_messages += from->invalid_messages;
+    for (int i = 0; i < 28; i++) {
+        into->message_types[i] += from->message_types[i];
+    }
+    for (int i = 0; i < 256; i++) {
+        into->invalid_types[i] += from->invalid_types[i];
+    }
+    into->messages_with_position += from->messages_with_position;
+    into->valid_without_position += from->valid_without_position;
+    for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+        into->rejects[i] += from->rejects[i];
+    }
+    into->checksum_failures_kept += from->checksum_failures_kept;
+    into->duplicates += from->duplicates;
+    into->filtered += from->filtered;
+    for (int i = 0; i < 28; i++) {
+        into->memo_hits[i] += from->memo_hits[i];
+    }
+    into->memo_misses += from->memo_misses;
+    into->dedup_early_rotations += from->dedup_early_rotations;
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        into->metrics.stage_ticks[i] += from->metrics.stage_ticks[i];
+        into->metrics.stage_samples[i] += from->metrics.stage_samples[i];
+    }
+    merge_histogram(&into->metrics.line_ticks, &from->metrics.line_ticks);
+    merge_histogram(&into->metrics.queue_depth, &from->metrics.queue_depth);
+}
+
+void merge_fragment_stats(FragmentStats *into, const FragmentStats *from) {
+    into->fragments_received += from->fragments_received;
+    into->messages_completed += from->messages_completed;
+    into->orphaned_fragments += from->orphaned_fragments;
+    into->timed_out += from->timed_out;
+    into->evicted += from->evicted;
+    into->superseded += from->superseded;
+}
+
+// Open mode for the output file: the columnar archive must not go through text-mode newline translation
+static const char *output_file_mode(const DecoderOptions *options) {
+    return options->output_format == OUTPUT_COLUMNAR ? "wb" : "w";
+}
+
+// Write the start of the output (CSV header, or the columnar file header); returns 0 if out of memory
+int begin_decoder_output(DecodeContext *ctx, FILE *file) {
+    ctx->output_file = file;
+    if (ctx->options->output_format == OUTPUT_COLUMNAR) {
+        ctx->columnar = columnar_writer_open(file, ctx->options->output_projection);
+        return ctx->columnar != NULL;
+    }
+    // A resumed run adds to the CSV it wrote before, which already has its header
+    if (!ctx->appending || fseek(file, 0, SEEK_END) != 0 || ftell(file) <= 0) {
+        write_csv_header_projected(file, ctx->options->output_projection);
+    }
+    return 1;
+}
+
+// Finish the output (columnar footer); returns 0 if the archive could not be written
+int end_decoder_output(DecodeContext *ctx) {
+    if (ctx->columnar != NULL) {
+        int ok = columnar_writer_close(ctx->columnar);
+        ctx->columnar = NULL;
+        return ok;
+    }
+    return 1;
+}
+
+// Open the --alerts file and attach the detector to ctx; returns 0 if the file cannot be opened
+int start_spoof_detector(DecodeContext *ctx, SpoofDetector *detector) {
+    memset(detector, 0, sizeof(*detector));
+    if (ctx->options->alert_filename == NULL || ctx->vessels == NULL) {
+        return 1;
+    }
+    detector->out = fopen(ctx->options->alert_filename, ctx->appending ? "a" : "w");
+    if (detector->out == NULL) {
+        return 0;
+    }
+    if (!ctx->appending || fseek(detector->out, 0, SEEK_END) != 0 || ftell(detector->out) <= 0) {
+        fprintf(detector->out, "%s\n", SPOOF_ALERT_HEADER);
+    }
+    ctx->detector = detector;
+    return 1;
+}
+
+// Close the alert file; the counters stay for the summary
+void stop_spoof_detector(SpoofDetector *detector) {
+    if (detector->out != NULL) {
+        fclose(detector->out);
+        detector->out = NULL;
+    }
+}
+
+// Dedup window in lines of file input
+static int dedup_window_lines(const DecoderOptions *options) {
+    return options->dedup_window > 0 ? options->dedup_window : DEDUP_WINDOW_LINES;
+}
+
+// Dedup window in milliseconds of receive time (stream input)
+static uint64_t dedup_window_ms(const DecoderOptions *options) {
+    return (uint64_t)(options->dedup_window > 0 ? options->dedup_window : DEDUP_WINDOW_SECONDS) * 1000;
+}
+
+// Decode a reassembled payload, counting the reason if it is rejected; returns 0 if rejected
+static int decode_checked_payload(DecodeStats *stats, const AISProjection *projection, const char *payload,
+                                  int payload_len, AISData *data) {
+    switch (decode_ais_payload_projected(projection, payload, payload_len, data)) {
+    case AIS_STATUS_DECODED:
+        return 1;
+    case AIS_STATUS_INVALID_CHARS:
+        stats->rejects[REJECT_INVALID_CHARS]++;
+        return 0;
+    case AIS_STATUS_INVALID_TYPE:
+        // Skip message if type is non-standard/invalid (similar to Python logic)
+        stats->invalid_messages++;
+        stats->rejects[REJECT_INVALID_TYPE]++;
+        stats->invalid_types[data->msg_type]++;
+        return 0;
+    default:
+        stats->rejects[REJECT_TOO_SHORT]++;
+        return 0;
+    }
+}
+
+// Fold a report into the vessel table and the track store, both of which need input order
+static void apply_vessel_report(DecodeContext *ctx, const VesselReport *report) {
+    if (ctx->vessels != NULL) {
+        vessel_table_update(ctx->vessels, report, ctx->detector);
+    }
+    if (ctx->tracks != NULL) {
+        track_store_append(ctx->tracks, report);
+    }
+}
+
+// Write one record to the archive or the output file (not for parallel workers)
+static void write_record(DecodeContext *ctx, const AISData *data) {
+    if (ctx->columnar != NULL) {
+        columnar_writer_append(ctx->columnar, data);
+        return;
+    }
+    char csv_line[MAX_LINE_LENGTH * 3];
+    int csv_len = make_csv_line_projected(ctx->options->output_projection, data, csv_line);
+    csv_line[csv_len++] = '\n';
+    fwrite(csv_line, 1, (size_t)csv_len, ctx->output_file);
+}
+
+// --simplify: write the record only if its track needs it to stay within the tolerance
+static void simplify_record(DecodeContext *ctx, const AISData *data) {
+    AISData out;
+    if (simplifier_push(ctx->simplifier, data, &out)) {
+        write_record(ctx, &out);
+    }
+}
+
+// Write each track's last point, which the simplifier holds until the input ends
+static void flush_simplifier(DecodeContext *ctx) {
+    AISData out;
+    for (uint32_t i = 0; i < ctx->simplifier->index.count; i++) {
+        if (simplifier_take_pending(ctx->simplifier, i, &out)) {
+            write_record(ctx, &out);
+        }
+    }
+}
+
+// --enrich: static data of a vessel the MMSI filter keeps is wanted even when --types or
+// --bbox (which no static message passes) keep the message itself out of the output
+static void feed_filtered_static(DecodeContext *ctx, const char *payload, int payload_len) {
+    const MessageFilter *filter = ctx->options->filter;
+    int msg_type = payload_len > 0 ? convert_ais_char(payload[0]) : -1;
+    AISData data;
+
+    if (!ctx->options->enrich || msg_type < 0 || msg_type >= 32 || !((STATIC_SOURCE_TYPES >> msg_type) & 1) ||
+        (filter->mmsi_ranges != NULL && !mmsi_in_ranges(filter, armoured_mmsi(payload, payload_len))) ||
+        decode_ais_payload_projected(ctx->options->decode_projection, payload, payload_len, &data) !=
+            AIS_STATUS_DECODED) {
+        return;
+    }
+    if (ctx->statics != NULL) {
+        static_cache_update(ctx->statics, &data);
+    } else if (ctx->record_buffer != NULL) {
+        data.flags |= RECORD_CACHE_ONLY;
+        output_buffer_append(ctx->record_buffer, &data, sizeof(data));
+    }
+}
+
+// Decode one line; mark is NULL, or the start tick of a line being timed stage by stage
+static void decode_nmea_line(DecodeContext *ctx, const char *line, int len, uint64_t *mark) {
+    DecodeStats *stats = &ctx->stats;
+    AISData data;
+    NMEATagBlock tags;
+
+    stats->total_messages++;
+    ctx->line_clock++;
+
+    // A tag block in front carries the receive time and source; the sentence follows it
+    int tag_len = parse_nmea_tag_block(line, len, &tags);
+    if (tag_len < 0) {
+        stats->rejects[REJECT_MALFORMED]++;
+        return;
+    }
+    line += tag_len;
+    len -= tag_len;
+
+    // Verify the checksum before anything else touches the sentence
+    if (ctx->options->checksum_mode != CHECKSUM_OFF) {
+        int checksum = verify_nmea_checksum(line, len);
+        if (checksum == 1 && tags.checksum == 0) {
+            checksum = 0;
+        }
+        if (checksum != 1) {
+            stats->rejects[checksum == 0 ? REJECT_BAD_CHECKSUM : REJECT_MISSING_CHECKSUM]++;
+            if (ctx->options->checksum_mode == CHECKSUM_DROP) {
+                return;
+            }
+            stats->checksum_failures_kept++;
+        }
+    }
+    METRICS_STAGE(stats, STAGE_CHECKSUM, mark);
+
+    // Split the sentence and reassemble multi-part messages
+    NMEASentence sentence;
+    const char *payload;
+    int payload_len;
+    char assembled[MAX_PAYLOAD_LENGTH];
+
+    if (!parse_nmea_sentence(line, len, &sentence)) {
+        stats->rejects[REJECT_MALFORMED]++;
+        return;
+    }
+
+    if (sentence.fragment_count == 1) {
+        payload = sentence.payload;
+        payload_len = sentence.payload_len;
+    } else {
+        int fill_bits;
+        payload_len = fragment_table_add(ctx->fragments, &sentence, &tags, ctx->line_clock,
+                                         assembled, &fill_bits);
+        if (payload_len == 0) {
+            METRICS_STAGE(stats, STAGE_PARSE, mark);
+            return; // Waiting for the remaining fragments
+        }
+        payload = assembled;
+    }
+    // The receiver's clock beats ours: it is not delayed by buffering or replay
+    uint64_t received_ms = tags.time_ms != 0 ? tags.time_ms : ctx->clock_ms;
+    METRICS_STAGE(stats, STAGE_PARSE, mark);
+
+    // Unwanted messages go before dedup and decoding, having cost a few character lookups
+    if (ctx->options->filter != NULL) {
+        if (!message_filter_pass(ctx->options->filter, payload, payload_len)) {
+            if (!ctx->warm_up) {
+                stats->filtered++;
+                feed_filtered_static(ctx, payload, payload_len);
+            }
+            METRICS_STAGE(stats, STAGE_FILTER, mark);
+            return;
+        }
+        METRICS_STAGE(stats, STAGE_FILTER, mark);
+    }
+
+    // Drop copies of a message seen within the window (one broadcast heard on both channels,
+    // or relayed twice); a copy still counts as a reception for its vessel's channel ratio
+    if (ctx->dedup != NULL) {
+        uint32_t mmsi = armoured_mmsi(payload, payload_len);
+        uint64_t now = ctx->dedup->timed ? ctx->clock_ms : ctx->line_clock;
+        if (dedup_set_check(ctx->dedup, payload, payload_len, mmsi, now)) {
+            if (ctx->warm_up) {
+                return;
+            }
+            stats->duplicates++;
+            if (ctx->vessels != NULL || ctx->tracks != NULL || ctx->report_buffer != NULL) {
+                VesselReport report;
+                memset(&report, 0, sizeof(report));
+                report.received_ms = received_ms;
+                report.mmsi = mmsi;
+                report.channel = ais_channel(sentence.channel);
+                report.duplicate = 1;
+                if (ctx->report_buffer == NULL) {
+                    apply_vessel_report(ctx, &report);
+                } else {
+                    output_buffer_append(ctx->report_buffer, &report, sizeof(report));
+                }
+            }
+            METRICS_STAGE(stats, STAGE_DEDUP, mark);
+            return;
+        }
+        METRICS_STAGE(stats, STAGE_DEDUP, mark);
+    }
+
+    if (ctx->warm_up) {
+        return;
+    }
+
+    // Repeated payloads of the cached types skip de-armouring and decoding altogether
+    uint64_t memo_hash = 0;
+    if (ctx->memo != NULL && memo_cache_wants(payload, payload_len)) {
+        memo_hash = payload_hash(payload, payload_len) | 1;
+    }
+    if (memo_hash != 0 && memo_cache_lookup(ctx->memo, memo_hash, payload_len, &data)) {
+        stats->memo_hits[data.msg_type]++;
+    } else {
+        if (!decode_checked_payload(stats, ctx->options->decode_projection, payload, payload_len, &data)) {
+            return;
+        }
+        if (memo_hash != 0) {
+            memo_cache_store(ctx->memo, memo_hash, payload_len, &data);
+            stats->memo_misses++;
+        }
+    }
+
+    METRICS_STAGE(stats, STAGE_DECODE, mark);
+
+    // Tally message type
+    stats->message_types[data.msg_type]++;
+
+    // Check for position data
+    if (data.flags & AIS_FLAG_LON) { // Set in decode_ais if a valid longitude is found
+        stats->messages_with_position++;
+    } else {
+        stats->valid_without_position++;
+    }
+
+    // Vessel state, the static data join and the columnar archive need input order, so
+    // parallel chunks buffer their input for the writer thread
+    data.received_ms = received_ms;
+    memcpy(data.source, tags.source, sizeof(data.source));
+    if (ctx->statics != NULL) {
+        static_cache_apply(ctx->statics, &data);
+    }
+    if (ctx->vessels != NULL || ctx->tracks != NULL || ctx->report_buffer != NULL) {
+        VesselReport report;
+        vessel_report_from_ais(&data, &report);
+        report.channel = ais_channel(sentence.channel);
+        if (ctx->report_buffer == NULL) {
+            apply_vessel_report(ctx, &report);
+        } else if (!output_buffer_append(ctx->report_buffer, &report, sizeof(report))) {
+            return;
+        }
+        METRICS_STAGE(stats, STAGE_TRACK, mark);
+    }
+    if (ctx->simplifier != NULL) {
+        simplify_record(ctx, &data);
+        stats->decoded_messages++;
+        METRICS_STAGE(stats, STAGE_OUTPUT, mark);
+        return;
+    }
+    if (ctx->columnar != NULL) {
+        columnar_writer_append(ctx->columnar, &data);
+    } else if (ctx->record_buffer != NULL) {
+        // The writer thread writes it (enriched first with --enrich, or thinned by --simplify)
+        if (!output_buffer_append(ctx->record_buffer, &data, sizeof(data))) {
+            return;
+        }
+        stats->decoded_messages++;
+        METRICS_STAGE(stats, STAGE_OUTPUT, mark);
+        return;
+    }
+    if (ctx->options->output_format == OUTPUT_COLUMNAR) {
+        stats->decoded_messages++;
+        METRICS_STAGE(stats, STAGE_OUTPUT, mark);
+        return;
+    }
+
+    // Write to CSV
+    char csv_line[MAX_LINE_LENGTH * 3]; // Increased size to be safe for a long CSV line
+    int csv_len = make_csv_line_projected(ctx->options->output_projection, &data, csv_line);
+    if (ctx->output_buffer != NULL) {
+        if (!output_buffer_append_line(ctx->output_buffer, csv_line, (size_t)csv_len)) {
+            return;
+        }
+    } else {
+        csv_line[csv_len++] = '\n';
+        fwrite(csv_line, 1, (size_t)csv_len, ctx->output_file);
+    }
+    stats->decoded_messages++;
+    METRICS_STAGE(stats, STAGE_OUTPUT, mark);
+}
+
+// Decode one NMEA line of len bytes (without line terminator, need not be NUL-terminated)
+void process_nmea_line(DecodeContext *ctx, const char *line, int len) {
+    if (len == 0) {
+        return;
+    }
+
+    // Under --metrics one line in METRICS_SAMPLE_LINES is timed; the rest pay one branch
+    if (!METRICS_TIMING(ctx) || ctx->warm_up || --ctx->timing_countdown > 0) {
+        decode_nmea_line(ctx, line, len, NULL);
+    } else {
+        uint64_t start = metrics_ticks();
+        uint64_t mark = start;
+        ctx->timing_countdown = METRICS_SAMPLE_LINES;
+        decode_nmea_line(ctx, line, len, &mark);
+        histogram_record(&ctx->stats.metrics.line_ticks, metrics_ticks() - start);
+    }
+
+    if (ctx->exporter != NULL && (ctx->line_clock & (METRICS_CHECK_LINES - 1)) == 0) {
+        metrics_exporter_tick(ctx->exporter, &ctx->stats);
+    }
+}
+
+// Read-only view of a whole input file
+typedef struct {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+// Map a file into memory; returns 0 on failure
+int map_input_file(const char *filename, MappedFile *mf) {
+    mf->data = NULL;
+    mf->size = 0;
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    mf->mapping = NULL;
+    mf->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    if (!GetFileSizeEx(mf->file, &size)) {
+        CloseHandle(mf->file);
+        return 0;
+    }
+    mf->size = (size_t)size.QuadPart;
+    if (mf->size == 0) {
+        return 1;
+    }
+    mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mf->mapping == NULL) {
+        CloseHandle(mf->file);
+        return 0;
+    }
+    mf->data = (const char *)MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mf->data == NULL) {
+        CloseHandle(mf->mapping);
+        CloseHandle(mf->file);
+        return 0;
+    }
+#else
+    struct stat st;
+    mf->fd = open(filename, O_RDONLY);
+    if (mf->fd < 0) {
+        return 0;
+    }
+    if (fstat(mf->fd, &st) != 0) {
+        close(mf->fd);
+        return 0;
+    }
+    mf->size = (size_t)st.st_size;
+    if (mf->size == 0) {
+        return 1;
+    }
+    void *addr = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, mf->fd, 0);
+    if (addr == MAP_FAILED) {
+        close(mf->fd);
+        return 0;
+    }
+    madvise(addr, mf->size, MADV_SEQUENTIAL);
+    mf->data = (const char *)addr;
+#endif
+    return 1;
+}
+
+void unmap_input_file(MappedFile *mf) {
+#ifdef _WIN32
+    if (mf->data != NULL) {
+        UnmapViewOfFile(mf->data);
+    }
+    if (mf->mapping != NULL) {
+        CloseHandle(mf->mapping);
+    }
+    CloseHandle(mf->file);
+#else
+    if (mf->data != NULL) {
+        munmap((void *)mf->data, mf->size);
+    }
+    close(mf->fd);
+#endif
+    mf->data = NULL;
+}
+
+// Feed every line of a memory range to process_nmea_line without copying
+void process_nmea_buffer(DecodeContext *ctx, const char *data, size_t size) {
+    const char *p = data;
+    const char *end = data + size;
+
+    while (p < end) {
+        // memchr is vectorised in every mainstream libc
+        const char *newline = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = newline ? newline : end;
+        const char *next = newline ? newline + 1 : end;
+
+        if (line_end > p && line_end[-1] == '\r') {
+            line_end--;
+        }
+        process_nmea_line(ctx, p, (int)(line_end - p));
+        p = next;
+    }
+}
+
+// Print the end-of-run summary (similar to Python)
+void print_decode_summary(FILE *out, const DecodeStats *stats, const FragmentStats *fs, int incomplete_messages) {
+    fprintf(out, "Total messages processed: %llu\n", (unsigned long long)stats->total_messages);
+    fprintf(out, "Successfully decoded: %llu\n", (unsigned long long)stats->decoded_messages);
+    fprintf(out, "Invalid/non-standard message types: %llu\n", (unsigned long long)stats->invalid_messages);
+    if (stats->filtered > 0) {
+        fprintf(out, "Filtered out (--types/--mmsi/--bbox): %llu\n", (unsigned long long)stats->filtered);
+    }
+    if (stats->duplicates > 0) {
+        fprintf(out, "Duplicate copies dropped: %llu\n", (unsigned long long)stats->duplicates);
+    }
+    if (stats->dedup_early_rotations > 0) {
+        fprintf(out, "  (dedup set filled up %llu times; copies inside the window may have been kept)\n",
+                (unsigned long long)stats->dedup_early_rotations);
+    }
+    
+    fprintf(out, "\nValid messages with position data: %llu\n", (unsigned long long)stats->messages_with_position);
+    fprintf(out, "Valid messages without position data: %llu\n", (unsigned long long)stats->valid_without_position);
+    
+    fprintf(out, "\nValid message type summary:\n");
+    uint64_t memo_hits = 0;
+    for (int i = 1; i <= 27; i++) {
+        if (stats->message_types[i] > 0) {
+            fprintf(out, "  Type %d: %llu messages", i, (unsigned long long)stats->message_types[i]);
+            if (stats->memo_hits[i] > 0) {
+                fprintf(out, " (%llu from the memo cache)", (unsigned long long)stats->memo_hits[i]);
+            }
+            fprintf(out, "\n");
+        }
+        memo_hits += stats->memo_hits[i];
+    }
+    if (memo_hits + stats->memo_misses > 0) {
+        fprintf(out, "  Memo cache: %llu hits, %llu misses (%.1f%% hit rate)\n", (unsigned long long)memo_hits,
+                (unsigned long long)stats->memo_misses, 100.0 * memo_hits / (double)(memo_hits + stats->memo_misses));
+    }
+
+    int invalid_found = 0;
+    for (int i = 0; i < 256; i++) {
+        if (stats->invalid_types[i] > 0) {
+            invalid_found = 1;
+            break;
+        }
+    }
+    
+    if (invalid_found) {
+        fprintf(out, "\nInvalid/non-standard message types found:\n");
+        for (int i = 0; i < 256; i++) {
+            if (stats->invalid_types[i] > 0) {
+                fprintf(out, "  Type %d: %llu messages\n", i, (unsigned long long)stats->invalid_types[i]);
+            }
+        }
+    }
+
+    uint64_t total_rejects = 0;
+    for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+        total_rejects += stats->rejects[i];
+    }
+    if (total_rejects > 0) {
+        fprintf(out, "\nRejected lines by reason:\n");
+        for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+            if (stats->rejects[i] > 0) {
+                fprintf(out, "  %s: %llu\n", REJECT_REASON_NAMES[i], (unsigned long long)stats->rejects[i]);
+            }
+        }
+        if (stats->checksum_failures_kept > 0) {
+            fprintf(out, "  (%llu lines with checksum errors were still decoded)\n",
+                   (unsigned long long)stats->checksum_failures_kept);
+        }
+    }
+
+    if (fs->fragments_received > 0) {
+        fprintf(out, "\nMulti-sentence reassembly:\n");
+        fprintf(out, "  Fragments received: %llu\n", (unsigned long long)fs->fragments_received);
+        fprintf(out, "  Messages reassembled: %llu\n", (unsigned long long)fs->messages_completed);
+        fprintf(out, "  Orphaned fragments: %llu\n", (unsigned long long)fs->orphaned_fragments);
+        fprintf(out, "  Partial messages timed out: %llu\n", (unsigned long long)fs->timed_out);
+        fprintf(out, "  Partial messages evicted (table full): %llu\n", (unsigned long long)fs->evicted);
+        fprintf(out, "  Partial messages superseded: %llu\n", (unsigned long long)fs->superseded);
+        fprintf(out, "  Incomplete at end of file: %d\n", incomplete_messages);
+    }
+}
+
+void print_vessel_summary(FILE *out, const VesselTable *table) {
+    uint32_t with_position = 0;
+    for (uint32_t i = 0; i < table->index.count; i++) {
+        const VesselState *v = mmsi_index_row(&table->index, i);
+        if (v->position_reports > 0) {
+            with_position++;
+        }
+    }
+    fprintf(out, "\nVessel state:\n");
+    fprintf(out, "  Distinct MMSIs: %u (%u with a position)\n", table->index.count, with_position);
+    fprintf(out, "  Table slots: %u, rows: %u (%.1f MB)\n", table->index.mask + 1, table->index.capacity,
+            ((table->index.mask + 1.0) * sizeof(MmsiSlot) + (double)table->index.capacity * sizeof(VesselState)) /
+                (1024.0 * 1024.0));
+    if (table->index.full) {
+        fprintf(out, "  Table full: new MMSIs were not tracked\n");
+    }
+
+    // Channel split: a healthy vessel alternates A/B, so a one-sided ratio points at the
+    // receiver (or at a transmitter that is not a real AIS unit)
+    uint64_t total_a = 0;
+    uint64_t total_b = 0;
+    uint32_t only_a = 0;
+    uint32_t only_b = 0;
+    uint32_t both = 0;
+    const VesselState *top[VESSEL_SUMMARY_TOP];
+    int top_count = 0;
+    for (uint32_t i = 0; i < table->index.count; i++) {
+        const VesselState *v = mmsi_index_row(&table->index, i);
+        uint32_t receptions = v->channel_a + v->channel_b;
+        if (receptions == 0) {
+            continue;
+        }
+        total_a += v->channel_a;
+        total_b += v->channel_b;
+        if (v->channel_b == 0) {
+            only_a++;
+        } else if (v->channel_a == 0) {
+            only_b++;
+        } else {
+            both++;
+        }
+
+        // Insertion into the short list of busiest vessels
+        int j = top_count < VESSEL_SUMMARY_TOP ? top_count++ : VESSEL_SUMMARY_TOP;
+        while (j > 0 && top[j - 1]->channel_a + top[j - 1]->channel_b < receptions) {
+            if (j < VESSEL_SUMMARY_TOP) {
+                top[j] = top[j - 1];
+            }
+            j--;
+        }
+        if (j < VESSEL_SUMMARY_TOP) {
+            top[j] = v;
+        }
+    }
+    if (total_a + total_b == 0) {
+        return;
+    }
+    fprintf(out, "\nChannel reception (duplicates included):\n");
+    fprintf(out, "  Channel A: %llu, channel B: %llu (A/B %.2f)\n", (unsigned long long)total_a,
+            (unsigned long long)total_b, total_b > 0 ? (double)total_a / (double)total_b : 0.0);
+    fprintf(out, "  Vessels heard on A only: %u, B only: %u, both: %u\n", only_a, only_b, both);
+    fprintf(out, "  Busiest MMSIs:\n");
+    for (int i = 0; i < top_count; i++) {
+        fprintf(out, "    %9u  A %6u  B %6u", top[i]->mmsi, top[i]->channel_a, top[i]->channel_b);
+        if (top[i]->channel_b > 0) {
+            fprintf(out, "  A/B %.2f\n", (double)top[i]->channel_a / (double)top[i]->channel_b);
+        } else {
+            fprintf(out, "  A only\n");
+        }
+    }
+}
+
+// Reader-side counters for streaming mode
+typedef struct {
+    uint64_t bytes_received;
+    uint64_t lines_received;
+    uint64_t dropped_full;      // Ring full under the drop policy
+    uint64_t dropped_too_long;  // Longer than MAX_LINE_LENGTH
+    uint64_t reader_stalls;     // Times the reader waited for the decoder (backpressure)
+    uint64_t peak_depth;
+    uint64_t connections;
+    uint64_t reopens;           // Followed file reopened after rotation or truncation
+} StreamStats;
+
+// Current time as Unix milliseconds
+uint64_t wall_clock_ms(void) {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime; // 100 ns since 1601
+    return ticks / 10000 - 11644473600000ull;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+#endif
+}
+
+/*
+ * Metrics export (--metrics=FILE)
+ *
+ * Snapshots of the run's counters go to FILE every --metrics-interval seconds and at the end:
+ * Prometheus text exposition format (for node_exporter's textfile collector), or a JSON object
+ * when FILE ends in ".json". Each snapshot is written to FILE.tmp and renamed over FILE, so
+ * readers never see half a file. Stage times and the line latency histogram come from the
+ * sampled lines only (1 in METRICS_SAMPLE_LINES); counters cover every line.
+ */
+struct MetricsExporter {
+    const char *filename;
+    int json;
+    uint64_t interval_ms;
+    uint64_t next_export_ms;
+    uint64_t start_ticks;              // Calibration of metrics_ticks against monotonic_ns
+    uint64_t start_ns;
+    const FragmentStats *fragments;    // Reassembly counters, or NULL
+    const VesselTable *vessels;        // Or NULL
+    const SpoofDetector *detector;     // Or NULL
+    const StreamStats *stream;         // Reader counters in stream mode, or NULL
+    uint64_t stream_depth;             // Lines queued when the stream counters were copied
+    uint64_t snapshots;
+    int failed;                        // The last snapshot could not be written
+};
+
+void metrics_exporter_init(MetricsExporter *exporter, const DecoderOptions *options) {
+    size_t len = strlen(options->metrics_filename);
+
+    memset(exporter, 0, sizeof(*exporter));
+    exporter->filename = options->metrics_filename;
+    exporter->json = len >= 5 && strcmp(options->metrics_filename + len - 5, ".json") == 0;
+    exporter->interval_ms = (uint64_t)options->metrics_interval * 1000;
+    exporter->next_export_ms = wall_clock_ms() + exporter->interval_ms;
+    exporter->start_ticks = metrics_ticks();
+    exporter->start_ns = monotonic_ns();
+}
+
+// Nanoseconds per metrics_ticks() unit, measured over the run so far
+static double metrics_ns_per_tick(const MetricsExporter *exporter) {
+    uint64_t ticks = metrics_ticks() - exporter->start_ticks;
+    uint64_t ns = monotonic_ns() - exporter->start_ns;
+    return ticks > 0 && ns > 0 ? (double)ns / (double)ticks : 1.0;
+}
+
+static void prometheus_header(FILE *out, const char *name, const char *type, const char *help) {
+    fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void prometheus_value(FILE *out, const char *name, const char *type, const char *help, uint64_t value) {
+    prometheus_header(out, name, type, help);
+    fprintf(out, "%s %llu\n", name, (unsigned long long)value);
+}
+
+// Cumulative buckets (empty ones skipped), values multiplied by scale (ticks -> seconds)
+static void prometheus_histogram(FILE *out, const char *name, const char *help, const Histogram *h, double scale) {
+    uint64_t cumulative = 0;
+
+    prometheus_header(out, name, "histogram", help);
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS - 1; b++) {
+        if (h->buckets[b] > 0) {
+            cumulative += h->buckets[b];
+            fprintf(out, "%s_bucket{le=\"%.9g\"} %llu\n", name, (double)(histogram_bucket_low(b + 1) - 1) * scale,
+                    (unsigned long long)cumulative);
+        }
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, (unsigned long long)h->count);
+    fprintf(out, "%s_sum %.9g\n", name, (double)h->sum * scale);
+    fprintf(out, "%s_count %llu\n", name, (unsigned long long)h->count);
+}
+
+static void write_prometheus_metrics(FILE *out, const MetricsExporter *exporter, const DecodeStats *stats,
+                                     double ns_per_tick) {
+    const DecodeMetrics *m = &stats->metrics;
+
+    prometheus_value(out, "ais_lines_total", "counter", "Non-empty input lines.", stats->total_messages);
+    prometheus_value(out, "ais_decoded_total", "counter", "Messages decoded and written.", stats->decoded_messages);
+    prometheus_header(out, "ais_messages_total", "counter", "Decoded messages by AIS message type.");
+    for (int i = 1; i <= 27; i++) {
+        if (stats->message_types[i] > 0) {
+            fprintf(out, "ais_messages_total{type=\"%d\"} %llu\n", i, (unsigned long long)stats->message_types[i]);
+        }
+    }
+    prometheus_header(out, "ais_rejected_total", "counter", "Lines not decoded, by reason.");
+    for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+        fprintf(out, "ais_rejected_total{reason=\"%s\"} %llu\n", REJECT_REASON_KEYS[i],
+                (unsigned long long)stats->rejects[i]);
+    }
+    prometheus_value(out, "ais_filtered_total", "counter", "Messages dropped by --types, --mmsi or --bbox.",
+                     stats->filtered);
+    prometheus_value(out, "ais_duplicates_total", "counter", "Copies dropped by --dedup.", stats->duplicates);
+    uint64_t memo_hits = 0;
+    for (int i = 0; i < 28; i++) {
+        memo_hits += stats->memo_hits[i];
+    }
+    prometheus_value(out, "ais_memo_hits_total", "counter", "Decodes served by the --memo cache.", memo_hits);
+    prometheus_value(out, "ais_memo_misses_total", "counter", "Cacheable payloads decoded.", stats->memo_misses);
+    if (exporter->fragments != NULL) {
+        const FragmentStats *fs = exporter->fragments;
+        prometheus_value(out, "ais_fragments_received_total", "counter", "Sentences of multi-sentence messages.",
+                         fs->fragments_received);
+        prometheus_value(out, "ais_messages_reassembled_total", "counter", "Multi-sentence messages completed.",
+                         fs->messages_completed);
+        prometheus_header(out, "ais_fragments_dropped_total", "counter", "Partial messages given up, by reason.");
+        fprintf(out, "ais_fragments_dropped_total{reason=\"orphaned\"} %llu\n", (unsigned long long)fs->orphaned_fragments);
+        fprintf(out, "ais_fragments_dropped_total{reason=\"timed_out\"} %llu\n", (unsigned long long)fs->timed_out);
+        fprintf(out, "ais_fragments_dropped_total{reason=\"evicted\"} %llu\n", (unsigned long long)fs->evicted);
+        fprintf(out, "ais_fragments_dropped_total{reason=\"superseded\"} %llu\n", (unsigned long long)fs->superseded);
+    }
+    if (exporter->vessels != NULL) {
+        prometheus_value(out, "ais_vessels", "gauge", "Distinct MMSIs tracked.", exporter->vessels->index.count);
+    }
+    if (exporter->detector != NULL) {
+        prometheus_value(out, "ais_spoof_checks_total", "counter", "Position reports scored by --alerts.",
+                         exporter->detector->checked);
+        prometheus_value(out, "ais_spoof_alerts_total", "counter", "Position reports flagged by --alerts.",
+                         exporter->detector->alerts);
+    }
+
+    prometheus_header(out, "ais_stage_seconds_total", "counter", "Time spent per stage on sampled lines.");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        fprintf(out, "ais_stage_seconds_total{stage=\"%s\"} %.9g\n", STAGE_NAMES[i],
+                (double)m->stage_ticks[i] * ns_per_tick * 1e-9);
+    }
+    prometheus_header(out, "ais_stage_samples_total", "counter", "Sampled lines that reached each stage.");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        fprintf(out, "ais_stage_samples_total{stage=\"%s\"} %llu\n", STAGE_NAMES[i],
+                (unsigned long long)m->stage_samples[i]);
+    }
+    prometheus_histogram(out, "ais_line_duration_seconds", "Decode time of sampled lines.", &m->line_ticks,
+                         ns_per_tick * 1e-9);
+
+    if (exporter->stream != NULL) {
+        const StreamStats *ss = exporter->stream;
+        prometheus_value(out, "ais_stream_bytes_total", "counter", "Bytes read from the stream.", ss->bytes_received);
+        prometheus_value(out, "ais_stream_lines_total", "counter", "Lines read from the stream.", ss->lines_received);
+        prometheus_header(out, "ais_stream_dropped_total", "counter", "Lines dropped by the reader, by reason.");
+        fprintf(out, "ais_stream_dropped_total{reason=\"queue_full\"} %llu\n", (unsigned long long)ss->dropped_full);
+        fprintf(out, "ais_stream_dropped_total{reason=\"too_long\"} %llu\n", (unsigned long long)ss->dropped_too_long);
+        prometheus_value(out, "ais_stream_reader_stalls_total", "counter", "Times the reader waited for the decoder.",
+                         ss->reader_stalls);
+        prometheus_value(out, "ais_stream_queue_depth", "gauge", "Lines waiting for the decoder.", exporter->stream_depth);
+        prometheus_value(out, "ais_stream_queue_peak", "gauge", "Most lines ever waiting for the decoder.",
+                         ss->peak_depth);
+        prometheus_value(out, "ais_stream_queue_capacity", "gauge", "Queue size in lines.", STREAM_RING_SLOTS);
+        prometheus_histogram(out, "ais_stream_batch_lines", "Lines waiting at each decoder wake-up.",
+                             &m->queue_depth, 1.0);
+    }
+}
+
+static void json_histogram(FILE *out, const Histogram *h, double scale) {
+    uint64_t cumulative = 0;
+    int first = 1;
+
+    fprintf(out, "{\"count\": %llu, \"sum\": %.9g, \"p50\": %.9g, \"p90\": %.9g, \"p99\": %.9g, "
+            "\"p999\": %.9g, \"max\": %.9g, \"buckets\": [", (unsigned long long)h->count, (double)h->sum * scale,
+            (double)histogram_quantile(h, 0.5) * scale, (double)histogram_quantile(h, 0.9) * scale,
+            (double)histogram_quantile(h, 0.99) * scale, (double)histogram_quantile(h, 0.999) * scale,
+            (double)h->max * scale);
+    for (int b = 0; b < METRICS_HISTOGRAM_BUCKETS - 1; b++) {
+        if (h->buckets[b] > 0) {
+            cumulative += h->buckets[b];
+            fprintf(out, "%s[%.9g, %llu]", first ? "" : ", ", (double)(histogram_bucket_low(b + 1) - 1) * scale,
+                    (unsigned long long)cumulative);
+            first = 0;
+        }
+    }
+    fprintf(out, "]}");
+}
+
+// Same content as the Prometheus file; histogram buckets are [upper bound, cumulative count]
+static void write_json_metrics(FILE *out, const MetricsExporter *exporter, const DecodeStats *stats,
+                               double ns_per_tick) {
+    const DecodeMetrics *m = &stats->metrics;
+    uint64_t memo_hits = 0;
+    int first = 1;
+
+    for (int i = 0; i < 28; i++) {
+        memo_hits += stats->memo_hits[i];
+    }
+    fprintf(out, "{\n  \"timestamp_ms\": %llu,\n", (unsigned long long)wall_clock_ms());
+    fprintf(out, "  \"lines\": %llu,\n  \"decoded\": %llu,\n", (unsigned long long)stats->total_messages,
+            (unsigned long long)stats->decoded_messages);
+    fprintf(out, "  \"messages\": {");
+    for (int i = 1; i <= 27; i++) {
+        if (stats->message_types[i] > 0) {
+            fprintf(out, "%s\"%d\": %llu", first ? "" : ", ", i, (unsigned long long)stats->message_types[i]);
+            first = 0;
+        }
+    }
+    fprintf(out, "},\n  \"rejected\": {");
+    for (int i = 0; i < REJECT_REASON_COUNT; i++) {
+        fprintf(out, "%s\"%s\": %llu", i ? ", " : "", REJECT_REASON_KEYS[i], (unsigned long long)stats->rejects[i]);
+    }
+    fprintf(out, "},\n  \"filtered\": %llu,\n  \"duplicates\": %llu,\n  \"memo_hits\": %llu,\n"
+            "  \"memo_misses\": %llu,\n", (unsigned long long)stats->filtered,
+            (unsigned long long)stats->duplicates, (unsigned long long)memo_hits,
+            (unsigned long long)stats->memo_misses);
+    if (exporter->fragments != NULL) {
+        const FragmentStats *fs = exporter->fragments;
+        fprintf(out, "  \"fragments\": {\"received\": %llu, \"reassembled\": %llu, \"orphaned\": %llu, "
+                "\"timed_out\": %llu, \"evicted\": %llu, \"superseded\": %llu},\n",
+                (unsigned long long)fs->fragments_received, (unsigned long long)fs->messages_completed,
+                (unsigned long long)fs->orphaned_fragments, (unsigned long long)fs->timed_out,
+                (unsigned long long)fs->evicted, (unsigned long long)fs->superseded);
+    }
+    if (exporter->vessels != NULL) {
+        fprintf(out, "  \"vessels\": %u,\n", exporter->vessels->index.count);
+    }
+    if (exporter->detector != NULL) {
+        fprintf(out, "  \"spoof_checks\": %llu,\n  \"spoof_alerts\": %llu,\n",
+                (unsigned long long)exporter->detector->checked, (unsigned long long)exporter->detector->alerts);
+    }
+    fprintf(out, "  \"stages\": {");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        fprintf(out, "%s\n    \"%s\": {\"seconds\": %.9g, \"samples\": %llu}", i ? "," : "", STAGE_NAMES[i],
+                (double)m->stage_ticks[i] * ns_per_tick * 1e-9, (unsigned long long)m->stage_samples[i]);
+    }
+    fprintf(out, "\n  },\n  \"line_seconds\": ");
+    json_histogram(out, &m->line_ticks, ns_per_tick * 1e-9);
+    if (exporter->stream != NULL) {
+        const StreamStats *ss = exporter->stream;
+        fprintf(out, ",\n  \"stream\": {\"bytes\": %llu, \"lines\": %llu, \"dropped_queue_full\": %llu, "
+                "\"dropped_too_long\": %llu, \"reader_stalls\": %llu, \"queue_depth\": %llu, \"queue_peak\": %llu, "
+                "\"queue_capacity\": %d, \"batch_lines\": ",
+                (unsigned long long)ss->bytes_received, (unsigned long long)ss->lines_received,
+                (unsigned long long)ss->dropped_full, (unsigned long long)ss->dropped_too_long,
+                (unsigned long long)ss->reader_stalls, (unsigned long long)exporter->stream_depth,
+                (unsigned long long)ss->peak_depth, STREAM_RING_SLOTS);
+        json_histogram(out, &m->queue_depth, 1.0);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n}\n");
+}
+
+// Write a snapshot now; returns 0 if the file could not be written
+int metrics_export(MetricsExporter *exporter, const DecodeStats *stats) {
+    char tmp_name[MAX_LINE_LENGTH];
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", exporter->filename);
+    FILE *out = fopen(tmp_name, "w");
+    if (out == NULL) {
+        exporter->failed = 1;
+        return 0;
+    }
+    double ns_per_tick = metrics_ns_per_tick(exporter);
+    if (exporter->json) {
+        write_json_metrics(out, exporter, stats, ns_per_tick);
+    } else {
+        write_prometheus_metrics(out, exporter, stats, ns_per_tick);
+    }
+    int ok = fclose(out) == 0;
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp_name, exporter->filename, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmp_name, exporter->filename) == 0;
+#endif
+    exporter->failed = !ok;
+    exporter->snapshots += ok;
+    return ok;
+}
+
+// Write a snapshot if the interval has passed
+void metrics_exporter_tick(MetricsExporter *exporter, const DecodeStats *stats) {
+    uint64_t now = wall_clock_ms();
+    if (now >= exporter->next_export_ms) {
+        metrics_export(exporter, stats);
+        exporter->next_export_ms = now + exporter->interval_ms;
+    }
+}
+
+// Stage breakdown and latency percentiles for the end-of-run summary
+void print_metrics_summary(FILE *out, const DecodeStats *stats, const MetricsExporter *exporter) {
+    const DecodeMetrics *m = &stats->metrics;
+    double ns_per_tick = metrics_ns_per_tick(exporter);
+    uint64_t total_ticks = 0;
+
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        total_ticks += m->stage_ticks[i];
+    }
+    fprintf(out, "\nInstrumentation (1 line in %d timed, %llu sampled):\n", METRICS_SAMPLE_LINES,
+            (unsigned long long)m->line_ticks.count);
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        if (m->stage_samples[i] > 0) {
+            fprintf(out, "  %-9s %8.1f ns/line  %5.1f%%\n", STAGE_NAMES[i],
+                    (double)m->stage_ticks[i] * ns_per_tick / (double)m->stage_samples[i],
+                    total_ticks > 0 ? 100.0 * (double)m->stage_ticks[i] / (double)total_ticks : 0.0);
+        }
+    }
+    if (m->line_ticks.count > 0) {
+        fprintf(out, "  Line latency: p50 %.0f ns, p90 %.0f ns, p99 %.0f ns, p99.9 %.0f ns, max %.0f ns\n",
+                (double)histogram_quantile(&m->line_ticks, 0.5) * ns_per_tick,
+                (double)histogram_quantile(&m->line_ticks, 0.9) * ns_per_tick,
+                (double)histogram_quantile(&m->line_ticks, 0.99) * ns_per_tick,
+                (double)histogram_quantile(&m->line_ticks, 0.999) * ns_per_tick, (double)m->line_ticks.max * ns_per_tick);
+    }
+    if (m->queue_depth.count > 0) {
+        fprintf(out, "  Lines per decoder wake-up: p50 %llu, p99 %llu, max %llu\n",
+                (unsigned long long)histogram_quantile(&m->queue_depth, 0.5),
+                (unsigned long long)histogram_quantile(&m->queue_depth, 0.99),
+                (unsigned long long)m->queue_depth.max);
+    }
+    if (exporter->failed) {
+        fprintf(out, "Error: Could not write metrics file %s\n", exporter->filename);
+    } else {
+        fprintf(out, "Metrics saved to: %s (%llu snapshots)\n", exporter->filename,
+                (unsigned long long)exporter->snapshots);
+    }
+}
+
+// One slice of the mapped input, decoded by whichever worker claims it
+typedef struct {
+    const char *warm_up_start;  // Earlier lines replayed to pick up straddling fragments
+    const char *start;
+    const char *end;
+    OutputBuffer output;        // CSV text
+    OutputBuffer records;       // AISData for the columnar writer or the static data join
+    OutputBuffer reports;       // VesselReport for the vessel table
+    DecodeStats stats;
+    FragmentStats fragment_stats;
+    int incomplete_messages;
+    int out_of_memory;
+    int done;
+} BatchChunk;
+
+// Work queue shared by the batch workers and the writer
+typedef struct {
+    const DecoderOptions *options;
+    int need_records;   // Workers buffer AISData (columnar output, --enrich or --simplify)
+    int need_reports;   // Workers buffer VesselReport (vessel state or tracks kept)
+    const char *data;
+    const char *data_end;
+    BatchChunk *chunks;
+    int num_chunks;
+    int next_chunk;     // Next chunk to hand to a worker
+    int next_to_write;  // Next chunk the writer is waiting for
+    int window;         // Max chunks decoded ahead of the writer
+    pthread_mutex_t lock;
+    pthread_cond_t chunk_done;
+    pthread_cond_t chunk_written;
+} BatchJob;
+
+// Writer thread side of a buffered record: join static data in input order, then write it
+static void write_buffered_record(DecodeContext *ctx, AISData *data) {
+    if (data->flags & RECORD_CACHE_ONLY) {
+        static_cache_update(ctx->statics, data);
+        return;
+    }
+    if (ctx->statics != NULL) {
+        static_cache_apply(ctx->statics, data);
+    }
+    if (ctx->simplifier != NULL) {
+        simplify_record(ctx, data);
+    } else {
+        write_record(ctx, data);
+    }
+}
+
+// Step back over `lines` non-empty lines so a chunk can replay the fragment window before it
+static const char *find_warm_up_start(const char *data, const char *start, int lines) {
+    const char *p = start;
+    while (lines > 0 && p > data) {
+        const char *line_end = p - 1; // Newline ending the previous line
+        const char *q = line_end;
+        while (q > data && q[-1] != '\n') q--;
+        long len = (long)(line_end - q);
+        if (len > 1 || (len == 1 && *q != '\r')) {
+            lines--;
+        }
+        p = q;
+    }
+    return p;
+}
+
+// Decode one chunk into its own output buffer
+static void decode_batch_chunk(const BatchJob *job, BatchChunk *chunk, FragmentTable *fragments,
+                               DedupSet *dedup, MemoCache *memo) {
+    DecodeContext ctx;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.options = job->options;
+    ctx.output_buffer = job->options->output_format == OUTPUT_CSV ? &chunk->output : NULL;
+    ctx.record_buffer = job->need_records ? &chunk->records : NULL;
+    ctx.report_buffer = job->need_reports ? &chunk->reports : NULL;
+    ctx.fragments = fragments;
+    fragment_table_init(fragments, FRAGMENT_TIMEOUT_LINES);
+    ctx.timing = job->options->metrics_filename != NULL;
+    ctx.timing_countdown = METRICS_SAMPLE_LINES;
+    ctx.dedup = dedup;
+    if (dedup != NULL) {
+        dedup_set_reset(dedup);
+    }
+    ctx.memo = memo;  // Only saves work, so it carries over from the worker's previous chunk
+
+    // Replay the preceding lines so the tables hold exactly what the serial run would
+    // have at this point; fragments completing inside the chunk are then written here,
+    // at the same position as in the serial output
+    ctx.warm_up = 1;
+    process_nmea_buffer(&ctx, chunk->warm_up_start, (size_t)(chunk->start - chunk->warm_up_start));
+    ctx.warm_up = 0;
+    memset(&ctx.stats, 0, sizeof(ctx.stats));
+    memset(&fragments->stats, 0, sizeof(fragments->stats));
+    if (dedup != NULL) {
+        dedup->early_rotations = 0;
+    }
+
+    process_nmea_buffer(&ctx, chunk->start, (size_t)(chunk->end - chunk->start));
+
+    // Partials that will have expired by the next line fall outside the next chunk's replay
+    // window, so count their timeout here; younger ones are the next chunk's to account for
+    if (chunk->end != job->data_end) {
+        fragment_table_expire(fragments, ctx.line_clock + 1);
+    }
+
+    if (dedup != NULL) {
+        ctx.stats.dedup_early_rotations = dedup->early_rotations;
+    }
+    chunk->stats = ctx.stats;
+    chunk->fragment_stats = fragments->stats;
+    chunk->incomplete_messages = fragments->count;
+    // An empty buffer is not a failure: a chunk may hold no position reports, and with
+    // --enrich its CSV is written from the records
+    chunk->out_of_memory = chunk->output.failed || chunk->records.failed || chunk->reports.failed;
+}
+
+static void *batch_worker(void *arg) {
+    BatchJob *job = arg;
+    FragmentTable *fragments = malloc(sizeof(FragmentTable));
+    DedupSet *dedup = NULL;
+    if (job->options->dedup) {
+        dedup = dedup_set_create((uint64_t)dedup_window_lines(job->options), 0);
+    }
+    MemoCache *memo = job->options->memo ? memo_cache_create() : NULL;
+
+    for (;;) {
+        pthread_mutex_lock(&job->lock);
+        while (job->next_chunk < job->num_chunks &&
+               job->next_chunk - job->next_to_write >= job->window) {
+            pthread_cond_wait(&job->chunk_written, &job->lock);
+        }
+        if (job->next_chunk >= job->num_chunks) {
+            pthread_mutex_unlock(&job->lock);
+            break;
+        }
+        BatchChunk *chunk = &job->chunks[job->next_chunk++];
+        pthread_mutex_unlock(&job->lock);
+
+        if (fragments != NULL && (dedup != NULL || !job->options->dedup)) {
+            decode_batch_chunk(job, chunk, fragments, dedup, memo);
+        } else {
+            chunk->out_of_memory = 1;
+        }
+
+        pthread_mutex_lock(&job->lock);
+        chunk->done = 1;
+        pthread_cond_broadcast(&job->chunk_done);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    free(fragments);
+    dedup_set_free(dedup);
+    free(memo);
+    return NULL;
+}
+
+int detect_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// Decode a mapped file on a worker pool; chunk outputs go to ctx's outputs in input order
+// Returns 0 if threads or memory could not be obtained
+int process_mapped_parallel(DecodeContext *ctx, const char *data, size_t size, int threads,
+                            FragmentStats *fragment_stats, int *incomplete_messages) {
+    BatchJob job;
+    pthread_t workers[MAX_THREADS];
+    int started = 0;
+    int ok = 1;
+
+    memset(&job, 0, sizeof(job));
+    job.options = ctx->options;
+    job.need_records = ctx->columnar != NULL || ctx->statics != NULL || ctx->simplifier != NULL;
+    job.need_reports = ctx->vessels != NULL || ctx->tracks != NULL;
+    job.data = data;
+    job.data_end = data + size;
+    job.num_chunks = (int)((size + BATCH_CHUNK_BYTES - 1) / BATCH_CHUNK_BYTES);
+    job.window = threads * BATCH_CHUNKS_PER_THREAD;
+    if (job.num_chunks == 0) {
+        return 1;
+    }
+    job.chunks = calloc((size_t)job.num_chunks, sizeof(BatchChunk));
+    if (job.chunks == NULL) {
+        return 0;
+    }
+
+    // Chunks replay enough earlier lines for both the fragment timeout and the dedup window
+    int warm_up_lines = FRAGMENT_TIMEOUT_LINES;
+    if (ctx->options->dedup && dedup_window_lines(ctx->options) > warm_up_lines) {
+        warm_up_lines = dedup_window_lines(ctx->options);
+    }
+
+    // Cut at the first line start at or after each nominal offset
+    const char *end = data + size;
+    const char *start = data;
+    int n = 0;
+    while (start < end) {
+        size_t remaining = (size_t)(end - start);
+        const char *cut = end;
+        if (remaining > BATCH_CHUNK_BYTES) {
+            const char *newline = memchr(start + BATCH_CHUNK_BYTES - 1, '\n', remaining - BATCH_CHUNK_BYTES + 1);
+            cut = newline ? newline + 1 : end;
+        }
+        job.chunks[n].start = start;
+        job.chunks[n].end = cut;
+        job.chunks[n].warm_up_start = find_warm_up_start(data, start, warm_up_lines);
+        start = cut;
+        n++;
+    }
+    job.num_chunks = n;
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.chunk_done, NULL);
+    pthread_cond_init(&job.chunk_written, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, batch_worker, &job) != 0) {
+            break;
+        }
+        started++;
+    }
+
+    if (started == 0) {
+        ok = 0;
+    } else {
+        // Write finished chunks in order, freeing each buffer as soon as it is on disk
+        for (int i = 0; i < job.num_chunks; i++) {
+            BatchChunk *chunk = &job.chunks[i];
+
+            pthread_mutex_lock(&job.lock);
+            while (!chunk->done) {
+                pthread_cond_wait(&job.chunk_done, &job.lock);
+            }
+            pthread_mutex_unlock(&job.lock);
+
+            if (chunk->out_of_memory) {
+                ok = 0;
+            }
+            for (size_t offset = 0; offset < chunk->reports.len; offset += sizeof(VesselReport)) {
+                apply_vessel_report(ctx, (const VesselReport *)(chunk->reports.data + offset));
+            }
+            for (size_t offset = 0; offset < chunk->records.len; offset += sizeof(AISData)) {
+                write_buffered_record(ctx, (AISData *)(chunk->records.data + offset));
+            }
+            if (chunk->output.len > 0) {
+                fwrite(chunk->output.data, 1, chunk->output.len, ctx->output_file);
+            }
+            free(chunk->output.data);
+            free(chunk->records.data);
+            free(chunk->reports.data);
+            chunk->output.data = NULL;
+            chunk->records.data = NULL;
+            chunk->reports.data = NULL;
+
+            merge_decode_stats(&ctx->stats, &chunk->stats);
+            merge_fragment_stats(fragment_stats, &chunk->fragment_stats);
+            if (ctx->exporter != NULL) {
+                metrics_exporter_tick(ctx->exporter, &ctx->stats);
+            }
+
+            pthread_mutex_lock(&job.lock);
+            job.next_to_write = i + 1;
+            pthread_cond_broadcast(&job.chunk_written);
+            pthread_mutex_unlock(&job.lock);
+        }
+        *incomplete_messages = job.chunks[job.num_chunks - 1].incomplete_messages;
+    }
+
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_cond_destroy(&job.chunk_written);
+    pthread_cond_destroy(&job.chunk_done);
+    pthread_mutex_destroy(&job.lock);
+    free(job.chunks);
+    return ok;
+}
+
+// Write the tracks if asked to, then free the store
+static void finish_tracks(FILE *log, TrackStore *tracks, const DecoderOptions *options) {
+    if (options->track_filename != NULL) {
+        if (write_track_file(options->track_filename, tracks, options->track_from_ms, options->track_to_ms)) {
+            fprintf(log, "Tracks saved to: %s\n", options->track_filename);
+        } else {
+            fprintf(log, "Error: Could not write tracks to %s\n", options->track_filename);
+        }
+    }
+    track_store_free(tracks);
+}
+
+// Function to process the input file and generate statistics
+void process_ais_file(const char *input_filename, const char *output_filename, const DecoderOptions *options) {
+    FILE *input_file = NULL;
+    MappedFile mapped;
+    DecodeContext ctx;
+    VesselTable vessels;
+    StaticCache statics;
+    TrackStore tracks;
+    Simplifier simplifier;
+    SpoofDetector detector;
+    MetricsExporter exporter;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.options = options;
+
+    // Reassembly table is allocated once, so memory stays constant however many fragments are lost
+    ctx.fragments = malloc(sizeof(FragmentTable));
+    if (ctx.fragments == NULL) {
+        printf("Error: Could not allocate fragment table\n");
+        return;
+    }
+    fragment_table_init(ctx.fragments, FRAGMENT_TIMEOUT_LINES);
+    if (vessel_table_init(&vessels, VESSEL_TABLE_INITIAL_SLOTS)) {
+        ctx.vessels = &vessels;
+    } else {
+        printf("Warning: Could not allocate the vessel table, per-vessel state is not tracked\n");
+    }
+    if (!start_spoof_detector(&ctx, &detector)) {
+        printf("Error: Could not open alert file %s\n", options->alert_filename);
+        free(ctx.fragments);
+        vessel_table_free(&vessels);
+        return;
+    }
+
+    int threads = options->threads > 0 ? options->threads : detect_cpu_count();
+    if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    // File opening (parallel decoding needs random access, so it always maps the file)
+    if (options->input_mode == INPUT_MMAP || threads > 1) {
+        if (!map_input_file(input_filename, &mapped)) {
+            printf("Error: Could not map file %s\n", input_filename);
+            free(ctx.fragments);
+            vessel_table_free(&vessels);
+            stop_spoof_detector(&detector);
+            return;
+        }
+    } else {
+        input_file = fopen(input_filename, "r");
+        if (input_file == NULL) {
+            printf("Error: Could not find file %s\n", input_filename);
+            free(ctx.fragments);
+            vessel_table_free(&vessels);
+            stop_spoof_detector(&detector);
+            return;
+        }
+    }
+
+    FILE *output_file = fopen(output_filename, output_file_mode(options));
+    if (output_file == NULL || !begin_decoder_output(&ctx, output_file)) {
+        printf("Error: Could not open output file %s\n", output_filename);
+        if (output_file != NULL) {
+            fclose(output_file);
+        }
+        if (input_file != NULL) {
+            fclose(input_file);
+        } else {
+            unmap_input_file(&mapped);
+        }
+        free(ctx.fragments);
+        vessel_table_free(&vessels);
+        stop_spoof_detector(&detector);
+        return;
+    }
+
+    // Parallel workers keep their own dedup sets and memo caches
+    if (options->dedup && threads <= 1) {
+        ctx.dedup = dedup_set_create((uint64_t)dedup_window_lines(options), 0);
+        if (ctx.dedup == NULL) {
+            printf("Warning: Could not allocate the dedup set, duplicates are kept\n");
+        }
+    }
+    if (options->memo && threads <= 1) {
+        ctx.memo = memo_cache_create();
+    }
+    if (options->enrich) {
+        if (static_cache_init(&statics, STATIC_CACHE_INITIAL_SLOTS)) {
+            ctx.statics = &statics;
+        } else {
+            printf("Warning: Could not allocate the static data cache, reports are not enriched\n");
+        }
+    }
+    if (options->tracks) {
+        if (track_store_init(&tracks, TRACK_STORE_INITIAL_SLOTS)) {
+            ctx.tracks = &tracks;
+        } else {
+            printf("Warning: Could not allocate the track store, tracks are not kept\n");
+        }
+    }
+    if (options->simplify_tolerance > 0) {
+        if (simplifier_init(&simplifier, SIMPLIFY_INITIAL_SLOTS, options->simplify_tolerance)) {
+            ctx.simplifier = &simplifier;
+        } else {
+            printf("Warning: Could not allocate the track simplifier, every record is written\n");
+        }
+    }
+    if (options->metrics_filename != NULL) {
+        metrics_exporter_init(&exporter, options);
+        exporter.fragments = &ctx.fragments->stats;
+        exporter.vessels = ctx.vessels;
+        exporter.detector = ctx.detector;
+        ctx.exporter = &exporter;
+        ctx.timing = 1;
+        ctx.timing_countdown = METRICS_SAMPLE_LINES;
+    }
+
+    if (input_file != NULL) {
+        char line[MAX_LINE_LENGTH];
+
+        // Process file line by line
+        while (fgets(line, sizeof(line), input_file) != NULL) {
+            // Remove trailing newline/carriage return
+            process_nmea_line(&ctx, line, (int)strcspn(line, "\r\n"));
+        }
+        fclose(input_file);
+    } else if (threads > 1) {
+        FragmentStats fragment_stats;
+        int incomplete = 0;
+
+        memset(&fragment_stats, 0, sizeof(fragment_stats));
+        exporter.fragments = &fragment_stats;  // Merged chunk by chunk on this thread
+        if (!process_mapped_parallel(&ctx, mapped.data, mapped.size, threads, &fragment_stats, &incomplete)) {
+            printf("Error: Parallel decoding failed (out of memory or threads), output is incomplete\n");
+        }
+        ctx.fragments->stats = fragment_stats;
+        ctx.fragments->count = incomplete;
+        exporter.fragments = &ctx.fragments->stats;
+        unmap_input_file(&mapped);
+    } else {
+        process_nmea_buffer(&ctx, mapped.data, mapped.size);
+        unmap_input_file(&mapped);
+    }
+
+    if (ctx.simplifier != NULL) {
+        flush_simplifier(&ctx);
+    }
+    if (!end_decoder_output(&ctx)) {
+        printf("Error: Could not write the columnar archive, %s is incomplete\n", output_filename);
+    }
+    fclose(ctx.output_file);
+    stop_spoof_detector(&detector);
+    if (ctx.dedup != NULL) {
+        ctx.stats.dedup_early_rotations = ctx.dedup->early_rotations;
+        dedup_set_free(ctx.dedup);
+    }
+    free(ctx.memo);
+    if (ctx.exporter != NULL) {
+        metrics_export(ctx.exporter, &ctx.stats);
+    }
+
+    print_decode_summary(stdout, &ctx.stats, &ctx.fragments->stats, ctx.fragments->count);
+    if (ctx.vessels != NULL) {
+        print_vessel_summary(stdout, ctx.vessels);
+    }
+    if (ctx.statics != NULL) {
+        print_static_summary(stdout, ctx.statics);
+        static_cache_free(ctx.statics);
+    }
+    if (ctx.tracks != NULL) {
+        print_track_summary(stdout, ctx.tracks);
+        finish_tracks(stdout, ctx.tracks, options);
+    }
+    if (ctx.simplifier != NULL) {
+        print_simplify_summary(stdout, ctx.simplifier);
+        simplifier_free(ctx.simplifier);
+    }
+    if (ctx.detector != NULL) {
+        print_spoof_summary(stdout, ctx.detector);
+        printf("Spoofing alerts saved to: %s\n", options->alert_filename);
+    }
+    if (ctx.exporter != NULL) {
+        print_metrics_summary(stdout, &ctx.stats, ctx.exporter);
+    }
+    free(ctx.fragments);
+    vessel_table_free(&vessels);
+
+    printf("\nDecoded data saved to: %s\n", output_filename);
+}
+
+// Where streaming mode reads NMEA from
+typedef enum {
+    STREAM_STDIN,
+    STREAM_UDP,          // Bound UDP port, one or more sentences per datagram
+    STREAM_TCP_CONNECT,  // Connect to a receiver that serves NMEA over TCP
+    STREAM_TCP_LISTEN,   // Accept one pushing client at a time
+    STREAM_FOLLOW        // Growing capture file, read as it is appended to (like tail -F)
+} StreamType;
+
+#ifdef _WIN32
+typedef SOCKET ais_socket_t;
+#define close_socket closesocket
+#else
+typedef int ais_socket_t;
+#define INVALID_SOCKET (-1)
+#define close_socket close
+#endif
+
+#ifdef _WIN32
+typedef struct _stati64 follow_stat_t;
+#define follow_fstat _fstati64
+#define follow_stat _stati64
+#else
+typedef struct stat follow_stat_t;
+#define follow_fstat fstat
+#define follow_stat stat
+#endif
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// How far a followed file has been read; device and inode tell a rotated file from the old one
 typedef struct {
-    int msg_type;
-    int repeat_ind;
-    uint32_t mmsi;
-    int nav_status;
-    char rot[16];
-    char sog[16];
-    int pos_accuracy;
-    char longitude[32];
-    char lon_hem[2];
-    char latitude[32];
-    char lat_hem[2];
-    char cog[16];
-    int heading;
-    int utc_sec;
-    int sync;
-    int slot;
-    int raim;
-    char ship_name[MAX_TEXT_LENGTH];
-    int ship_type;
-    char callsign[MAX_TEXT_LENGTH];
-    char destination[MAX_TEXT_LENGTH];
-    char draught[16];
-    uint32_t imo;
-    int dim_a;
-    int dim_b;
-    int dim_c;
-    int dim_d;
-    int ais_version;
-    int dte;
-    int altitude;
-    int aid_type;
-    char name_extension[MAX_TEXT_LENGTH];
-    int off_position;
-    int gnss;
-    int has_position;
-} AISData;
-
-// Convert AIS character to 6-bit value
-int convert_ais_char(char c) {
-    int val = (int)c - 48;
-    if (val > 40) {
-        val -= 8;
-    }
-    return val;
-}
-
-// Extract bits from binary string
-int64_t extract_bits(const char *binary_data, int start_pos, int bit_length) {
-    int len = strlen(binary_data);
-    if (start_pos + bit_length > len) {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t offset;
+} FollowPosition;
+
+typedef struct {
+    StreamType type;
+    ais_socket_t sock;
+    ais_socket_t listener;
+    const char *path;          // STREAM_FOLLOW: the followed file...
+    const char *name;          // ...its name within the watched directory
+    int fd;                    // -1 while waiting for the file to be recreated
+    int watch;                 // inotify descriptor on the file's directory, -1 = poll the size
+    int reopen_pending;        // Rotated or truncated; reopen once the old lines are queued
+    FollowPosition position;   // Bytes of the open file read so far
+} StreamSource;
+
+// Single-producer single-consumer ring of lines between the reader thread and the decoder
+typedef struct {
+    char (*lines)[MAX_LINE_LENGTH];
+    int *lengths;
+    FollowPosition *positions;  // Follow mode: file position just past each line, else NULL
+    uint64_t head;   // Lines published by the reader
+    uint64_t tail;   // Lines released by the decoder
+    int closed;
+    StreamStats stats;  // Reader counters as of its last publish, for metrics snapshots
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} LineRing;
+
+typedef struct {
+    StreamSource *source;
+    LineRing *ring;
+    OverflowPolicy overflow;
+    uint64_t head;         // Reader's next slot, published in batches
+    uint64_t cached_tail;  // Last tail seen, refreshed only when the ring looks full
+    FollowPosition position;  // Where the line being pushed ends (follow mode)
+    StreamStats stats;
+} StreamReader;
+
+static volatile sig_atomic_t stream_stop_requested = 0;
+
+static void handle_stream_stop(int sig) {
+    (void)sig;
+    stream_stop_requested = 1;
+}
+
+static void set_socket_timeout(ais_socket_t sock, int ms) {
+#ifdef _WIN32
+    DWORD timeout = (DWORD)ms;
+#else
+    struct timeval timeout;
+    timeout.tv_sec = ms / 1000;
+    timeout.tv_usec = (ms % 1000) * 1000;
+#endif
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+}
+
+// Resolve host:port and return a bound (passive) or connected socket
+static ais_socket_t open_stream_socket(const char *host, const char *port, int socktype, int passive) {
+    struct addrinfo hints;
+    struct addrinfo *results = NULL;
+    ais_socket_t sock = INVALID_SOCKET;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = socktype;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    if (getaddrinfo(host, port, &hints, &results) != 0) {
+        return INVALID_SOCKET;
+    }
+
+    for (struct addrinfo *ai = results; ai != NULL; ai = ai->ai_next) {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock == INVALID_SOCKET) {
+            continue;
+        }
+        if (passive) {
+            int on = 1;
+            setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+            if (bind(sock, ai->ai_addr, (int)ai->ai_addrlen) == 0 &&
+                (socktype != SOCK_STREAM || listen(sock, 1) == 0)) {
+                break;
+            }
+        } else if (connect(sock, ai->ai_addr, (int)ai->ai_addrlen) == 0) {
+            break;
+        }
+        close_socket(sock);
+        sock = INVALID_SOCKET;
+    }
+    freeaddrinfo(results);
+
+    if (sock != INVALID_SOCKET) {
+        set_socket_timeout(sock, STREAM_POLL_MS);
+    }
+    return sock;
+}
+
+// Open the followed file from its start; returns 0 if it does not exist (yet)
+static int open_follow_file(StreamSource *source) {
+    follow_stat_t st;
+
+    source->fd = open(source->path, O_RDONLY | O_BINARY);
+    if (source->fd < 0) {
+        return 0;
+    }
+    if (follow_fstat(source->fd, &st) != 0) {
+        close(source->fd);
+        source->fd = -1;
+        return 0;
+    }
+    source->position.device = (uint64_t)st.st_dev;
+    source->position.inode = (uint64_t)st.st_ino;
+    source->position.offset = 0;
+    return 1;
+}
+
+// Watch the directory rather than the file, so a file created by rotation is noticed too
+static void watch_follow_file(StreamSource *source) {
+    source->watch = -1;
+#ifdef __linux__
+    char dir[MAX_LINE_LENGTH];
+    size_t dir_len = (size_t)(source->name - source->path);
+
+    if (dir_len == 0) {
+        strcpy(dir, ".");
+    } else if (dir_len < sizeof(dir)) {
+        memcpy(dir, source->path, dir_len);
+        dir[dir_len] = '\0';
+    } else {
+        return;
+    }
+    source->watch = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (source->watch >= 0 &&
+        inotify_add_watch(source->watch, dir, IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) < 0) {
+        close(source->watch);
+        source->watch = -1;
+    }
+#endif
+}
+
+// Sleep until the followed file may have changed, or at most STREAM_POLL_MS so Ctrl+C is noticed
+static void wait_follow_file(StreamSource *source) {
+#ifdef __linux__
+    if (source->watch >= 0) {
+        uint64_t deadline_ms = wall_clock_ms() + STREAM_POLL_MS;
+        for (;;) {
+            uint64_t now = wall_clock_ms();
+            struct pollfd pfd;
+            pfd.fd = source->watch;
+            pfd.events = POLLIN;
+            if (now >= deadline_ms || poll(&pfd, 1, (int)(deadline_ms - now)) <= 0) {
+                return;
+            }
+            // Events for other files in the directory do not end the wait
+            char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            int n;
+            int relevant = 0;
+            while ((n = (int)read(source->watch, events, sizeof(events))) > 0) {
+                for (int i = 0; i < n;) {
+                    const struct inotify_event *ev = (const struct inotify_event *)(events + i);
+                    if (ev->len == 0 || strcmp(ev->name, source->name) == 0) {
+                        relevant = 1;
+                    }
+                    i += (int)(sizeof(struct inotify_event) + ev->len);
+                }
+            }
+            if (relevant) {
+                return;
+            }
+        }
+    }
+#else
+    (void)source;
+#endif
+#ifdef _WIN32
+    Sleep(FOLLOW_POLL_MS);
+#else
+    struct timespec pause;
+    pause.tv_sec = 0;
+    pause.tv_nsec = FOLLOW_POLL_MS * 1000000L;
+    nanosleep(&pause, NULL);
+#endif
+}
+
+// Continue a followed file from a checkpoint; returns 0 if it is a different file or shorter now
+static int seek_follow_source(StreamSource *source, const FollowPosition *position) {
+    follow_stat_t st;
+
+    if (source->fd < 0 || source->position.device != position->device ||
+        source->position.inode != position->inode || follow_fstat(source->fd, &st) != 0 ||
+        (uint64_t)st.st_size < position->offset) {
+        return 0;
+    }
+#ifdef _WIN32
+    if (_lseeki64(source->fd, (__int64)position->offset, SEEK_SET) < 0) {
+#else
+    if (lseek(source->fd, (off_t)position->offset, SEEK_SET) < 0) {
+#endif
+        return 0;
+    }
+    source->position.offset = position->offset;
+    return 1;
+}
+
+// Open "stdin", "udp:PORT", "tcp:HOST:PORT", "tcp-listen:PORT" or "follow:FILE"; returns 0 on failure
+int open_stream_source(const char *spec, StreamSource *source) {
+    char host[256];
+    const char *port;
+
+    memset(source, 0, sizeof(*source));
+    source->sock = INVALID_SOCKET;
+    source->listener = INVALID_SOCKET;
+    source->fd = -1;
+    source->watch = -1;
+
+    if (strcmp(spec, "stdin") == 0 || strcmp(spec, "-") == 0) {
+        source->type = STREAM_STDIN;
+        return 1;
+    }
+    if (strncmp(spec, "follow:", 7) == 0) {
+        const char *slash = strrchr(spec + 7, '/');
+#ifdef _WIN32
+        const char *backslash = strrchr(spec + 7, '\\');
+        if (backslash != NULL && (slash == NULL || backslash > slash)) {
+            slash = backslash;
+        }
+#endif
+        source->type = STREAM_FOLLOW;
+        source->path = spec + 7;
+        source->name = slash != NULL ? slash + 1 : source->path;
+        if (!open_follow_file(source)) {
+            return 0;
+        }
+        watch_follow_file(source);
+        return 1;
+    }
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        return 0;
+    }
+#endif
+
+    if (strncmp(spec, "udp:", 4) == 0) {
+        source->type = STREAM_UDP;
+        source->sock = open_stream_socket(NULL, spec + 4, SOCK_DGRAM, 1);
+        return source->sock != INVALID_SOCKET;
+    }
+    if (strncmp(spec, "tcp-listen:", 11) == 0) {
+        source->type = STREAM_TCP_LISTEN;
+        source->listener = open_stream_socket(NULL, spec + 11, SOCK_STREAM, 1);
+        return source->listener != INVALID_SOCKET;
+    }
+    if (strncmp(spec, "tcp:", 4) == 0 && (port = strrchr(spec + 4, ':')) != NULL &&
+        (size_t)(port - (spec + 4)) < sizeof(host)) {
+        memcpy(host, spec + 4, (size_t)(port - (spec + 4)));
+        host[port - (spec + 4)] = '\0';
+        source->type = STREAM_TCP_CONNECT;
+        source->sock = open_stream_socket(host, port + 1, SOCK_STREAM, 0);
+        return source->sock != INVALID_SOCKET;
+    }
+    return 0;
+}
+
+void close_stream_source(StreamSource *source) {
+    if (source->sock != INVALID_SOCKET) {
+        close_socket(source->sock);
+    }
+    if (source->listener != INVALID_SOCKET) {
+        close_socket(source->listener);
+    }
+    if (source->fd >= 0) {
+        close(source->fd);
+    }
+    if (source->watch >= 0) {
+        close(source->watch);
+    }
+#ifdef _WIN32
+    if (source->type != STREAM_STDIN && source->type != STREAM_FOLLOW) {
+        WSACleanup();
+    }
+#endif
+}
+
+// Read what has been appended to a followed file, waiting at its end; never reports end of input
+static int read_follow_source(StreamSource *source, char *buf, int cap, StreamStats *stats) {
+    follow_stat_t st;
+
+    if (source->reopen_pending) {
+        close(source->fd);
+        source->fd = -1;
+        source->reopen_pending = 0;
+        stats->reopens++;
+    }
+    if (source->fd < 0 && !open_follow_file(source)) {
+        wait_follow_file(source);
         return -1;
     }
-    
-    char bit_string[65];
-    strncpy(bit_string, binary_data + start_pos, bit_length);
-    bit_string[bit_length] = '\0';
-    
-    int64_t result = 0;
-    for (int i = 0; i < bit_length; i++) {
-        result = (result << 1) | (bit_string[i] - '0');
+
+    int n = (int)read(source->fd, buf, (unsigned)cap);
+    if (n > 0) {
+        source->position.offset += (uint64_t)n;
+        return n;
+    }
+    if (n < 0) {
+        return errno == EINTR ? -1 : -2;
+    }
+
+    // At the end: wait for more, unless the file was truncated in place or another file now has
+    // its name (rotation). Until one does, a moved file is still the one being written to
+    if (follow_fstat(source->fd, &st) == 0 && (uint64_t)st.st_size < source->position.offset) {
+        source->reopen_pending = 1;
+        return -3;
     }
-    return result;
+    if (follow_stat(source->path, &st) != 0 ||
+        ((uint64_t)st.st_dev == source->position.device && (uint64_t)st.st_ino == source->position.inode)) {
+        wait_follow_file(source);
+        return -1;
+    }
+    // Lines written to the old file just before the new one appeared are read first.
+    // Reopening waits for the next call, so the last lines still carry the old file's position
+    n = (int)read(source->fd, buf, (unsigned)cap);
+    if (n > 0) {
+        source->position.offset += (uint64_t)n;
+        return n;
+    }
+    source->reopen_pending = 1;
+    return -3;
 }
 
-// Extract signed bits (for negative values)
-int64_t extract_signed_bits(const char *binary_data, int start_pos, int bit_length) {
-    int64_t value = extract_bits(binary_data, start_pos, bit_length);
-    if (value == -1) {
+// Read the next block; returns bytes read, 0 at end of input, -1 on timeout/interrupt,
+// -2 on error, -3 when a tcp-listen client disconnected or a followed file was rotated (more may follow)
+static int read_stream_source(StreamSource *source, char *buf, int cap, StreamStats *stats) {
+    int n;
+
+    if (source->type == STREAM_FOLLOW) {
+        return read_follow_source(source, buf, cap, stats);
+    }
+
+    if (source->type == STREAM_STDIN) {
+#ifdef _WIN32
+        n = _read(0, buf, (unsigned)cap);
+#else
+        n = (int)read(STDIN_FILENO, buf, (size_t)cap);
+        if (n < 0 && errno == EINTR) {
+            return -1;
+        }
+#endif
+        return n < 0 ? -2 : n;
+    }
+
+    if (source->type == STREAM_TCP_LISTEN && source->sock == INVALID_SOCKET) {
+        source->sock = accept(source->listener, NULL, NULL);
+        if (source->sock == INVALID_SOCKET) {
+            return -1; // Accept timed out, poll again
+        }
+        set_socket_timeout(source->sock, STREAM_POLL_MS);
+        stats->connections++;
+    }
+
+    n = (int)recv(source->sock, buf, cap, 0);
+    if (n > 0) {
+        return n;
+    }
+    if (n == 0) {
+        if (source->type == STREAM_TCP_LISTEN) {
+            // Client went away; wait for the next one
+            close_socket(source->sock);
+            source->sock = INVALID_SOCKET;
+            return -3;
+        }
+        return 0;
+    }
+#ifdef _WIN32
+    int err = WSAGetLastError();
+    if (err == WSAETIMEDOUT || err == WSAEINTR) {
         return -1;
     }
-    
-    // Check if negative (MSB is 1)
-    if (value >= (1LL << (bit_length - 1))) {
-        value = value - (1LL << bit_length);
+#else
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        return -1;
+    }
+#endif
+    return -2;
+}
+
+// Make every line queued so far visible to the decoder
+static void stream_reader_publish(StreamReader *reader) {
+    LineRing *ring = reader->ring;
+    pthread_mutex_lock(&ring->lock);
+    if (ring->head != reader->head) {
+        ring->head = reader->head;
+        pthread_cond_signal(&ring->not_empty);
+    }
+    reader->cached_tail = ring->tail;
+    ring->stats = reader->stats;
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Queue one complete line, waiting or dropping when the decoder is behind
+static void stream_reader_push(StreamReader *reader, const char *line, int len) {
+    LineRing *ring = reader->ring;
+
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+    if (len == 0) {
+        return;
+    }
+    reader->stats.lines_received++;
+    if (len >= MAX_LINE_LENGTH) {
+        reader->stats.dropped_too_long++;
+        return;
+    }
+
+    if (reader->head - reader->cached_tail >= STREAM_RING_SLOTS) {
+        stream_reader_publish(reader);
+        if (reader->head - reader->cached_tail >= STREAM_RING_SLOTS) {
+            if (reader->overflow == OVERFLOW_DROP) {
+                reader->stats.dropped_full++;
+                return;
+            }
+            reader->stats.reader_stalls++;
+            pthread_mutex_lock(&ring->lock);
+            while (reader->head - ring->tail >= STREAM_RING_SLOTS && !stream_stop_requested) {
+                pthread_cond_wait(&ring->not_full, &ring->lock);
+            }
+            reader->cached_tail = ring->tail;
+            pthread_mutex_unlock(&ring->lock);
+            if (reader->head - reader->cached_tail >= STREAM_RING_SLOTS) {
+                return;
+            }
+        }
+    }
+
+    size_t slot = (size_t)(reader->head % STREAM_RING_SLOTS);
+    memcpy(ring->lines[slot], line, (size_t)len);
+    ring->lengths[slot] = len;
+    if (ring->positions != NULL) {
+        ring->positions[slot] = reader->position;
+    }
+    reader->head++;
+    if (reader->head - reader->cached_tail > reader->stats.peak_depth) {
+        reader->stats.peak_depth = reader->head - reader->cached_tail;
+    }
+}
+
+// Reader thread: split the byte stream into lines and feed the ring
+static void *stream_reader_thread(void *arg) {
+    StreamReader *reader = arg;
+    LineRing *ring = reader->ring;
+    int datagrams = reader->source->type == STREAM_UDP;
+    int follow = reader->source->type == STREAM_FOLLOW;
+    char *buf = malloc(STREAM_READ_SIZE);
+    char partial[MAX_LINE_LENGTH];
+    int partial_len = 0;
+    int partial_too_long = 0;
+
+    while (buf != NULL && !stream_stop_requested) {
+        int n = read_stream_source(reader->source, buf, STREAM_READ_SIZE, &reader->stats);
+        if (n == -1) {
+            continue;
+        }
+        if (n == -3) {
+            // An unterminated last line from the old client or file must not merge into the next one
+            if (partial_len > 0 && !partial_too_long) {
+                reader->position = reader->source->position;
+                stream_reader_push(reader, partial, partial_len);
+                stream_reader_publish(reader);
+            }
+            partial_len = 0;
+            partial_too_long = 0;
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        reader->stats.bytes_received += (uint64_t)n;
+        reader->position = reader->source->position;
+
+        const char *p = buf;
+        const char *end = buf + n;
+        while (p < end) {
+            const char *newline = memchr(p, '\n', (size_t)(end - p));
+            const char *piece_end = newline ? newline : end;
+            int piece_len = (int)(piece_end - p);
+
+            if (newline) {
+                reader->position.offset = reader->source->position.offset - (uint64_t)(end - newline - 1);
+            }
+
+            if (partial_len == 0 && !partial_too_long && newline) {
+                // Whole line inside this block: queue it straight from the read buffer
+                stream_reader_push(reader, p, piece_len);
+            } else {
+                // Line continues from, or into, another read
+                if (partial_len + piece_len < MAX_LINE_LENGTH) {
+                    memcpy(partial + partial_len, p, (size_t)piece_len);
+                    partial_len += piece_len;
+                } else {
+                    partial_too_long = 1;
+                }
+                if (newline || datagrams) {
+                    if (partial_too_long) {
+                        reader->stats.lines_received++;
+                        reader->stats.dropped_too_long++;
+                    } else {
+                        stream_reader_push(reader, partial, partial_len);
+                    }
+                    partial_len = 0;
+                    partial_too_long = 0;
+                }
+            }
+            p = newline ? newline + 1 : end;
+        }
+        stream_reader_publish(reader);
+    }
+
+    // A followed file's unterminated last line may still be being written; the next run reads it
+    if (partial_len > 0 && !partial_too_long && !follow) {
+        stream_reader_push(reader, partial, partial_len);
+    }
+    free(buf);
+
+    pthread_mutex_lock(&ring->lock);
+    ring->head = reader->head;
+    ring->closed = 1;
+    ring->stats = reader->stats;
+    pthread_cond_signal(&ring->not_empty);
+    pthread_mutex_unlock(&ring->lock);
+    return NULL;
+}
+
+void print_stream_summary(FILE *out, const StreamStats *stats) {
+    fprintf(out, "\nStreaming input:\n");
+    fprintf(out, "  Bytes received: %llu\n", (unsigned long long)stats->bytes_received);
+    fprintf(out, "  Lines received: %llu\n", (unsigned long long)stats->lines_received);
+    fprintf(out, "  Lines dropped (decoder behind): %llu\n", (unsigned long long)stats->dropped_full);
+    fprintf(out, "  Lines dropped (too long): %llu\n", (unsigned long long)stats->dropped_too_long);
+    fprintf(out, "  Reader stalls (backpressure): %llu\n", (unsigned long long)stats->reader_stalls);
+    fprintf(out, "  Peak queue depth: %llu of %d lines\n", (unsigned long long)stats->peak_depth, STREAM_RING_SLOTS);
+    if (stats->connections > 0) {
+        fprintf(out, "  TCP clients accepted: %llu\n", (unsigned long long)stats->connections);
+    }
+    if (stats->reopens > 0) {
+        fprintf(out, "  Followed file reopened (rotated or truncated): %llu\n", (unsigned long long)stats->reopens);
+    }
+}
+
+/*
+ * Follow-mode checkpoint (--checkpoint=FILE)
+ *
+ * FollowCheckpoint, then for each open partial message its slot index (uint32_t) and
+ * FragmentSlot, in host layout: a checkpoint is only read back by the build that wrote it.
+ * position is just past the last line decoded and flushed to the output, so a restart reads
+ * on from there with the reassembly table as it was. Written to FILE.tmp and renamed over
+ * FILE like the metrics snapshots. Counters, dedup and vessel state start afresh.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_bytes;       // sizeof(FragmentSlot), so a build with other limits refuses the file
+    FollowPosition position;
+    uint64_t line_clock;
+    uint64_t next_sweep;
+    uint32_t slots;            // Partial messages that follow
+    uint32_t reserved;
+} FollowCheckpoint;
+
+// Write the checkpoint for ctx having decoded up to position; returns 0 on failure
+int save_follow_checkpoint(const char *filename, const DecodeContext *ctx, const FollowPosition *position) {
+    char tmp_name[MAX_LINE_LENGTH];
+    FollowCheckpoint header;
+    const FragmentTable *table = ctx->fragments;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FOLLOW_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = FOLLOW_CHECKPOINT_VERSION;
+    header.slot_bytes = (uint32_t)sizeof(FragmentSlot);
+    header.position = *position;
+    header.line_clock = ctx->line_clock;
+    header.next_sweep = table->next_sweep;
+    for (int i = 0; i < FRAGMENT_TABLE_SIZE; i++) {
+        header.slots += table->slots[i].in_use != 0;
     }
-    return value;
-}
 
-// Convert payload to binary
-void convert_payload_to_binary(const char *payload, char *binary_output) {
-    binary_output[0] = '\0';
-    char temp[7];
-    
-    for (int i = 0; payload[i] != '\0'; i++) {
-        int six_bit_val = convert_ais_char(payload[i]);
-        for (int j = 5; j >= 0; j--) {
-            temp[5-j] = ((six_bit_val >> j) & 1) ? '1' : '0';
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", filename);
+    FILE *out = fopen(tmp_name, "wb");
+    if (out == NULL) {
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (uint32_t i = 0; ok && i < FRAGMENT_TABLE_SIZE; i++) {
+        if (table->slots[i].in_use) {
+            ok = fwrite(&i, sizeof(i), 1, out) == 1 && fwrite(&table->slots[i], sizeof(FragmentSlot), 1, out) == 1;
         }
-        temp[6] = '\0';
-        strcat(binary_output, temp);
     }
+    ok = fclose(out) == 0 && ok;
+#ifdef _WIN32
+    ok = ok && MoveFileExA(tmp_name, filename, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && rename(tmp_name, filename) == 0;
+#endif
+    return ok;
 }
 
-// Parse NMEA sentence to get payload
-int get_payload_from_nmea(const char *sentence, char *payload) {
-    if (strncmp(sentence, "!AIVDM", 6) != 0 && strncmp(sentence, "!AIVDO", 6) != 0) {
+// Restore ctx's reassembly state; returns 1 if loaded, 0 if there is no checkpoint, -1 if it is unusable
+int load_follow_checkpoint(const char *filename, DecodeContext *ctx, FollowPosition *position) {
+    FollowCheckpoint header;
+    FragmentTable *table = ctx->fragments;
+    FILE *in = fopen(filename, "rb");
+
+    if (in == NULL) {
         return 0;
     }
-
-    const char *p = sentence;
-    int comma_count = 0;
-
-    while (*p) {
-        if (*p == ',') {
-            comma_count++;
-        } else if (comma_count == 5) {
-            // start of payload
-            const char *start = p;
-            while (*p && *p != ',') p++;
-            int len = p - start;
-            strncpy(payload, start, len);
-            payload[len] = '\0';
-            return 1;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, FOLLOW_CHECKPOINT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FOLLOW_CHECKPOINT_VERSION || header.slot_bytes != sizeof(FragmentSlot) ||
+        header.slots > FRAGMENT_TABLE_SIZE) {
+        fclose(in);
+        return -1;
+    }
+    for (uint32_t n = 0; n < header.slots; n++) {
+        uint32_t i;
+        if (fread(&i, sizeof(i), 1, in) != 1 || i >= FRAGMENT_TABLE_SIZE ||
+            fread(&table->slots[i], sizeof(FragmentSlot), 1, in) != 1) {
+            fclose(in);
+            fragment_table_init(table, FRAGMENT_TIMEOUT_LINES);
+            return -1;
         }
-        p++;
+        table->count++;
     }
-    return 0;
+    fclose(in);
+    table->next_sweep = header.next_sweep;
+    ctx->line_clock = header.line_clock;
+    *position = header.position;
+    return 1;
 }
 
-// Format coordinates with hemisphere
-void format_lat_lon(double coordinate, int is_lon, char *coord_str, char *hem_str) {
-    if (is_lon) {
-        if (coordinate >= 0) {
-            strcpy(hem_str, "E");
-        } else {
-            strcpy(hem_str, "W");
-        }
-    } else {
-        if (coordinate >= 0) {
-            strcpy(hem_str, "N");
-        } else {
-            strcpy(hem_str, "S");
-        }
+// Decode a live NMEA feed until end of input or Ctrl+C; output_filename NULL or "-" is stdout
+int run_stream(const char *spec, const char *output_filename, const DecoderOptions *options) {
+    StreamSource source;
+    LineRing ring;
+    StreamReader reader;
+    DecodeContext ctx;
+    VesselTable vessels;
+    StaticCache statics;
+    TrackStore tracks;
+    Simplifier simplifier;
+    SpoofDetector detector;
+    MetricsExporter exporter;
+    StreamStats stream_stats;  // Copied from the ring for metrics snapshots
+    FollowPosition checkpoint_position;  // Follow mode: just past the last decoded line
+    pthread_t reader_thread;
+    int to_stdout = output_filename == NULL || strcmp(output_filename, "-") == 0;
+    FILE *log = to_stdout ? stderr : stdout;
+
+    if (to_stdout && options->output_format == OUTPUT_COLUMNAR) {
+        fprintf(log, "Error: Columnar output needs an output file\n");
+        return 1;
+    }
+    if (!open_stream_source(spec, &source)) {
+        fprintf(log, "Error: Could not open stream source %s\n", spec);
+        return 1;
+    }
+    int follow = source.type == STREAM_FOLLOW;
+    const char *checkpoint = options->checkpoint_filename;
+    if (checkpoint != NULL && (!follow || options->output_format == OUTPUT_COLUMNAR)) {
+        fprintf(log, "Error: --checkpoint needs --stream=follow:FILE and CSV output (an archive cannot be appended to)\n");
+        close_stream_source(&source);
+        return 1;
+    }
+    if (checkpoint != NULL && options->simplify_tolerance > 0) {
+        fprintf(log, "Error: --checkpoint cannot be used with --simplify (held-back points would be lost)\n");
+        close_stream_source(&source);
+        return 1;
     }
-    sprintf(coord_str, "%.7f", fabs(coordinate));
-}
 
-// Extract text from 6-bit encoded field
-void extract_text(const char *binary_data, int start_pos, int num_chars, char *output) {
-    output[0] = '\0';
-    char temp[2];
-    temp[1] = '\0';
-    
-    for (int i = 0; i < num_chars; i++) {
-        int64_t char_bits = extract_bits(binary_data, start_pos + (i * 6), 6);
-        if (char_bits == -1) {
-            break;
-        }
-        
-        int ascii_char;
-        if (char_bits < 32) {
-            ascii_char = char_bits + 64;
-        } else {
-            ascii_char = char_bits;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.options = options;
+    ctx.fragments = malloc(sizeof(FragmentTable));
+    if (ctx.fragments == NULL) {
+        fprintf(log, "Error: Could not allocate the fragment table\n");
+        close_stream_source(&source);
+        return 1;
+    }
+    fragment_table_init(ctx.fragments, FRAGMENT_TIMEOUT_LINES);
+    checkpoint_position = source.position;
+    if (checkpoint != NULL) {
+        // Whatever the checkpoint says, the earlier output is kept and added to
+        int loaded = load_follow_checkpoint(checkpoint, &ctx, &checkpoint_position);
+        if (loaded < 0) {
+            fprintf(log, "Error: %s is not a checkpoint of this decoder; delete it to start over\n", checkpoint);
+            free(ctx.fragments);
+            close_stream_source(&source);
+            return 1;
         }
-        
-        if (ascii_char >= 32 && ascii_char <= 126) {
-            temp[0] = (char)ascii_char;
-            strcat(output, temp);
-        } else {
-            strcat(output, " ");
+        ctx.appending = loaded;
+        if (loaded && seek_follow_source(&source, &checkpoint_position)) {
+            fprintf(log, "Resuming %s at byte %llu\n", source.path, (unsigned long long)checkpoint_position.offset);
+        } else if (loaded) {
+            fprintf(log, "Checkpoint is for an earlier or longer file, %s is read from the start\n", source.path);
+            fragment_table_init(ctx.fragments, FRAGMENT_TIMEOUT_LINES);
+            ctx.line_clock = 0;
+            checkpoint_position = source.position;
         }
     }
-    
-    // Trim trailing spaces
-    int len = strlen(output);
-    while (len > 0 && output[len-1] == ' ') {
-        output[len-1] = '\0';
-        len--;
-    }
-}
 
-// Initialize AIS data structure
-void init_ais_data(AISData *data) {
-    data->msg_type = 0;
-    data->repeat_ind = 0;
-    data->mmsi = 0;
-    data->nav_status = -1;
-    strcpy(data->rot, "0");
-    strcpy(data->sog, "0.0");
-    data->pos_accuracy = 0;
-    strcpy(data->longitude, "0");
-    strcpy(data->lon_hem, "E");
-    strcpy(data->latitude, "0");
-    strcpy(data->lat_hem, "N");
-    strcpy(data->cog, "0.0");
-    data->heading = 511;
-    data->utc_sec = 60;
-    data->sync = 0;
-    data->slot = 0;
-    data->raim = 0;
-    data->ship_name[0] = '\0';
-    data->ship_type = 0;
-    data->callsign[0] = '\0';
-    data->destination[0] = '\0';
-    strcpy(data->draught, "0");
-    data->imo = 0;
-    data->dim_a = 0;
-    data->dim_b = 0;
-    data->dim_c = 0;
-    data->dim_d = 0;
-    data->ais_version = 0;
-    data->dte = 0;
-    data->altitude = 0;
-    data->aid_type = 0;
-    data->name_extension[0] = '\0';
-    data->off_position = 0;
-    data->gnss = 0;
-    data->has_position = 0;
-}
-
-// Main decode function
-int decode_ais(const char *nmea_sentence, AISData *data) {
-    char payload[MAX_PAYLOAD_LENGTH];
-    char binary_data[MAX_BINARY_LENGTH];
-    
-    init_ais_data(data);
-    
-    if (!get_payload_from_nmea(nmea_sentence, payload)) {
-        return 0;
+    FILE *output_file = to_stdout ? stdout : fopen(output_filename, ctx.appending ? "a" : output_file_mode(options));
+    memset(&ring, 0, sizeof(ring));
+    ring.lines = malloc((size_t)STREAM_RING_SLOTS * MAX_LINE_LENGTH);
+    ring.lengths = malloc(STREAM_RING_SLOTS * sizeof(int));
+    if (follow) {
+        ring.positions = malloc(STREAM_RING_SLOTS * sizeof(FollowPosition));
     }
-    
-    convert_payload_to_binary(payload, binary_data);
-    
-    if (strlen(binary_data) < 38) {
-        return 0;
+    if (vessel_table_init(&vessels, VESSEL_TABLE_INITIAL_SLOTS)) {
+        ctx.vessels = &vessels;
     }
-    
-    // Get basic message info
-    data->msg_type = (int)extract_bits(binary_data, 0, 6);
-    data->repeat_ind = (int)extract_bits(binary_data, 6, 2);
-    data->mmsi = (uint32_t)extract_bits(binary_data, 8, 30);
-    
-    // Only process valid AIS message types (1-27)
-    if (data->msg_type < 1 || data->msg_type > 27) {
-        return 0;
+    if (options->dedup) {
+        ctx.dedup = dedup_set_create(dedup_window_ms(options), 1);
     }
-    
-    // Decode based on message type
-    if ((data->msg_type >= 1 && data->msg_type <= 3) && strlen(binary_data) >= 168) {
-        // Class A position reports
-        data->nav_status = (int)extract_bits(binary_data, 38, 4);
-        
-        // Rate of turn calculation
-        int64_t rot_raw = extract_signed_bits(binary_data, 42, 8);
-        if (rot_raw == -128) {
-            strcpy(data->rot, "-128.0");
-        } else if (rot_raw == -127) {
-            strcpy(data->rot, "-720.0");
-        } else if (rot_raw == 127) {
-            strcpy(data->rot, "+127.0");
-        } else if (rot_raw == 0) {
-            strcpy(data->rot, "+0.0");
-        } else if (rot_raw > 0) {
-            double rot_degrees = pow(rot_raw / 4.733, 2);
-            sprintf(data->rot, "+%.1f", rot_degrees);
-        } else {
-            double rot_degrees = pow(fabs(rot_raw) / 4.733, 2);
-            sprintf(data->rot, "-%.1f", rot_degrees);
-        }
-        
-        // Speed over ground
-        int64_t sog_raw = extract_bits(binary_data, 50, 10);
-        if (sog_raw == 1023) {
-            strcpy(data->sog, "0.0");
-        } else {
-            sprintf(data->sog, "%.1f", sog_raw / 10.0);
-        }
-        
-        data->pos_accuracy = (int)extract_bits(binary_data, 60, 1);
-        
-        // Position decoding
-        int64_t lon_raw = extract_signed_bits(binary_data, 61, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 89, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        // Course over ground
-        int64_t cog_raw = extract_bits(binary_data, 116, 12);
-        if (cog_raw >= 3600) {
-            strcpy(data->cog, "360.0");
-        } else {
-            sprintf(data->cog, "%.1f", cog_raw / 10.0);
-        }
-        
-        // True heading
-        int64_t hdg_raw = extract_bits(binary_data, 128, 9);
-        data->heading = (hdg_raw == 511) ? 511 : (int)hdg_raw;
-        
-        // UTC second
-        int64_t utc_raw = extract_bits(binary_data, 137, 6);
-        data->utc_sec = (utc_raw >= 60) ? 60 : (int)utc_raw;
-        
-        // Communication state
-        data->raim = (int)extract_bits(binary_data, 148, 1);
-        data->sync = (int)extract_bits(binary_data, 149, 2);
-        data->slot = (int)extract_bits(binary_data, 151, 3);
-        
-    } else if (data->msg_type == 4 && strlen(binary_data) >= 168) {
-        // Base station report
-        data->pos_accuracy = (int)extract_bits(binary_data, 78, 1);
-        int64_t lon_raw = extract_signed_bits(binary_data, 79, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 107, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        data->raim = (int)extract_bits(binary_data, 148, 1);
-        
-    } else if (data->msg_type == 5 && strlen(binary_data) >= 424) {
-        // Static and voyage related data
-        data->ais_version = (int)extract_bits(binary_data, 38, 2);
-        data->imo = (uint32_t)extract_bits(binary_data, 40, 30);
-        extract_text(binary_data, 70, 7, data->callsign);
-        extract_text(binary_data, 112, 20, data->ship_name);
-        data->ship_type = (int)extract_bits(binary_data, 232, 8);
-        data->dim_a = (int)extract_bits(binary_data, 240, 9);
-        data->dim_b = (int)extract_bits(binary_data, 249, 9);
-        data->dim_c = (int)extract_bits(binary_data, 258, 6);
-        data->dim_d = (int)extract_bits(binary_data, 264, 6);
-        data->pos_accuracy = (int)extract_bits(binary_data, 270, 4);
-        
-        int64_t draught_raw = extract_bits(binary_data, 294, 8);
-        if (draught_raw > 0) {
-            sprintf(data->draught, "%.1f", draught_raw / 10.0);
-        }
-        
-        extract_text(binary_data, 302, 20, data->destination);
-        data->dte = (int)extract_bits(binary_data, 422, 1);
-        
-    } else if (data->msg_type == 9 && strlen(binary_data) >= 168) {
-        // SAR aircraft position
-        int64_t altitude_raw = extract_bits(binary_data, 38, 12);
-        if (altitude_raw != 4095) {
-            data->altitude = (int)altitude_raw;
-        }
-        
-        int64_t sog_raw = extract_bits(binary_data, 50, 10);
-        if (sog_raw == 1023) {
-            strcpy(data->sog, "0.0");
-        } else {
-            sprintf(data->sog, "%.1f", sog_raw / 10.0);
-        }
-        
-        data->pos_accuracy = (int)extract_bits(binary_data, 60, 1);
-        
-        int64_t lon_raw = extract_signed_bits(binary_data, 61, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 89, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        int64_t cog_raw = extract_bits(binary_data, 116, 12);
-        if (cog_raw >= 3600) {
-            strcpy(data->cog, "360.0");
-        } else {
-            sprintf(data->cog, "%.1f", cog_raw / 10.0);
-        }
-        
-        data->utc_sec = (int)extract_bits(binary_data, 128, 6);
-        data->dte = (int)extract_bits(binary_data, 142, 1);
-        data->raim = (int)extract_bits(binary_data, 147, 1);
-        
-    } else if (data->msg_type == 11 && strlen(binary_data) >= 168) {
-        // UTC and date response
-        data->pos_accuracy = (int)extract_bits(binary_data, 78, 1);
-        int64_t lon_raw = extract_signed_bits(binary_data, 79, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 107, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        data->raim = (int)extract_bits(binary_data, 148, 1);
-        
-    } else if (data->msg_type == 17 && strlen(binary_data) >= 80) {
-        // DGNSS broadcast binary message
-        int64_t lon_raw = extract_signed_bits(binary_data, 40, 18);
-        int64_t lat_raw = extract_signed_bits(binary_data, 58, 17);
-        
-        if (lon_raw != 0x1A838) {
-            double lon_degrees = lon_raw / 600.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0xD548) {
-            double lat_degrees = lat_raw / 600.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-    } else if (data->msg_type == 18 && strlen(binary_data) >= 168) {
-        // Class B position report
-        int64_t sog_raw = extract_bits(binary_data, 46, 10);
-        if (sog_raw == 1023) {
-            strcpy(data->sog, "0.0");
-        } else {
-            sprintf(data->sog, "%.1f", sog_raw / 10.0);
-        }
-        
-        data->pos_accuracy = (int)extract_bits(binary_data, 56, 1);
-        
-        int64_t lon_raw = extract_signed_bits(binary_data, 57, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 85, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        int64_t cog_raw = extract_bits(binary_data, 112, 12);
-        if (cog_raw >= 3600) {
-            strcpy(data->cog, "360.0");
-        } else {
-            sprintf(data->cog, "%.1f", cog_raw / 10.0);
-        }
-        
-        int64_t hdg_raw = extract_bits(binary_data, 124, 9);
-        data->heading = (hdg_raw == 511) ? 511 : (int)hdg_raw;
-        
-        int64_t utc_raw = extract_bits(binary_data, 133, 6);
-        data->utc_sec = (utc_raw >= 60) ? 60 : (int)utc_raw;
-        
-        data->raim = (int)extract_bits(binary_data, 147, 1);
-        data->sync = (int)extract_bits(binary_data, 149, 2);
-        data->slot = (int)extract_bits(binary_data, 151, 3);
-        
-    } else if (data->msg_type == 19 && strlen(binary_data) >= 312) {
-        // Extended Class B
-        int64_t sog_raw = extract_bits(binary_data, 46, 10);
-        if (sog_raw == 1023) {
-            strcpy(data->sog, "0.0");
-        } else {
-            sprintf(data->sog, "%.1f", sog_raw / 10.0);
-        }
-        
-        data->pos_accuracy = (int)extract_bits(binary_data, 56, 1);
-        
-        int64_t lon_raw = extract_signed_bits(binary_data, 57, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 85, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
+    if (options->memo) {
+        ctx.memo = memo_cache_create();
+    }
+    int detector_ok = start_spoof_detector(&ctx, &detector);
+    if (output_file == NULL || ring.lines == NULL || ring.lengths == NULL || (follow && ring.positions == NULL) ||
+        ctx.vessels == NULL || (options->dedup && ctx.dedup == NULL) || !detector_ok ||
+        !begin_decoder_output(&ctx, output_file)) {
+        fprintf(log, "Error: Could not open output or alert file, or allocate stream buffers\n");
+        if (output_file != NULL && !to_stdout) {
+            fclose(output_file);
         }
-        
-        int64_t cog_raw = extract_bits(binary_data, 112, 12);
-        if (cog_raw >= 3600) {
-            strcpy(data->cog, "360.0");
+        stop_spoof_detector(&detector);
+        vessel_table_free(&vessels);
+        dedup_set_free(ctx.dedup);
+        free(ctx.memo);
+        free(ctx.fragments);
+        free(ring.lines);
+        free(ring.lengths);
+        free(ring.positions);
+        close_stream_source(&source);
+        return 1;
+    }
+    if (options->enrich) {
+        if (static_cache_init(&statics, STATIC_CACHE_INITIAL_SLOTS)) {
+            ctx.statics = &statics;
         } else {
-            sprintf(data->cog, "%.1f", cog_raw / 10.0);
-        }
-        
-        int64_t hdg_raw = extract_bits(binary_data, 124, 9);
-        data->heading = (hdg_raw == 511) ? 511 : (int)hdg_raw;
-        
-        int64_t utc_raw = extract_bits(binary_data, 133, 6);
-        data->utc_sec = (utc_raw >= 60) ? 60 : (int)utc_raw;
-        
-        extract_text(binary_data, 143, 20, data->ship_name);
-        data->ship_type = (int)extract_bits(binary_data, 263, 8);
-        data->dim_a = (int)extract_bits(binary_data, 271, 9);
-        data->dim_b = (int)extract_bits(binary_data, 280, 9);
-        data->dim_c = (int)extract_bits(binary_data, 289, 6);
-        data->dim_d = (int)extract_bits(binary_data, 295, 6);
-        
-        data->raim = (int)extract_bits(binary_data, 305, 1);
-        data->dte = (int)extract_bits(binary_data, 306, 1);
-        
-    } else if (data->msg_type == 21 && strlen(binary_data) >= 272) {
-        // Aid to navigation
-        data->aid_type = (int)extract_bits(binary_data, 38, 5);
-        extract_text(binary_data, 43, 20, data->ship_name);
-        data->pos_accuracy = (int)extract_bits(binary_data, 163, 1);
-        
-        int64_t lon_raw = extract_signed_bits(binary_data, 164, 28);
-        int64_t lat_raw = extract_signed_bits(binary_data, 192, 27);
-        
-        if (lon_raw != 0x6791AC0) {
-            double lon_degrees = lon_raw / 600000.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0x3412140) {
-            double lat_degrees = lat_raw / 600000.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
-        }
-        
-        data->dim_a = (int)extract_bits(binary_data, 219, 9);
-        data->dim_b = (int)extract_bits(binary_data, 228, 9);
-        data->dim_c = (int)extract_bits(binary_data, 237, 6);
-        data->dim_d = (int)extract_bits(binary_data, 243, 6);
-        
-        data->utc_sec = (int)extract_bits(binary_data, 253, 6);
-        data->off_position = (int)extract_bits(binary_data, 259, 1);
-        data->raim = (int)extract_bits(binary_data, 268, 1);
-        
-        if (strlen(binary_data) >= 360) {
-            extract_text(binary_data, 272, 14, data->name_extension);
-        }
-        
-    } else if (data->msg_type == 24 && strlen(binary_data) >= 168) {
-        // Static data report
-        int part_num = (int)extract_bits(binary_data, 38, 2);
-        
-        if (part_num == 0) {
-            // Part A - vessel name
-            extract_text(binary_data, 40, 20, data->ship_name);
-        } else if (part_num == 1) {
-            // Part B - static data
-            data->ship_type = (int)extract_bits(binary_data, 40, 8);
-            extract_text(binary_data, 90, 7, data->callsign);
-            data->dim_a = (int)extract_bits(binary_data, 132, 9);
-            data->dim_b = (int)extract_bits(binary_data, 141, 9);
-            data->dim_c = (int)extract_bits(binary_data, 150, 6);
-            data->dim_d = (int)extract_bits(binary_data, 156, 6);
-        }
-        
-    } else if (data->msg_type == 27 && strlen(binary_data) >= 96) {
-        // Long range AIS
-        data->pos_accuracy = (int)extract_bits(binary_data, 38, 1);
-        data->raim = (int)extract_bits(binary_data, 39, 1);
-        data->nav_status = (int)extract_bits(binary_data, 40, 4);
-        
-        int64_t lon_raw = extract_signed_bits(binary_data, 44, 18);
-        int64_t lat_raw = extract_signed_bits(binary_data, 62, 17);
-        
-        if (lon_raw != 0x1A838) {
-            double lon_degrees = lon_raw / 600.0;
-            format_lat_lon(lon_degrees, 1, data->longitude, data->lon_hem);
-            data->has_position = 1;
-        }
-        
-        if (lat_raw != 0xD548) {
-            double lat_degrees = lat_raw / 600.0;
-            format_lat_lon(lat_degrees, 0, data->latitude, data->lat_hem);
+            fprintf(log, "Warning: Could not allocate the static data cache, reports are not enriched\n");
         }
-        
-        int64_t sog_raw = extract_bits(binary_data, 79, 6);
-        if (sog_raw == 63) {
-            strcpy(data->sog, "0.0");
+    }
+    if (options->tracks) {
+        if (track_store_init(&tracks, TRACK_STORE_INITIAL_SLOTS)) {
+            ctx.tracks = &tracks;
         } else {
-            sprintf(data->sog, "%.1f", (double)sog_raw);
+            fprintf(log, "Warning: Could not allocate the track store, tracks are not kept\n");
         }
-        
-        int64_t cog_raw = extract_bits(binary_data, 85, 9);
-        if (cog_raw >= 360) {
-            strcpy(data->cog, "360.0");
+    }
+    if (options->simplify_tolerance > 0) {
+        if (simplifier_init(&simplifier, SIMPLIFY_INITIAL_SLOTS, options->simplify_tolerance)) {
+            ctx.simplifier = &simplifier;
         } else {
-            sprintf(data->cog, "%.1f", (double)cog_raw);
+            fprintf(log, "Warning: Could not allocate the track simplifier, every record is written\n");
         }
-        
-        data->gnss = (int)extract_bits(binary_data, 94, 1);
     }
-    
-    return 1;
-}
-
-// Convert decoded data to CSV line
-void make_csv_line(const AISData *data, char *output) {
-    sprintf(output, "%d,%d,%u,%d,%s,%s,%d,%s,%s,%s,%s,%s,%d,%d,%d,%d,%d,%s,%d,%s,%s,%s,%u,%d,%d,%d,%d,%d,%d,%d,%d,%s,%d,%d",
-            data->msg_type,
-            data->repeat_ind,
-            data->mmsi,
-            data->nav_status,
-            data->rot,
-            data->sog,
-            data->pos_accuracy,
-            data->longitude,
-            data->lon_hem,
-            data->latitude,
-            data->lat_hem,
-            data->cog,
-            data->heading,
-            data->utc_sec,
-            data->sync,
-            data->slot,
-            data->raim,
-            data->ship_name,
-            data->ship_type,
-            data->callsign,
-            data->destination,
-            data->draught,
-            data->imo,
-            data->dim_a,
-            data->dim_b,
-            data->dim_c,
-            data->dim_d,
-            data->ais_version,
-            data->dte,
-            data->altitude,
-            data->aid_type,
-            data->name_extension,
-            data->off_position,
-            data->gnss);
-}
-
-// Function to process the input file and generate statistics
-void process_ais_file(const char *input_filename, const char *output_filename) {
-    FILE *input_file = NULL;
-    FILE *output_file = NULL;
-    char line[MAX_LINE_LENGTH];
-    char csv_line[MAX_LINE_LENGTH * 3]; // Increased size to be safe for a long CSV line
-    AISData data;
-
-    // Statistics variables
-    int total_messages = 0;
-    int decoded_messages = 0;
-    int invalid_messages = 0;
-    int message_types[28] = {0}; // Index 1-27 for message types
-    int invalid_types[256] = {0}; // Track invalid types
-    int messages_with_position = 0;
-    int valid_without_position = 0;
-
-    // File opening
-    input_file = fopen(input_filename, "r");
-    if (input_file == NULL) {
-        printf("Error: Could not find file %s\n", input_filename);
-        return;
+    memset(&stream_stats, 0, sizeof(stream_stats));
+    if (options->metrics_filename != NULL) {
+        metrics_exporter_init(&exporter, options);
+        exporter.fragments = &ctx.fragments->stats;
+        exporter.vessels = ctx.vessels;
+        exporter.detector = ctx.detector;
+        exporter.stream = &stream_stats;
+        ctx.exporter = &exporter;
+        ctx.timing = 1;
+        ctx.timing_countdown = METRICS_SAMPLE_LINES;
     }
+    pthread_mutex_init(&ring.lock, NULL);
+    pthread_cond_init(&ring.not_empty, NULL);
+    pthread_cond_init(&ring.not_full, NULL);
 
-    output_file = fopen(output_filename, "w");
-    if (output_file == NULL) {
-        printf("Error: Could not open output file %s\n", output_filename);
-        fclose(input_file);
-        return;
+    memset(&reader, 0, sizeof(reader));
+    reader.source = &source;
+    reader.ring = &ring;
+    reader.overflow = options->overflow;
+    if (reader.overflow == OVERFLOW_DEFAULT) {
+        // A UDP sender cannot be slowed down, so shed load instead of stalling the socket
+        reader.overflow = source.type == STREAM_UDP ? OVERFLOW_DROP : OVERFLOW_BLOCK;
     }
 
-    // Write header
-    const char *header = "message_type,repeat_indicator,mmsi,navigation_status,rate_of_turn,speed_over_ground,position_accuracy,longitude,lon_hemisphere,latitude,lat_hemisphere,course_over_ground,true_heading,utc_second,sync_state,slot_timeout,raim_flag,ship_name,ship_type,callsign,destination,draught,imo,dim_a,dim_b,dim_c,dim_d,ais_version,dte,altitude,aid_type,name_extension,off_position,gnss";
-    fprintf(output_file, "%s\n", header);
-
-    // Process file line by line
-    while (fgets(line, sizeof(line), input_file) != NULL) {
-        // Remove trailing newline/carriage return
-        line[strcspn(line, "\r\n")] = '\0';
-
-        if (strlen(line) == 0) {
-            continue;
-        }
+    stream_stop_requested = 0;
+#ifdef _WIN32
+    signal(SIGINT, handle_stream_stop);
+#else
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_stream_stop;  // No SA_RESTART, so a blocked read() returns
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+#endif
 
-        total_messages++;
+    fprintf(log, "Streaming AIS messages from: %s (Ctrl+C to stop)\n", spec);
+    fflush(ctx.output_file);
 
-        // Initial check for message type
-        char payload_check[MAX_PAYLOAD_LENGTH];
-        char binary_data_check[MAX_BINARY_LENGTH];
-        int msg_type_check = -1;
+    if (pthread_create(&reader_thread, NULL, stream_reader_thread, &reader) != 0) {
+        fprintf(log, "Error: Could not start reader thread\n");
+    } else {
+        uint64_t next_checkpoint_ms = 0;
+        int checkpoint_due = 0;  // Lines decoded since the last checkpoint
 
-        if (get_payload_from_nmea(line, payload_check)) {
-            convert_payload_to_binary(payload_check, binary_data_check);
-            if (strlen(binary_data_check) >= 6) {
-                msg_type_check = (int)extract_bits(binary_data_check, 0, 6);
+        // Decode whatever has been published, one batch per wake-up
+        for (;;) {
+            pthread_mutex_lock(&ring.lock);
+            while (ring.head == ring.tail && !ring.closed) {
+                if (ctx.exporter == NULL && !checkpoint_due) {
+                    pthread_cond_wait(&ring.not_empty, &ring.lock);
+                    continue;
+                }
+                // Wake up now and then so snapshots and checkpoints keep coming while the feed is quiet
+                uint64_t deadline_ms = wall_clock_ms() + STREAM_POLL_MS;
+                struct timespec deadline;
+                deadline.tv_sec = (time_t)(deadline_ms / 1000);
+                deadline.tv_nsec = (long)(deadline_ms % 1000) * 1000000;
+                if (pthread_cond_timedwait(&ring.not_empty, &ring.lock, &deadline) != 0) {
+                    break;
+                }
             }
-        }
-        
-        // Skip message if type is non-standard/invalid (similar to Python logic)
-        if (msg_type_check != -1 && (msg_type_check < 1 || msg_type_check > 27)) {
-            invalid_messages++;
-            if (msg_type_check >= 0 && msg_type_check < 256) {
-                invalid_types[msg_type_check]++;
+            uint64_t begin = ring.tail;
+            uint64_t end = ring.head;
+            int closed = ring.closed;
+            if (ctx.exporter != NULL) {
+                stream_stats = ring.stats;
+                exporter.stream_depth = end - begin;
             }
-            continue;
-        }
+            pthread_mutex_unlock(&ring.lock);
 
-        // Decode the message
-        if (decode_ais(line, &data)) {
-            if (data.msg_type >= 1 && data.msg_type <= 27) {
-                // Tally message type
-                message_types[data.msg_type]++;
+            // Lines are stamped with the time their batch is decoded, close to receipt
+            ctx.clock_ms = wall_clock_ms();
 
-                // Check for position data
-                if (data.has_position) { // has_position is set to 1 in decode_ais if a valid coordinate is found
-                    messages_with_position++;
-                } else {
-                    valid_without_position++;
+            if (begin == end && closed) {
+                break;
+            }
+            if (ctx.exporter != NULL && end > begin) {
+                histogram_record(&ctx.stats.metrics.queue_depth, end - begin);
+            }
+            for (uint64_t i = begin; i < end; i++) {
+                size_t slot = (size_t)(i % STREAM_RING_SLOTS);
+                process_nmea_line(&ctx, ring.lines[slot], ring.lengths[slot]);
+            }
+            fflush(ctx.output_file);
+            if (detector.out != NULL) {
+                fflush(detector.out);
+            }
+            if (ctx.exporter != NULL) {
+                metrics_exporter_tick(ctx.exporter, &ctx.stats);
+            }
+            if (follow && end > begin) {
+                checkpoint_position = ring.positions[(end - 1) % STREAM_RING_SLOTS];
+                checkpoint_due = checkpoint != NULL;
+            }
+            // The output was flushed above, so the checkpoint never runs ahead of it
+            if (checkpoint_due && wall_clock_ms() >= next_checkpoint_ms) {
+                if (!save_follow_checkpoint(checkpoint, &ctx, &checkpoint_position)) {
+                    fprintf(log, "Warning: Could not write checkpoint %s\n", checkpoint);
                 }
-
-                // Write to CSV
-                make_csv_line(&data, csv_line);
-                fprintf(output_file, "%s\n", csv_line);
-                decoded_messages++;
+                checkpoint_due = 0;
+                next_checkpoint_ms = wall_clock_ms() + FOLLOW_CHECKPOINT_MS;
             }
+
+            pthread_mutex_lock(&ring.lock);
+            ring.tail = end;
+            pthread_cond_signal(&ring.not_full);
+            pthread_mutex_unlock(&ring.lock);
         }
+        pthread_join(reader_thread, NULL);
     }
 
-    // Close files
-    fclose(input_file);
-    fclose(output_file);
-
-    // Print summary (similar to Python)
-    printf("Total messages processed: %d\n", total_messages);
-    printf("Successfully decoded: %d\n", decoded_messages);
-    printf("Invalid/non-standard message types: %d\n", invalid_messages);
-    
-    printf("\nValid messages with position data: %d\n", messages_with_position);
-    printf("Valid messages without position data: %d\n", valid_without_position);
-    
-    printf("\nValid message type summary:\n");
-    for (int i = 1; i <= 27; i++) {
-        if (message_types[i] > 0) {
-            printf("  Type %d: %d messages\n", i, message_types[i]);
-        }
+    if (checkpoint != NULL && !save_follow_checkpoint(checkpoint, &ctx, &checkpoint_position)) {
+        fprintf(log, "Error: Could not write checkpoint %s, a restart goes back to the previous one\n", checkpoint);
+    } else if (follow) {
+        fprintf(log, "Stopped at byte %llu of %s\n", (unsigned long long)checkpoint_position.offset, source.path);
     }
 
-    int invalid_found = 0;
-    for (int i = 0; i < 256; i++) {
-        if (invalid_types[i] > 0) {
-            invalid_found = 1;
-            break;
-        }
+    if (ctx.simplifier != NULL) {
+        flush_simplifier(&ctx);
     }
-    
-    if (invalid_found) {
-        printf("\nInvalid/non-standard message types found:\n");
-        for (int i = 0; i < 256; i++) {
-            if (invalid_types[i] > 0) {
-                printf("  Type %d: %d messages\n", i, invalid_types[i]);
-            }
-        }
+    if (!end_decoder_output(&ctx)) {
+        fprintf(log, "Error: Could not write the columnar archive, %s is incomplete\n", output_filename);
+    }
+    if (!to_stdout) {
+        fclose(ctx.output_file);
+    }
+    stop_spoof_detector(&detector);
+    if (ctx.dedup != NULL) {
+        ctx.stats.dedup_early_rotations = ctx.dedup->early_rotations;
+    }
+    print_decode_summary(log, &ctx.stats, &ctx.fragments->stats, ctx.fragments->count);
+    print_vessel_summary(log, ctx.vessels);
+    if (ctx.statics != NULL) {
+        print_static_summary(log, ctx.statics);
+    }
+    if (ctx.tracks != NULL) {
+        print_track_summary(log, ctx.tracks);
+        finish_tracks(log, ctx.tracks, options);
+    }
+    if (ctx.simplifier != NULL) {
+        print_simplify_summary(log, ctx.simplifier);
+        simplifier_free(ctx.simplifier);
+    }
+    if (ctx.detector != NULL) {
+        print_spoof_summary(log, ctx.detector);
+    }
+    print_stream_summary(log, &reader.stats);
+    if (ctx.exporter != NULL) {
+        stream_stats = reader.stats;
+        exporter.stream_depth = 0;
+        metrics_export(ctx.exporter, &ctx.stats);
+        print_metrics_summary(log, &ctx.stats, ctx.exporter);
     }
 
-    printf("\nDecoded data saved to: %s\n", output_filename);
+    pthread_cond_destroy(&ring.not_full);
+    pthread_cond_destroy(&ring.not_empty);
+    pthread_mutex_destroy(&ring.lock);
+    free(ring.lines);
+    free(ring.lengths);
+    free(ring.positions);
+    free(ctx.fragments);
+    dedup_set_free(ctx.dedup);
+    free(ctx.memo);
+    vessel_table_free(&vessels);
+    if (ctx.statics != NULL) {
+        static_cache_free(ctx.statics);
+    }
+    close_stream_source(&source);
+    return 0;
 }
 
 // Debug function for single message (optional but good for testing)
 void debug_single_message(const char *nmea_msg) {
     char payload[MAX_PAYLOAD_LENGTH];
-    char binary[MAX_BINARY_LENGTH];
+    AISBitBuffer bits;
+    const AISBitBuffer *binary = &bits;
     
     if (!get_payload_from_nmea(nmea_msg, payload)) {
         printf("Could not parse NMEA message\n");
         return;
     }
 
-    convert_payload_to_binary(payload, binary);
+    if (!convert_payload_to_binary(payload, &bits)) {
+        printf("Payload contains characters outside the AIS 6-bit alphabet\n");
+        return;
+    }
     printf("Payload: %s\n", payload);
-    printf("Binary length: %zu bits\n", strlen(binary));
+    printf("Binary length: %d bits\n", bits.length);
     
     int msg_type = (int)extract_bits(binary, 0, 6);
     int repeat = (int)extract_bits(binary, 6, 2);
@@ -828,7 +4966,231 @@ void debug_single_message(const char *nmea_msg) {
 }
 
 
-int main(void) {
+void print_usage(const char *program) {
+    printf("Usage: %s [options] [input_file output_file]\n", program);
+    printf("       %s --stream=SOURCE [options] [output_file]\n", program);
+    printf("Without files, decodes a sample message and the default paths set in main.\n");
+    printf("Sentences may carry an NMEA 4.0 tag block (\\c:TIME,s:SOURCE,g:N-M-ID*hh\\): its receive\n");
+    printf("time and source fill the receive_time and source columns, and g: groups fragments.\n\n");
+    printf("Options:\n");
+    printf("  --checksum=drop   Drop sentences with a bad or missing checksum (default)\n");
+    printf("  --checksum=count  Count checksum errors but still decode the sentence\n");
+    printf("  --checksum=off    Do not verify checksums\n");
+    printf("  --mmap            Memory-map the input file instead of reading it line by line\n");
+    printf("  --threads=N       Decode on N worker threads (0 = one per CPU); implies --mmap\n");
+    printf("  --stream=SOURCE   Decode a live feed until end of input or Ctrl+C. SOURCE is\n");
+    printf("                    stdin, udp:PORT, tcp:HOST:PORT, tcp-listen:PORT, or follow:FILE to\n");
+    printf("                    decode a capture file as it grows (rotation and truncation are\n");
+    printf("                    followed). CSV goes to output_file, or stdout if omitted.\n");
+    printf("  --checkpoint=FILE Follow mode: save the read position and partial multi-sentence\n");
+    printf("                    messages to FILE every %d ms and on exit; a restart resumes there\n",
+           FOLLOW_CHECKPOINT_MS);
+    printf("                    and appends to the existing output and alert files\n");
+    printf("  --overflow=block  Stream mode: stop reading while the decoder catches up\n");
+    printf("  --overflow=drop   Stream mode: drop and count lines while the decoder is behind\n");
+    printf("                    (default: block for stdin/TCP, drop for UDP)\n");
+    printf("  --alerts=FILE     Check consecutive position reports of each vessel for\n");
+    printf("                    impossible jumps and course mismatches; write alerts to FILE\n");
+    printf("  --dedup[=N]       Drop copies of a message (same payload and MMSI) seen within the\n");
+    printf("                    last N lines of a file (default %d) or N seconds of a stream (default %d)\n",
+           DEDUP_WINDOW_LINES, DEDUP_WINDOW_SECONDS);
+    printf("  --memo            Reuse the decoded record when a base station, AtoN, static or\n");
+    printf("                    binary message payload repeats exactly\n");
+    printf("  --enrich          Fill ship name, call sign, IMO, type, dimensions, draught and\n");
+    printf("                    destination of each record from the vessel's latest static data\n");
+    printf("                    (types 5, 19, 24); with --types or --bbox, static messages of\n");
+    printf("                    kept MMSIs still feed the cache but are not written\n");
+    printf("  --tracks[=FILE]   Keep every position report of every vessel in memory, delta\n");
+    printf("                    encoded (a few bytes a point), and write the tracks to FILE at the\n");
+    printf("                    end: mmsi,receive_time,longitude,latitude,speed_over_ground,\n");
+    printf("                    course_over_ground, by MMSI and then in input order\n");
+    printf("  --track-range=FROM,TO  Write only points received in this range (Unix seconds,\n");
+    printf("                    from tag blocks or stream arrival; files without tags have time 0)\n");
+    printf("  --simplify=M      Write only the position reports needed to keep each vessel's track\n");
+    printf("                    within M metres of every report (at its receive time), for maps;\n");
+    printf("                    messages without a position are not written. One pass, at most %d\n",
+           SIMPLIFY_WINDOW_POINTS);
+    printf("                    reports held per vessel; the last of each is written at the end\n");
+    printf("  --metrics=FILE    Time sampled lines per stage and write counters, latency histograms\n");
+    printf("                    and stream queue depths to FILE (Prometheus text, or JSON if FILE\n");
+    printf("                    ends in .json), refreshed every %d s and at the end\n", METRICS_EXPORT_SECONDS);
+    printf("  --metrics-interval=S  Seconds between metrics snapshots\n");
+    printf("  --types=LIST      Keep only these message types, e.g. 1-3,18,19\n");
+    printf("  --mmsi=LIST       Keep only these MMSIs and ranges, e.g. 244123456,211000000-211999999,\n");
+    printf("                    or @FILE with one per line\n");
+    printf("  --bbox=W,S,E,N    Keep only messages with a position inside the box (decimal degrees;\n");
+    printf("                    W > E crosses 180). Filters are checked before anything is decoded.\n");
+    printf("  --columns=LIST    Decode and write only these columns, e.g. mmsi,lat,lon,utc_sec\n");
+    printf("                    (field or CSV header names; the flags column is columnar only)\n");
+    printf("  --format=csv      Write CSV text (default)\n");
+    printf("  --format=columnar Write a memory-mappable binary archive of typed columns\n");
+    printf("                    (layout: see the \"Columnar archive\" comment in the source)\n");
+}
+
+// Programs that embed the decoder (ais_benchmark_C.c) define AIS_DECODER_NO_MAIN
+#ifndef AIS_DECODER_NO_MAIN
+// FROM,TO in Unix seconds (fractions allowed) to an inclusive millisecond range
+static int parse_track_range(const char *text, uint64_t *from_ms, uint64_t *to_ms) {
+    char *end;
+    double from = strtod(text, &end);
+    if (end == text || *end != ',' || from < 0) {
+        return 0;
+    }
+    const char *second = end + 1;
+    double to = strtod(second, &end);
+    if (end == second || *end != '\0' || to < from) {
+        return 0;
+    }
+    *from_ms = (uint64_t)(from * 1000.0 + 0.5);
+    *to_ms = (uint64_t)(to * 1000.0 + 0.5);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    DecoderOptions options;
+    MessageFilter filter;
+    AISProjection output_projection;
+    AISProjection decode_projection;
+    const char *files[2] = {NULL, NULL};
+    const char *stream_spec = NULL;
+    int num_files = 0;
+
+    init_decoder_options(&options);
+    memset(&filter, 0, sizeof(filter));
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--checksum=drop") == 0) {
+            options.checksum_mode = CHECKSUM_DROP;
+        } else if (strcmp(arg, "--checksum=count") == 0) {
+            options.checksum_mode = CHECKSUM_COUNT;
+        } else if (strcmp(arg, "--checksum=off") == 0) {
+            options.checksum_mode = CHECKSUM_OFF;
+        } else if (strcmp(arg, "--mmap") == 0) {
+            options.input_mode = INPUT_MMAP;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            options.threads = atoi(arg + 10);
+        } else if (strncmp(arg, "--stream=", 9) == 0) {
+            stream_spec = arg + 9;
+        } else if (strncmp(arg, "--checkpoint=", 13) == 0) {
+            options.checkpoint_filename = arg + 13;
+        } else if (strcmp(arg, "--overflow=block") == 0) {
+            options.overflow = OVERFLOW_BLOCK;
+        } else if (strcmp(arg, "--overflow=drop") == 0) {
+            options.overflow = OVERFLOW_DROP;
+        } else if (strcmp(arg, "--dedup") == 0) {
+            options.dedup = 1;
+        } else if (strncmp(arg, "--dedup=", 8) == 0) {
+            options.dedup = 1;
+            options.dedup_window = atoi(arg + 8);
+            if (options.dedup_window <= 0) {
+                printf("Invalid dedup window: %s\n", arg + 8);
+                return 1;
+            }
+        } else if (strcmp(arg, "--memo") == 0) {
+            options.memo = 1;
+        } else if (strcmp(arg, "--enrich") == 0) {
+            options.enrich = 1;
+        } else if (strcmp(arg, "--tracks") == 0) {
+            options.tracks = 1;
+        } else if (strncmp(arg, "--tracks=", 9) == 0) {
+            options.tracks = 1;
+            options.track_filename = arg + 9;
+        } else if (strncmp(arg, "--simplify=", 11) == 0) {
+            char *end;
+            options.simplify_tolerance = strtod(arg + 11, &end);
+            if (end == arg + 11 || *end != '\0' || !(options.simplify_tolerance > 0)) {
+                printf("Invalid simplify tolerance: %s\n", arg + 11);
+                return 1;
+            }
+        } else if (strncmp(arg, "--track-range=", 14) == 0) {
+            if (!parse_track_range(arg + 14, &options.track_from_ms, &options.track_to_ms)) {
+                printf("Invalid track range: %s\n", arg + 14);
+                return 1;
+            }
+        } else if (strncmp(arg, "--alerts=", 9) == 0) {
+            options.alert_filename = arg + 9;
+        } else if (strncmp(arg, "--metrics=", 10) == 0) {
+            options.metrics_filename = arg + 10;
+        } else if (strncmp(arg, "--metrics-interval=", 19) == 0) {
+            options.metrics_interval = atoi(arg + 19);
+            if (options.metrics_interval <= 0) {
+                printf("Invalid metrics interval: %s\n", arg + 19);
+                return 1;
+            }
+        } else if (strncmp(arg, "--types=", 8) == 0) {
+            if (!parse_type_filter(arg + 8, &filter.type_mask)) {
+                printf("Invalid message type list: %s\n", arg + 8);
+                return 1;
+            }
+        } else if (strncmp(arg, "--mmsi=", 7) == 0) {
+            if (!parse_mmsi_filter(&filter, arg + 7)) {
+                printf("Invalid MMSI list: %s\n", arg + 7);
+                message_filter_free(&filter);
+                return 1;
+            }
+        } else if (strncmp(arg, "--bbox=", 7) == 0) {
+            if (!parse_bbox_filter(&filter, arg + 7)) {
+                printf("Invalid bounding box: %s\n", arg + 7);
+                return 1;
+            }
+        } else if (strncmp(arg, "--columns=", 10) == 0) {
+            uint64_t columns;
+            if (!parse_column_list(arg + 10, &columns)) {
+                printf("Invalid column list: %s\n", arg + 10);
+                return 1;
+            }
+            // Tracking and the position count in the summary need their fields whatever is written
+            ais_projection_init(&output_projection, columns);
+            ais_projection_init(&decode_projection, columns | VESSEL_COLUMNS);
+            options.output_projection = &output_projection;
+            options.decode_projection = &decode_projection;
+        } else if (strcmp(arg, "--format=csv") == 0) {
+            options.output_format = OUTPUT_CSV;
+        } else if (strcmp(arg, "--format=columnar") == 0) {
+            options.output_format = OUTPUT_COLUMNAR;
+        } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg[0] != '-' && num_files < 2) {
+            files[num_files++] = arg;
+        } else {
+            printf("Unknown argument: %s\n\n", arg);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (message_filter_active(&filter)) {
+        options.filter = &filter;
+    }
+    // The cache is filled from static messages whichever columns are written
+    if (options.enrich && options.decode_projection != NULL) {
+        ais_projection_init(&decode_projection, decode_projection.columns | STATIC_COLUMNS);
+    }
+
+    if (stream_spec != NULL) {
+        if (num_files > 1) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        int status = run_stream(stream_spec, files[0], &options);
+        message_filter_free(&filter);
+        return status;
+    }
+
+    // Files given on the command line: decode them and exit
+    if (num_files == 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (num_files == 2) {
+        printf("Processing AIS messages from: %s\n", files[0]);
+        process_ais_file(files[0], files[1], &options);
+        message_filter_free(&filter);
+        return 0;
+    }
+
     // Test with sample message
     const char *test_nmea = "!AIVDM,1,1,,A,38IFDN0Ohj7JvbN0fABtpbJ401w@,0*69";
     printf("Testing decoder with sample message:\n");
@@ -852,10 +5214,11 @@ int main(void) {
     const char *output_path = "C:\\Users\\cxris\\OneDrive\\Desktop\\VDES research\\conversion\\nmea-sample_AIS_Decoder_C_081125";
     
     printf("Processing AIS messages from: %s\n", input_path);
-    process_ais_file(input_path, output_path);
+    process_ais_file(input_path, output_path, &options);
     
     printf("\nPress Enter to Exit");
     getchar();
 
     return 0;
-}  
+}
+#endif